@@ -0,0 +1,79 @@
+/*
+ * Measures the time to load a net in the "yinspire.c" JSON format.
+ *
+ *   bench net.json
+ *
+ * Reports the time to parse the JSON into a DOM (jsonValue and
+ * jsonDocument), to load the net into a Simulator from the DOM and to
+ * load the net with the streaming loader.
+ */
+#include "simulator.h"
+#include "synapse.h"
+#include "neuron_srm_01.h"
+#include "json/json_parser.h"
+#include "json/json_doc.h"
+#include <sys/time.h>
+#include <iostream>
+
+#define DEF_TYPE(t) NeuralEntity *make_##t() { return new t(); }
+#define REG_TYPE(t, s) (s)->entity_register_type(#t, make_##t)
+#define REG_SHARED_TYPE(t, s) (s)->entity_register_type(#t, make_##t, make_##t##_Shared)
+
+DEF_TYPE(Synapse)
+DEF_TYPE(Neuron_SRM_01)
+DEF_TYPE(Neuron_SRM_01_Shared)
+
+static double
+now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 2)
+  {
+    std::cout << "USAGE: bench net.json" << std::endl;
+    return 1;
+  }
+
+  double t;
+
+  t = now();
+  jsonValue *data = jsonParser::parse_file_mmap(argv[1]);
+  double parse_time = now() - t;
+  data->ref_decr();
+
+  t = now();
+  jsonDocument *doc = new jsonDocument(argv[1]);
+  double doc_parse_time = now() - t;
+  delete doc;
+
+  Simulator *sim = new Simulator();
+  REG_TYPE(Synapse, sim);
+  REG_SHARED_TYPE(Neuron_SRM_01, sim);
+  t = now();
+  sim->load(argv[1]);
+  double load_time = now() - t;
+  delete sim;
+
+  sim = new Simulator();
+  REG_TYPE(Synapse, sim);
+  REG_SHARED_TYPE(Neuron_SRM_01, sim);
+  sim->load_streaming = true;
+  t = now();
+  sim->load(argv[1]);
+  double stream_time = now() - t;
+  delete sim;
+
+  std::cout << "Net:              " << argv[1] << std::endl;
+  std::cout << "ParseTime:        " << parse_time << std::endl;
+  std::cout << "DocParseTime:     " << doc_parse_time << std::endl;
+  std::cout << "LoadTime:         " << load_time << std::endl;
+  std::cout << "StreamLoadTime:   " << stream_time << std::endl;
+  std::cout << std::endl;
+
+  return 0;
+}
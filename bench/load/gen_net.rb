@@ -0,0 +1,63 @@
+#
+# Generates a random net in the "yinspire.c" JSON format.
+#
+#   ruby gen_net.rb neurons fan_out templates > net.json
+#
+# Each neuron has +fan_out+ synapses to randomly choosen neurons.
+# Neurons and synapses are distributed over +templates+ templates each
+# (with slightly different parameters), so that the cost of looking
+# up templates shows up in the load time.
+#
+
+neurons = Integer(ARGV[0] || 10_000)
+fan_out = Integer(ARGV[1] || 10)
+templates = Integer(ARGV[2] || 100)
+
+srand(42)
+out = STDOUT
+
+out.puts "{"
+out.puts %{ format: "yinspire.c",}
+out.puts " templates: {"
+
+tmpls = []
+templates.times do |t|
+  tmpls << %{  N#{t}: ["Neuron_SRM_01", {tau_m: #{0.85 + t*0.001}, tau_ref: 2.0, ref_weight: 0.1, const_threshold: 0.5, abs_refr_duration: 1.0}]}
+  tmpls << %{  S#{t}: ["Synapse", {weight: #{0.3 + t*0.001}, delay: 0.25}]}
+end
+out.puts tmpls.join(",\n")
+out.puts " },"
+
+out.puts %{ entities: [}
+first = true
+neurons.times do |i|
+  out.print(first ? "" : ",\n"); first = false
+  out.print %{  ["n#{i}", "N#{i % templates}"]}
+end
+(neurons * fan_out).times do |k|
+  out.print %{,\n  ["s#{k}", "S#{k % templates}"]}
+end
+out.puts
+out.puts %{ ],}
+
+out.puts %{ connections: [}
+first = true
+neurons.times do |i|
+  fan_out.times do |j|
+    k = i * fan_out + j
+    out.print(first ? "" : ",\n"); first = false
+    out.print %{  ["n#{i}", "s#{k}"],\n  ["s#{k}", "n#{rand(neurons)}"]}
+  end
+end
+out.puts
+out.puts %{ ],}
+
+out.puts " events: {"
+events = []
+[neurons, 50].min.times do |i|
+  times = (1..20).map { (rand * 100.0).round(3) }.sort
+  events << %{  n#{i}: [#{times.join(', ')}]}
+end
+out.puts events.join(",\n")
+out.puts " }"
+out.puts "}"
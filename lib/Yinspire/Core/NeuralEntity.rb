@@ -82,6 +82,12 @@ class NeuralEntity
   #
   property :simulator, Simulator
 
+  #
+  # Whether the fire events of this entity are passed to
+  # Simulator#record_fires. Unrecorded fires are dropped in C.
+  #
+  property :recorded, 'bool', :init => true
+
   #
   # Connect +self+ with +target+.
   #
@@ -19,6 +19,7 @@ class Neuron < NeuralEntity
     if last = self.last_pre_synapse
       assert(last.next_pre_synapse == nil) # missing method: neuron instead of synapse
       last.next_pre_synapse = syn
+      syn.prev_pre_synapse = last
       self.last_pre_synapse = syn # advance tail pointer
     else
       assert(self.first_pre_synapse == nil)
@@ -35,6 +36,7 @@ class Neuron < NeuralEntity
     if last = self.last_post_synapse
       assert(last.next_post_synapse == nil)
       last.next_post_synapse = syn
+      syn.prev_post_synapse = last
       self.last_post_synapse = syn # advance tail pointer
     else
       assert(self.first_post_synapse == nil)
@@ -44,70 +46,60 @@ class Neuron < NeuralEntity
     syn.pre_neuron = self
   end
 
+  #
+  # Remove +syn+ from the pre synapse list. O(1)
+  #
   def delete_pre_synapse(syn)
     raise ArgumentError, "Synapse expected" unless syn.kind_of?(Synapse)
     raise "Synapse not connected to this Neuron" if syn.post_neuron != self
 
-    prev = find_preceding_synapse(syn, first_pre_synapse(), :next_pre_syapse)
+    prev, succ = syn.prev_pre_synapse, syn.next_pre_synapse
 
-    #
-    # Remove +target+ from linked list.
-    #
     if prev
-      prev.next_pre_synapse = target.next_post_synapse
-      self.last_post_synapse = prev if self.last_post_synapse == target 
+      prev.next_pre_synapse = succ
+    else
+      assert self.first_pre_synapse == syn
+      self.first_pre_synapse = succ
+    end
+
+    if succ
+      succ.prev_pre_synapse = prev
     else
-      #
-      # target is the only synapse in the post synapse list.
-      #
-      assert self.first_post_synapse == target
-      assert self.last_post_synapse == target
-      self.first_post_synapse = nil
-      self.last_post_synapse = nil
+      assert self.last_pre_synapse == syn
+      self.last_pre_synapse = prev
     end
 
-    target.pre_neuron = nil
-    target.next_post_synapse = nil
+    syn.post_neuron = nil
+    syn.prev_pre_synapse = nil
+    syn.next_pre_synapse = nil
   end
 
+  #
+  # Remove +syn+ from the post synapse list. O(1)
+  #
   def delete_post_synapse(syn)
-    # FIXME
-    raise "target must be Synapse" unless target.kind_of?(Synapse)
-    raise "Synapse not connected to this Neuron" if target.pre_neuron != self 
-
-    #
-    # Find the synapse in the linked list that precedes +target+.
-    #
-    prev = nil
-    curr = self.first_post_synapse
-
-    while true
-      break if curr == target
-      break unless curr
-      prev = curr
-      curr = curr.next_post_synapse
-    end
+    raise ArgumentError, "Synapse expected" unless syn.kind_of?(Synapse)
+    raise "Synapse not connected to this Neuron" if syn.pre_neuron != self
 
-    raise "Synapse not in post synapse list" if curr != target
+    prev, succ = syn.prev_post_synapse, syn.next_post_synapse
 
-    #
-    # Remove +target+ from linked list.
-    #
     if prev
-      prev.next_post_synapse = target.next_post_synapse
-      self.last_post_synapse = prev if self.last_post_synapse == target 
+      prev.next_post_synapse = succ
     else
-      #
-      # target is the only synapse in the post synapse list.
-      #
-      assert self.first_post_synapse == target
-      assert self.last_post_synapse == target
-      self.first_post_synapse = nil
-      self.last_post_synapse = nil
+      assert self.first_post_synapse == syn
+      self.first_post_synapse = succ
     end
 
-    target.pre_neuron = nil
-    target.next_post_synapse = nil
+    if succ
+      succ.prev_post_synapse = prev
+    else
+      assert self.last_post_synapse == syn
+      self.last_post_synapse = prev
+    end
+
+    syn.pre_neuron = nil
+    syn.prev_post_synapse = nil
+    syn.next_post_synapse = nil
   end
 
   alias connect add_post_synapse
@@ -126,25 +118,6 @@ class Neuron < NeuralEntity
 
   protected
 
-  #
-  # Find the synapse in the linked list that precedes +syn+, starting
-  # at synapse +first+ and using the +next_method+ chain (e.g.
-  # :next_pre_synapse or :next_post_synapse).
-  #
-  def find_preceding_synapse(syn, first, next_method)
-    prev, curr = nil, first
-
-    while true
-      break if curr == syn
-      break unless curr
-      prev = curr
-      curr = curr.send(next_method)
-    end
-
-    raise "Synapse not in pre synapse list" if curr != syn
-    return prev
-  end
-
   method :stimulate_pre_synapses, {:at => 'simtime'}, {:weight => 'real'}, %{
     for (Synapse *syn = @first_pre_synapse; syn != NULL; syn = syn->next_pre_synapse)
     {
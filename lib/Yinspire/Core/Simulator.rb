@@ -15,22 +15,89 @@ class Simulator
   property :event_counter, 'uint'
   property :fire_counter, 'uint'
 
-  stub_method :record_fire, {:at => 'simtime'},{:weight => 'real'},{:source => NeuralEntity}
+  #
+  # Fire events are not passed to Ruby one by one. They are collected
+  # and passed to record_fires in batches of +record_batch_size+
+  # events, and at the end of run.
+  #
+  property :record_batch_size, 'uint', :init => 4096
+
+  #
+  # Whether external fire events (without source) are recorded (see
+  # NeuralEntity#recorded).
+  #
+  property :record_external, 'bool', :init => true
 
   #
-  # Overwrite!
+  # The fire events of the current batch (or nil): their times and
+  # weights as native floats in a String ([at1, weight1, at2, ...] =
+  # record_buffer.unpack("f*")), and their sources in an Array (nil
+  # for external events).
   #
-  def record_fire(at, weight, source)
+  property :record_buffer
+  property :record_sources
+
+  method :record_fire, {:at => 'simtime'},{:weight => 'real'},{:source => NeuralEntity}, %{
+    float data[2] = {at, weight};
+
+    if (source ? !source->recorded : !@record_external) return;
+
+    if (NIL_P(@record_buffer))
+    {
+      @record_buffer = rb_str_buf_new(@record_batch_size * sizeof(data));
+      @record_sources = rb_ary_new2(@record_batch_size);
+    }
+
+    rb_str_buf_cat(@record_buffer, (const char*)data, sizeof(data));
+    rb_ary_push(@record_sources, source ? source->__obj__ : Qnil);
+
+    if (RARRAY_LEN(@record_sources) >= (long)@record_batch_size)
+    {
+      record_flush();
+    }
+  }
+
+  #
+  # Pass the fire events collected so far to record_fires.
+  #
+  method :record_flush, {}, %{
+    if (NIL_P(@record_buffer)) return;
+
+    VALUE buffer = @record_buffer;
+    VALUE sources = @record_sources;
+    @record_buffer = Qnil;
+    @record_sources = Qnil;
+    rb_funcall(__obj__, rb_intern("record_fires"), 2, buffer, sources);
+  }
+
+  #
+  # Overwrite! Called with a batch of fire events (see
+  # +record_buffer+).
+  #
+  def record_fires(buffer, sources)
   end
 
   attr_reader :entities
 
+  #
+  # Record only the fire events of the entities with one of the given
+  # +ids+ and +types+ (classes). nil means all.
+  #
+  def record_select(ids=nil, types=nil)
+    self.record_external = ids.nil? && types.nil?
+    @entities.each_value {|entity|
+      entity.recorded = (ids.nil? || ids.include?(entity.id)) &&
+                        (types.nil? || types.include?(entity.class))
+    }
+  end
+
   def initialize
     @entities = Hash.new
   end
 
   def run(stop_at=nil)
     schedule_run(stop_at || Infinity)
+    record_flush()
   end
  
 end
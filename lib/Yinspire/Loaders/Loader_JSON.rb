@@ -119,13 +119,6 @@ class Loader_JSON < Loader
   #
   # Every "section" is optional.
   #
-  # BUGS:
-  #
-  # The C++ version does not currently implement to specify an
-  # entity like this:
-  #
-  #   ['id1', 'Neuron_SRM01', {...}]
-  #
   def load_c(data)
     templates = data['templates'] || {}
     entities = data['entities'] || [] 
@@ -146,11 +139,7 @@ class Loader_JSON < Loader
         hash.update(template_data)
       end
 
-      if data
-        hash.update(data) 
-        raise # FIXME: C++ version is invalid, because it assume that there 
-              # is no data! 
-      end
+      hash.update(data) if data
 
       create_entity(type, id, hash)
     end
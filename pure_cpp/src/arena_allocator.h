@@ -0,0 +1,97 @@
+/*
+ * An arena (region) Allocator
+ *
+ * Memory is handed out from large blocks by bumping a pointer.
+ * Individual allocations cannot be released; all memory is released
+ * at once by the destructor (or release()).
+ */
+
+#ifndef __YINSPIRE__ARENA_ALLOCATOR__
+#define __YINSPIRE__ARENA_ALLOCATOR__
+
+#include <stdlib.h>
+
+class ArenaAllocator
+{
+    struct Block
+    {
+      Block *next_block;
+    };
+
+  public:
+
+    ArenaAllocator(size_t blocksize=1<<20)
+    {
+      this->blocklist = NULL;
+      this->pos = NULL;
+      this->end = NULL;
+      this->blocksize = blocksize;
+    }
+
+    ~ArenaAllocator()
+    {
+      release();
+    }
+
+    /*
+     * Returns +size+ bytes aligned to 8 bytes.
+     */
+    inline void*
+      allocate(size_t size)
+      {
+        size = (size + 7) & ~((size_t)7);
+
+        if ((size_t)(this->end - this->pos) < size) alloc_block(size);
+
+        void *ptr = this->pos;
+        this->pos += size;
+        return ptr;
+      }
+
+    void
+      release()
+      {
+        while (this->blocklist != NULL)
+        {
+          Block *next = this->blocklist->next_block;
+          ::free(this->blocklist);
+          this->blocklist = next;
+        }
+        this->pos = this->end = NULL;
+      }
+
+  protected:
+
+    void
+      alloc_block(size_t size)
+      {
+        /*
+         * The block header is padded to 16 bytes to keep the
+         * allocations aligned.
+         */
+        const size_t header = 16;
+        size_t bytes = (size > this->blocksize ? size : this->blocksize);
+        char *mem = (char*) malloc(header + bytes);
+
+        if (mem == NULL)
+        {
+          throw "memory allocation failed";
+        }
+
+        Block *block = (Block*) mem;
+        block->next_block = this->blocklist;
+        this->blocklist = block;
+
+        this->pos = mem + header;
+        this->end = this->pos + bytes;
+      }
+
+  private:
+
+    Block *blocklist;
+    char *pos;
+    char *end;
+    size_t blocksize;
+};
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * A blocking FIFO queue with a fixed capacity, used to connect the
+ * stages (threads) of a pipeline. Intended for one producer and one
+ * consumer.
+ *
+ * The time the producer (consumer) spent blocked in push() (pop())
+ * is accumulated in +push_wait+ (+pop_wait+).
+ */
+
+#ifndef __YINSPIRE__BOUNDED_QUEUE__
+#define __YINSPIRE__BOUNDED_QUEUE__
+
+#include "types.h"
+#include <pthread.h>
+#include <sys/time.h>
+#include <deque>
+
+template <typename T>
+class BoundedQueue
+{
+  public:
+
+    double push_wait;
+    double pop_wait;
+
+    BoundedQueue(uint capacity)
+    {
+      this->capacity = capacity;
+      this->closed = false;
+      this->push_wait = 0.0;
+      this->pop_wait = 0.0;
+      pthread_mutex_init(&this->mutex, NULL);
+      pthread_cond_init(&this->not_empty, NULL);
+      pthread_cond_init(&this->not_full, NULL);
+    }
+
+    ~BoundedQueue()
+    {
+      pthread_cond_destroy(&this->not_full);
+      pthread_cond_destroy(&this->not_empty);
+      pthread_mutex_destroy(&this->mutex);
+    }
+
+    /*
+     * Append +item+, blocking while the queue is full. Returns false
+     * (without appending) if the queue has been closed.
+     */
+    bool
+      push(const T &item)
+      {
+        pthread_mutex_lock(&this->mutex);
+        if (!this->closed && this->items.size() >= this->capacity)
+        {
+          double start = now();
+          while (!this->closed && this->items.size() >= this->capacity)
+            pthread_cond_wait(&this->not_full, &this->mutex);
+          this->push_wait += now() - start;
+        }
+
+        bool ok = !this->closed;
+        if (ok)
+        {
+          this->items.push_back(item);
+          pthread_cond_signal(&this->not_empty);
+        }
+        pthread_mutex_unlock(&this->mutex);
+        return ok;
+      }
+
+    /*
+     * Remove the first item into +item+, blocking while the queue is
+     * empty. Returns false if the queue is empty and closed.
+     */
+    bool
+      pop(T &item)
+      {
+        pthread_mutex_lock(&this->mutex);
+        if (!this->closed && this->items.empty())
+        {
+          double start = now();
+          while (!this->closed && this->items.empty())
+            pthread_cond_wait(&this->not_empty, &this->mutex);
+          this->pop_wait += now() - start;
+        }
+
+        bool ok = !this->items.empty();
+        if (ok)
+        {
+          item = this->items.front();
+          this->items.pop_front();
+          pthread_cond_signal(&this->not_full);
+        }
+        pthread_mutex_unlock(&this->mutex);
+        return ok;
+      }
+
+    /*
+     * No more items will be pushed. Wakes up all waiting threads.
+     * Items already in the queue can still be popped.
+     */
+    void
+      close()
+      {
+        pthread_mutex_lock(&this->mutex);
+        this->closed = true;
+        pthread_cond_broadcast(&this->not_empty);
+        pthread_cond_broadcast(&this->not_full);
+        pthread_mutex_unlock(&this->mutex);
+      }
+
+    static double
+      now()
+      {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return tv.tv_sec + tv.tv_usec / 1000000.0;
+      }
+
+  private:
+
+    std::deque<T> items;
+    uint capacity;
+    bool closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+};
+
+#endif
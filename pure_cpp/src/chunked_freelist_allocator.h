@@ -0,0 +1,113 @@
+/*
+ * A chunked freelist Allocator
+ *
+ * Copyright (c) 2007, 2008 by Michael Neumann (mneumann@ntecs.de)
+ *
+ * Memory is allocated in chunks of +chunksize+ elements of +size+ bytes
+ * each. Chunks are never freed except when the destructor is called.
+ * Released elements are put onto a freelist and are reused by the next
+ * call to allocate(), so allocating and releasing is O(1).
+ *
+ * Unlike the version in lib/Allocators this one hands out raw memory
+ * (e.g. for use in operator new/delete), so the freelist is threaded
+ * through the first word of each free element.
+ */
+
+#ifndef __YINSPIRE__CHUNKED_FREELIST_ALLOCATOR__
+#define __YINSPIRE__CHUNKED_FREELIST_ALLOCATOR__
+
+#include <assert.h>
+#include <stdlib.h>
+
+class ChunkedFreelistAllocator
+{
+    struct FreeElement
+    {
+      FreeElement *next;
+    };
+
+    struct Chunk
+    {
+      Chunk *next_chunk;
+    };
+
+  public:
+
+    ChunkedFreelistAllocator(size_t size, unsigned int chunksize)
+    {
+      this->freelist = NULL;
+      this->chunklist = NULL;
+      this->size = (size < sizeof(FreeElement) ? sizeof(FreeElement) : size);
+      this->chunksize = chunksize;
+    }
+
+    ~ChunkedFreelistAllocator()
+    {
+      while (this->chunklist != NULL)
+      {
+        Chunk *next = this->chunklist->next_chunk;
+        ::free(this->chunklist);
+        this->chunklist = next;
+      }
+    }
+
+    void*
+      allocate()
+      {
+        // alloc new chunk if no more free elements are available
+        if (this->freelist == NULL) alloc_chunk();
+
+        assert(this->freelist != NULL);
+
+        FreeElement *e = this->freelist;
+        this->freelist = e->next;
+
+        return e;
+      }
+
+    void
+      free(void *ptr)
+      {
+        FreeElement *e = (FreeElement*) ptr;
+        e->next = this->freelist;
+        this->freelist = e;
+      }
+
+  protected:
+
+    void
+      alloc_chunk()
+      {
+        /*
+         * The chunk header is padded to 16 bytes to keep the elements
+         * aligned.
+         */
+        const size_t header = 16;
+        char *mem = (char*) malloc(header + this->size * this->chunksize);
+
+        if (mem == NULL)
+        {
+          throw "memory allocation failed";
+        }
+
+        Chunk *new_chunk = (Chunk*) mem;
+        new_chunk->next_chunk = this->chunklist;
+        this->chunklist = new_chunk;
+
+        // put all elements of new chunk on freelist
+        char *array = mem + header;
+        for (unsigned int i=0; i<this->chunksize; i++)
+        {
+          free(array + i*this->size);
+        }
+      }
+
+  private:
+
+    FreeElement *freelist;
+    Chunk *chunklist;
+    size_t size;
+    unsigned int chunksize;
+};
+
+#endif
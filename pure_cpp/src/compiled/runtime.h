@@ -0,0 +1,430 @@
+/*
+ * Runtime support for nets compiled by NetCompiler.
+ *
+ * A compiled net is a single C++ file generated by "inspire --compile".
+ * It includes this header and defines the following:
+ *
+ *   net_size              number of neurons
+ *   net_fanout_start[]    CSR index into net_fanout (net_size+1 entries)
+ *   net_fanout[]          the outgoing edges of all neurons
+ *   net_ids[]             neuron ids (sorted by strcmp)
+ *   net_init[]            state of each neuron after loading
+ *   net_initial_stimuli[] content of the stimuli pq's after loading
+ *   net_initial_schedule[] content of the schedule pq after loading
+ *
+ *   net_stimulate(i, ...) dispatch to the model of neuron +i+
+ *   net_process(i, ...)   dispatch to the model of neuron +i+
+ *
+ * Synapses do not exist at runtime. Each Synapse is folded into the
+ * fan-out edge of it's pre Neuron. The parameters of each neuron
+ * class are compile-time constants, accessed through a struct +P+ of
+ * inline functions which is passed to the model templates below.
+ *
+ * The models below MUST behave exactly like their interpreted
+ * counterparts (e.g. Neuron_SRM_01), otherwise the results of a
+ * compiled net will differ from "inspire".
+ */
+
+#ifndef __YINSPIRE__COMPILED_RUNTIME__
+#define __YINSPIRE__COMPILED_RUNTIME__
+
+#include "types.h"
+#include "stimulus.h"
+#include "memory_allocator.h"
+#include "algo/indexed_binary_heap.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <iostream>
+
+/*
+ * An outgoing connection of a neuron, i.e. a folded Synapse.
+ */
+struct FanoutEdge
+{
+  uint target;
+  real weight;
+  simtime delay;
+};
+
+/*
+ * A stimulus in the stimuli pq of neuron +neuron+.
+ */
+struct InitialStimulus
+{
+  uint neuron;
+  simtime at;
+  real weight;
+};
+
+/*
+ * The state of neuron +i+ after loading is net_init[i].
+ */
+struct NeuronInit
+{
+  real mem_pot;
+  simtime last_spike_time;
+  simtime last_fire_time;
+};
+
+/*
+ * The mutable state of a neuron. Everything else is constant.
+ */
+struct NeuronState
+{
+  real mem_pot;
+  simtime last_spike_time;
+  simtime last_fire_time;
+  simtime schedule_at;
+  uint schedule_index;
+  BinaryHeap<Stimulus, MemoryAllocator<Stimulus> > stimuli_pq;
+};
+
+extern const uint net_size;
+extern const uint net_fanout_start[];
+extern const FanoutEdge net_fanout[];
+extern const char *const net_ids[];
+extern const NeuronInit net_init[];
+extern const uint net_initial_stimuli_size;
+extern const InitialStimulus net_initial_stimuli[];
+extern const uint net_initial_schedule_size;
+extern const uint net_initial_schedule[];
+extern const uint net_initial_event_counter;
+
+extern NeuronState net_state[];
+
+void net_stimulate(uint i, simtime at, real weight);
+void net_process(uint i, simtime at);
+
+static simtime net_stimuli_tolerance = 0.0;
+static uint net_stat_event_counter = 0;
+static uint net_stat_fire_counter = 0;
+
+/*
+ * Accessor for the schedule pq (see NeuralEntity).
+ */
+struct NetScheduleAcc
+{
+  inline static bool
+    less(const uint &a, const uint &b)
+    {
+      return (net_state[a].schedule_at < net_state[b].schedule_at);
+    }
+
+  inline static uint &
+    index(const uint &i)
+    {
+      return net_state[i].schedule_index;
+    }
+};
+
+static IndexedBinaryHeap<uint, MemoryAllocator<uint>, NetScheduleAcc> net_schedule_pq;
+
+/*
+ * See NeuralEntity::schedule.
+ */
+static inline void
+net_schedule(uint i, simtime at)
+{
+  if (net_state[i].schedule_at != at)
+  {
+    net_state[i].schedule_at = at;
+    net_schedule_pq.update(i);
+  }
+}
+
+static bool
+net_stimuli_accum(Stimulus &parent, const Stimulus &element, void *tolerance)
+{
+  if ((element.at - parent.at) > *((real*)tolerance)) return false;
+
+  if (isinf(element.weight))
+  {
+    return (isinf(parent.weight) ? true : false);
+  }
+
+  parent.weight += element.weight;
+  return true;
+}
+
+/*
+ * See NeuralEntity::stimuli_add.
+ */
+static void
+net_stimuli_add(uint i, simtime at, real weight)
+{
+  NeuronState &n = net_state[i];
+  Stimulus s; s.at = at; s.weight = weight;
+  if (net_stimuli_tolerance >= 0.0)
+  {
+    if (n.stimuli_pq.accumulate(s, net_stimuli_accum, &net_stimuli_tolerance)) return;
+  }
+  n.stimuli_pq.push(s);
+  net_schedule(i, n.stimuli_pq.top().at);
+}
+
+/*
+ * See NeuralEntity::stimuli_sum.
+ */
+static real
+net_stimuli_sum(uint i, simtime until)
+{
+  NeuronState &n = net_state[i];
+  real weight = 0.0;
+
+  while (!n.stimuli_pq.empty() && n.stimuli_pq.top().at <= until)
+  {
+    weight += n.stimuli_pq.top().weight;
+    n.stimuli_pq.pop();
+  }
+
+  if (!n.stimuli_pq.empty())
+  {
+    net_schedule(i, n.stimuli_pq.top().at);
+  }
+
+  return weight;
+}
+
+/*
+ * Neuron::fire_synapses plus Synapse::stimulate.
+ */
+static inline void
+net_fire_synapses(uint i, simtime at)
+{
+  const uint end = net_fanout_start[i+1];
+  for (uint e = net_fanout_start[i]; e < end; e++)
+  {
+    const FanoutEdge &edge = net_fanout[e];
+    net_stimulate(edge.target, at + edge.delay, edge.weight);
+  }
+}
+
+/*
+ * Neuron_SRM_01. These are instantiated once per neuron class, so the
+ * compiler decides what to inline into the dispatch switches.
+ */
+template <class P>
+void
+srm01_stimulate(uint i, simtime at, real weight)
+{
+  if (at >= net_state[i].last_fire_time + P::abs_refr_duration())
+  {
+    ++net_stat_event_counter;
+    net_stimuli_add(i, at, weight);
+  }
+}
+
+template <class P>
+void
+srm01_process(uint i, simtime at)
+{
+  NeuronState &n = net_state[i];
+  real weight = net_stimuli_sum(i, at);
+  const real delta = at - n.last_fire_time - P::abs_refr_duration();
+
+  if (delta < 0.0) return;
+
+  n.mem_pot = weight + n.mem_pot * real_exp( -(at - n.last_spike_time)/P::tau_m() );
+  n.last_spike_time = at;
+
+  const real dynamic_threshold = P::ref_weight() * real_exp(-delta/P::tau_ref());
+
+  if (n.mem_pot >= P::const_threshold() + dynamic_threshold)
+  {
+    ++net_stat_fire_counter;
+    n.mem_pot = 0.0;
+    n.last_fire_time = at;
+    net_fire_synapses(i, at);
+  }
+}
+
+/*
+ * Reset neuron +i+ to it's initial state.
+ */
+static void
+net_reset(uint i)
+{
+  NeuronState &n = net_state[i];
+  n.mem_pot = net_init[i].mem_pot;
+  n.last_spike_time = net_init[i].last_spike_time;
+  n.last_fire_time = net_init[i].last_fire_time;
+}
+
+static int
+net_lookup(const char *id)
+{
+  int lo = 0, hi = (int)net_size - 1;
+
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) / 2;
+    int c = strcmp(id, net_ids[mid]);
+    if (c == 0) return mid;
+    if (c < 0) hi = mid - 1; else lo = mid + 1;
+  }
+  return -1;
+}
+
+/*
+ * Load stimuli in the format of Loader_Spike:
+ *
+ *   Id1 weight1@time1 time2 time3 ...
+ *
+ * Lines beginning with "#" are comments.
+ */
+static void
+net_load_spikes(const char *filename)
+{
+  FILE *f = fopen(filename, "r");
+  if (f == NULL) throw "cannot open file";
+
+  char tok[256];
+  int c = getc(f);
+  int neuron = -1;
+  bool first = true;
+
+  while (c != EOF)
+  {
+    if (c == '\n')
+    {
+      first = true;
+      c = getc(f);
+      continue;
+    }
+    if (isspace(c))
+    {
+      c = getc(f);
+      continue;
+    }
+    if (c == '#' && first)
+    {
+      while (c != EOF && c != '\n') c = getc(f);
+      continue;
+    }
+
+    int len = 0;
+    while (c != EOF && !isspace(c))
+    {
+      if (len >= (int)sizeof(tok) - 1) throw "token too long";
+      tok[len++] = c;
+      c = getc(f);
+    }
+    tok[len] = '\000';
+
+    if (first)
+    {
+      neuron = net_lookup(tok);
+      if (neuron < 0) throw "unknown neuron id";
+      first = false;
+    }
+    else
+    {
+      char *at = strchr(tok, '@');
+      if (at != NULL)
+      {
+        *at = '\000';
+        net_stimulate(neuron, strtod(at+1, NULL), strtod(tok, NULL));
+      }
+      else
+      {
+        net_stimulate(neuron, strtod(tok, NULL), INFINITY);
+      }
+    }
+  }
+
+  fclose(f);
+}
+
+/*
+ * Restore the state the net had after "inspire" loaded it,
+ * including the events of the net.
+ */
+static void
+net_restore_initial()
+{
+  for (uint k = 0; k < net_initial_stimuli_size; k++)
+  {
+    const InitialStimulus &is = net_initial_stimuli[k];
+    Stimulus s; s.at = is.at; s.weight = is.weight;
+    net_state[is.neuron].stimuli_pq.push(s);
+  }
+
+  for (uint k = 0; k < net_initial_schedule_size; k++)
+  {
+    const uint i = net_initial_schedule[k];
+    net_state[i].schedule_at = net_state[i].stimuli_pq.top().at;
+    net_schedule_pq.push(i);
+  }
+
+  net_stat_event_counter = net_initial_event_counter;
+}
+
+/*
+ * See Simulator::run. Compiled nets never use stepped scheduling.
+ */
+static void
+net_run(simtime stop_at)
+{
+  while (!net_schedule_pq.empty())
+  {
+    const uint top = net_schedule_pq.top();
+    const simtime at = net_state[top].schedule_at;
+    if (at >= stop_at) break;
+    net_schedule_pq.pop();
+    net_process(top, at);
+  }
+}
+
+static int
+net_main(int argc, char **argv)
+{
+  simtime stop_at;
+  const char *spikes = NULL;
+
+  if (argc >= 2 && argc <= 4)
+  {
+    stop_at = atof(argv[1]);
+    if (argc >= 3) net_stimuli_tolerance = atof(argv[2]);
+    if (argc == 4) spikes = argv[3];
+  }
+  else
+  {
+    std::cout << "USAGE: " << argv[0] << " stop_at [tolerance [spikes]]" << std::endl;
+    return 1;
+  }
+
+  for (uint i = 0; i < net_size; i++)
+  {
+    net_state[i].schedule_at = INFINITY;
+    net_state[i].schedule_index = 0;
+    net_reset(i);
+  }
+
+  try
+  {
+    if (spikes != NULL)
+    {
+      net_load_spikes(spikes);
+    }
+    else
+    {
+      net_restore_initial();
+    }
+
+    net_run(stop_at);
+  }
+  catch (const char *err)
+  {
+    std::cerr << "error: " << err << std::endl;
+    return 1;
+  }
+
+  std::cout << net_stat_event_counter << std::endl;
+  std::cout << net_stat_fire_counter << std::endl;
+  return 0;
+}
+
+#endif
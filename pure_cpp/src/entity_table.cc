@@ -0,0 +1,125 @@
+#include "entity_table.h"
+#include <stdlib.h>
+
+EntityTable::EntityTable() : strings(1<<16)
+{
+  this->slots = NULL;
+  this->capacity = 0;
+  resize(64);
+}
+
+EntityTable::~EntityTable()
+{
+  free(this->slots);
+}
+
+/*
+ * FNV-1a
+ */
+uint32_t
+EntityTable::hash(const char *id, size_t len)
+{
+  uint32_t h = 2166136261U;
+  for (size_t i = 0; i < len; i++)
+  {
+    h ^= (unsigned char)id[i];
+    h *= 16777619U;
+  }
+  return h;
+}
+
+uint
+EntityTable::index(const char *id, size_t len) const
+{
+  const uint32_t h = hash(id, len);
+  const uint mask = this->capacity - 1;
+
+  for (uint s = h & mask; this->slots[s].index != ENTITY_NO_INDEX; s = (s + 1) & mask)
+  {
+    if (this->slots[s].hash == h)
+    {
+      const char *name = this->names[this->slots[s].index];
+      if (memcmp(name, id, len) == 0 && name[len] == '\000')
+        return this->slots[s].index;
+    }
+  }
+  return ENTITY_NO_INDEX;
+}
+
+uint
+EntityTable::insert(const char *id, size_t len, NeuralEntity *entity)
+{
+  const uint32_t h = hash(id, len);
+  uint mask = this->capacity - 1;
+  uint s;
+
+  for (s = h & mask; this->slots[s].index != ENTITY_NO_INDEX; s = (s + 1) & mask)
+  {
+    if (this->slots[s].hash == h)
+    {
+      const uint i = this->slots[s].index;
+      const char *name = this->names[i];
+      if (memcmp(name, id, len) == 0 && name[len] == '\000')
+      {
+        // the id was removed before, reuse it's index
+        if (this->entities[i] != NULL) throw "duplicate entity id";
+        this->entities[i] = entity;
+        return i;
+      }
+    }
+  }
+
+  char *name = (char*) this->strings.allocate(len + 1);
+  memcpy(name, id, len);
+  name[len] = '\000';
+
+  const uint i = this->names.size();
+  this->names.push_back(name);
+  this->entities.push_back(entity);
+
+  this->slots[s].hash = h;
+  this->slots[s].index = i;
+
+  if (2 * this->names.size() > this->capacity) resize(2 * this->capacity);
+
+  return i;
+}
+
+void
+EntityTable::reserve(uint n)
+{
+  if (n > this->names.capacity())
+  {
+    // keep growing geometrically when reserving repeatedly
+    size_t sz = MAX(n, 2 * this->names.capacity());
+    this->names.reserve(sz);
+    this->entities.reserve(sz);
+  }
+
+  uint cap = this->capacity;
+  while (cap < 2 * n) cap *= 2;
+  if (cap != this->capacity) resize(cap);
+}
+
+void
+EntityTable::resize(uint capacity)
+{
+  Slot *slots = (Slot*) malloc(sizeof(Slot) * capacity);
+  if (slots == NULL) throw "memory allocation failed";
+
+  for (uint s = 0; s < capacity; s++) slots[s].index = ENTITY_NO_INDEX;
+
+  const uint mask = capacity - 1;
+  for (uint o = 0; o < this->capacity; o++)
+  {
+    if (this->slots[o].index == ENTITY_NO_INDEX) continue;
+
+    uint s = this->slots[o].hash & mask;
+    while (slots[s].index != ENTITY_NO_INDEX) s = (s + 1) & mask;
+    slots[s] = this->slots[o];
+  }
+
+  free(this->slots);
+  this->slots = slots;
+  this->capacity = capacity;
+}
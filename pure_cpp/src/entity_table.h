@@ -0,0 +1,109 @@
+#ifndef __YINSPIRE__ENTITY_TABLE__
+#define __YINSPIRE__ENTITY_TABLE__
+
+#include "types.h"
+#include "arena_allocator.h"
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+class NeuralEntity;
+
+/*
+ * Index of an entity without an id.
+ */
+#define ENTITY_NO_INDEX 0xFFFFFFFF
+
+/*
+ * An id -> NeuralEntity mapping.
+ *
+ * Ids are interned into an arena and numbered densely in the order they
+ * are first inserted. The index of an id never changes, even if the
+ * entity is removed, so it can be used in place of the id by everything
+ * that runs after loading.
+ *
+ * Lookups use an open addressing hash table (linear probing) of
+ * indices. They do not modify the table and can be run concurrently.
+ */
+class EntityTable
+{
+    struct Slot
+    {
+      uint32_t hash;
+      uint32_t index;
+    };
+
+  public:
+
+    EntityTable();
+    ~EntityTable();
+
+    /*
+     * Insert +entity+ (which may be NULL, to just intern the id) under
+     * +id+ and return it's index. Throws if there already is an entity
+     * with this id.
+     */
+    uint insert(const char *id, size_t len, NeuralEntity *entity);
+
+    /*
+     * The index of +id+ or ENTITY_NO_INDEX if it was never inserted.
+     *
+     * O(1)
+     */
+    uint index(const char *id, size_t len) const;
+
+    /*
+     * The entity with +id+ or NULL.
+     *
+     * O(1)
+     */
+    inline NeuralEntity *
+      find(const char *id, size_t len) const
+      {
+        uint i = index(id, len);
+        return (i != ENTITY_NO_INDEX ? this->entities[i] : NULL);
+      }
+
+    inline NeuralEntity *find(const char *id) const { return find(id, strlen(id)); }
+
+    /*
+     * Remove the entity with +index+. It's id stays interned.
+     */
+    inline void remove(uint index) { this->entities[index] = NULL; }
+
+    inline void set(uint index, NeuralEntity *entity) { this->entities[index] = entity; }
+
+    /*
+     * Number of indices. Entities are at(0) ... at(size()-1), with NULL
+     * for removed entities.
+     */
+    inline uint size() const { return this->entities.size(); }
+
+    inline NeuralEntity *at(uint index) const { return this->entities[index]; }
+
+    inline const char *name(uint index) const { return this->names[index]; }
+
+    /*
+     * Prepare for +n+ ids.
+     */
+    void reserve(uint n);
+
+  protected:
+
+    static uint32_t hash(const char *id, size_t len);
+
+    void resize(uint capacity);
+
+    ArenaAllocator strings;
+    std::vector<const char*> names;
+    std::vector<NeuralEntity*> entities;
+
+    /*
+     * The hash table. +capacity+ is a power of two and at most half of
+     * the slots are used.
+     */
+    Slot *slots;
+    uint capacity;
+};
+
+#endif
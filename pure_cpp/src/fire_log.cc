@@ -0,0 +1,275 @@
+#include "fire_log.h"
+#include "mapped_file.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+FireLogWriter::FireLogWriter(const char *filename, uint capacity) : full(2), empty(2)
+{
+  FireLogHeader h;
+
+  this->capacity = MAX(capacity, 1);
+  this->num_records = 0;
+  this->write_failed = false;
+
+  this->file = fopen(filename, "wb");
+  if (this->file == NULL) throw "cannot open file";
+
+  // a log without ids until it is closed
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, FIRE_LOG_MAGIC, 8);
+  h.version = FIRE_LOG_VERSION;
+  h.byte_order = FIRE_LOG_BYTE_ORDER;
+  if (fwrite(&h, 1, sizeof(h), this->file) != sizeof(h))
+  {
+    fclose(this->file);
+    throw "write failed";
+  }
+
+  this->buffers[0] = (FireLogRecord*) malloc(2 * this->capacity * sizeof(FireLogRecord));
+  if (this->buffers[0] == NULL)
+  {
+    fclose(this->file);
+    throw "malloc failed";
+  }
+  this->buffers[1] = this->buffers[0] + this->capacity;
+
+  this->current.records = this->buffers[0];
+  this->current.size = 0;
+
+  Buffer other;
+  other.records = this->buffers[1];
+  other.size = 0;
+  this->empty.push(other);
+
+  if (pthread_create(&this->thread, NULL, run, this) != 0)
+  {
+    free(this->buffers[0]);
+    fclose(this->file);
+    throw "cannot create thread";
+  }
+}
+
+FireLogWriter::~FireLogWriter()
+{
+  if (this->file != NULL)
+  {
+    finish();
+    fclose(this->file);
+  }
+  free(this->buffers[0]);
+}
+
+void *
+FireLogWriter::run(void *arg)
+{
+  FireLogWriter *w = (FireLogWriter*) arg;
+  Buffer b;
+
+  while (w->full.pop(b))
+  {
+    if (!w->write_failed && fwrite(b.records, sizeof(FireLogRecord), b.size, w->file) != b.size)
+    {
+      // keep taking buffers, so that record() doesn't block forever
+      w->write_failed = true;
+    }
+    b.size = 0;
+    w->empty.push(b);
+  }
+  return NULL;
+}
+
+void
+FireLogWriter::flush()
+{
+  this->num_records += this->current.size;
+  this->full.push(this->current);
+  this->empty.pop(this->current);
+}
+
+void
+FireLogWriter::finish()
+{
+  if (this->current.size > 0)
+  {
+    this->num_records += this->current.size;
+    this->full.push(this->current);
+    this->current.size = 0;
+  }
+  this->full.close();
+  pthread_join(this->thread, NULL);
+  this->empty.close();
+}
+
+void
+FireLogWriter::close(const EntityTable &entities)
+{
+  FireLogHeader h;
+  std::vector<uint32_t> ids(entities.size());
+  std::string strings;
+
+  finish();
+
+  for (uint i = 0; i < entities.size(); i++)
+  {
+    ids[i] = strings.size();
+    strings.append(entities.name(i));
+    strings.push_back('\0');
+  }
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, FIRE_LOG_MAGIC, 8);
+  h.version = FIRE_LOG_VERSION;
+  h.byte_order = FIRE_LOG_BYTE_ORDER;
+  h.num_records = this->num_records;
+  h.num_ids = ids.size();
+  h.strings_size = strings.size();
+  h.off_ids = sizeof(h) + this->num_records * sizeof(FireLogRecord);
+  h.off_strings = h.off_ids + ids.size() * sizeof(uint32_t);
+
+  bool ok = !this->write_failed &&
+    (ids.empty() || fwrite(&ids[0], sizeof(uint32_t), ids.size(), this->file) == ids.size()) &&
+    fwrite(strings.data(), 1, strings.size(), this->file) == strings.size() &&
+    fseek(this->file, 0, SEEK_SET) == 0 &&
+    fwrite(&h, 1, sizeof(h), this->file) == sizeof(h);
+
+  ok = (fclose(this->file) == 0) && ok;
+  this->file = NULL;
+  if (!ok) throw "write failed";
+}
+
+FireLogReader::FireLogReader(const char *filename)
+{
+  this->file = fopen(filename, "rb");
+  if (this->file == NULL) throw "cannot open file";
+
+  try
+  {
+    FireLogHeader &h = this->header;
+    if (fread(&h, 1, sizeof(h), this->file) != sizeof(h) ||
+        memcmp(h.magic, FIRE_LOG_MAGIC, 8) != 0 || h.byte_order != FIRE_LOG_BYTE_ORDER)
+    {
+      throw "invalid fire log";
+    }
+    if (h.version != FIRE_LOG_VERSION)
+    {
+      throw "unsupported fire log version";
+    }
+
+    this->remaining = h.num_records;
+    if (h.off_ids != 0)
+    {
+      this->ids.resize(h.num_ids);
+      this->strings.resize(h.strings_size + 1, '\0');
+      if (fseek(this->file, h.off_ids, SEEK_SET) != 0 ||
+          fread(this->ids.empty() ? NULL : &this->ids[0], sizeof(uint32_t), this->ids.size(), this->file) != this->ids.size() ||
+          fread(&this->strings[0], 1, h.strings_size, this->file) != h.strings_size)
+      {
+        throw "invalid fire log";
+      }
+    }
+    else
+    {
+      // not closed, the records extend to the end of the file
+      fseek(this->file, 0, SEEK_END);
+      this->remaining = (ftell(this->file) - sizeof(h)) / sizeof(FireLogRecord);
+    }
+    fseek(this->file, sizeof(h), SEEK_SET);
+  }
+  catch (...)
+  {
+    fclose(this->file);
+    throw;
+  }
+
+  this->records.resize(65536);
+  this->pos = this->records.size();
+}
+
+FireLogReader::~FireLogReader()
+{
+  fclose(this->file);
+}
+
+bool
+FireLogReader::next(FireLogRecord &r)
+{
+  if (this->pos == this->records.size())
+  {
+    if (this->remaining == 0) return false;
+
+    const size_t n = MIN(this->remaining, (uint64_t)this->records.size());
+    if (fread(&this->records[this->records.size() - n], sizeof(FireLogRecord), n, this->file) != n)
+    {
+      throw "invalid fire log";
+    }
+    this->remaining -= n;
+    this->pos = this->records.size() - n;
+  }
+  r = this->records[this->pos++];
+  return true;
+}
+
+bool
+FireLogReader::is_fire_log(const char *filename)
+{
+  return MappedFile::has_magic(filename, FIRE_LOG_MAGIC);
+}
+
+void
+FireLogReader::format_real(char *buf, size_t size, real value)
+{
+  if (isnan(value))
+  {
+    snprintf(buf, size, "NaN");
+    return;
+  }
+  if (isinf(value))
+  {
+    snprintf(buf, size, (value < 0 ? "-Infinity" : "Infinity"));
+    return;
+  }
+
+  for (int digits = 1; digits <= 9; digits++)
+  {
+    snprintf(buf, size, "%.*g", digits, value);
+    if ((real)strtod(buf, NULL) == value) break;
+  }
+  if (strpbrk(buf, ".en") == NULL) strncat(buf, ".0", size - strlen(buf) - 1);
+}
+
+void
+FireLogReader::write_text(const char *filename, const char *out)
+{
+  FireLogReader log(filename);
+  FireLogRecord r;
+  char weight[32], at[32];
+
+  FILE *o = (strcmp(out, "-") == 0 ? stdout : fopen(out, "w"));
+  if (o == NULL) throw "cannot open file";
+
+  try
+  {
+    while (log.next(r))
+    {
+      format_real(weight, sizeof(weight), r.weight);
+      format_real(at, sizeof(at), r.at);
+
+      const char *id = log.id(r.entity);
+      if (id != NULL)
+        fprintf(o, "%s\t%s@%s\n", id, weight, at);
+      else if (r.entity != ENTITY_NO_INDEX && !log.has_ids())
+        fprintf(o, "%u\t%s@%s\n", r.entity, weight, at);
+      else
+        fprintf(o, "\t%s@%s\n", weight, at);
+    }
+  }
+  catch (...)
+  {
+    if (o != stdout) fclose(o);
+    throw;
+  }
+  if (o != stdout) fclose(o);
+}
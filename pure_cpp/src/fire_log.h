@@ -0,0 +1,206 @@
+#ifndef __YINSPIRE__FIRE_LOG__
+#define __YINSPIRE__FIRE_LOG__
+
+#include "types.h"
+#include "entity_table.h"
+#include "bounded_queue.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <vector>
+
+/*
+ * A binary log of fire events.
+ *
+ * Layout (native byte order):
+ *
+ *   FireLogHeader
+ *   records  FireLogRecord[num_records]
+ *   ids      uint32_t[num_ids]  (string offsets, entity index -> id)
+ *   strings  NUL-terminated strings
+ *
+ * The ids are written when the log is closed. A log that was not
+ * closed has no ids and +num_records+ is zero; it's records then
+ * extend to the end of the file.
+ */
+
+#define FIRE_LOG_MAGIC "YINFIRES"
+#define FIRE_LOG_VERSION 1
+#define FIRE_LOG_BYTE_ORDER 0x01020304
+
+struct FireLogHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+
+  uint64_t num_records;
+  uint32_t num_ids;
+  uint32_t reserved;
+  uint64_t strings_size;
+
+  uint64_t off_ids;
+  uint64_t off_strings;
+};
+
+struct FireLogRecord
+{
+  /*
+   * Index of the entity (see EntityTable), ENTITY_NO_INDEX for
+   * anonymous ones.
+   */
+  uint32_t entity;
+  simtime at;
+  real weight;
+};
+
+/*
+ * Records fire events into a FireLog file.
+ *
+ * Records are appended to one of two buffers while a background
+ * thread writes the other one to the file, so record() only blocks
+ * if the disk cannot keep up.
+ */
+class FireLogWriter
+{
+    struct Buffer
+    {
+      FireLogRecord *records;
+      uint size;
+    };
+
+    FILE *file;
+    pthread_t thread;
+
+    /*
+     * The memory of both buffers (buffers[1] is part of buffers[0]).
+     */
+    FireLogRecord *buffers[2];
+
+    /*
+     * The buffer being filled.
+     */
+    Buffer current;
+    uint capacity;
+
+    /*
+     * Full buffers to be written, and written buffers to be reused.
+     */
+    BoundedQueue<Buffer> full;
+    BoundedQueue<Buffer> empty;
+
+    uint64_t num_records;
+    bool write_failed;
+
+  public:
+
+    /*
+     * Open +filename+ for writing with buffers of +capacity+ records.
+     */
+    FireLogWriter(const char *filename, uint capacity=65536);
+
+    /*
+     * Closes the log without ids if close() was not called.
+     */
+    ~FireLogWriter();
+
+    inline void
+      record(uint32_t entity, simtime at, real weight)
+      {
+        if (this->current.size == this->capacity) flush();
+        FireLogRecord &r = this->current.records[this->current.size++];
+        r.entity = entity;
+        r.at = at;
+        r.weight = weight;
+      }
+
+    /*
+     * Write the remaining records and the ids of +entities+ and close
+     * the file.
+     */
+    void close(const EntityTable &entities);
+
+    /*
+     * Time (in seconds) record() was blocked waiting for the
+     * background thread.
+     */
+    inline double wait_time() const { return this->empty.pop_wait; }
+
+  protected:
+
+    /*
+     * Hand the current buffer to the background thread and continue
+     * with the other one.
+     */
+    void flush();
+
+    /*
+     * Stop the background thread after it wrote all full buffers.
+     */
+    void finish();
+
+    static void *run(void *arg);
+};
+
+/*
+ * Reads the records of a FireLog one by one.
+ */
+class FireLogReader
+{
+    FILE *file;
+    FireLogHeader header;
+    std::vector<uint32_t> ids;
+    std::vector<char> strings;
+
+    std::vector<FireLogRecord> records;
+    size_t pos;
+    uint64_t remaining;
+
+  public:
+
+    FireLogReader(const char *filename);
+    ~FireLogReader();
+
+    /*
+     * Read the next record into +r+. Returns false at the end of the
+     * log.
+     */
+    bool next(FireLogRecord &r);
+
+    /*
+     * The id of entity +index+, or NULL if it is unknown (anonymous
+     * or the log was not closed).
+     */
+    inline const char *
+      id(uint32_t index) const
+      {
+        if (index >= this->ids.size() || this->ids[index] >= this->header.strings_size) return NULL;
+        return &this->strings[this->ids[index]];
+      }
+
+    /*
+     * Whether the log has ids, i.e. was closed.
+     */
+    inline bool has_ids() const { return this->header.off_ids != 0; }
+
+    /*
+     * Convert the log in +filename+ to text in the format of
+     * bin/yinspire ("id\tweight@at" per line). +out+ is a filename or
+     * "-" for stdout. Logs that were not closed have entity indices
+     * instead of ids.
+     */
+    static void write_text(const char *filename, const char *out);
+
+    /*
+     * Returns true if +filename+ starts with FIRE_LOG_MAGIC.
+     */
+    static bool is_fire_log(const char *filename);
+
+    /*
+     * Format +value+ like Ruby's Float#to_s, i.e. with the fewest
+     * digits that read back as the same float.
+     */
+    static void format_real(char *buf, size_t size, real value);
+};
+
+#endif
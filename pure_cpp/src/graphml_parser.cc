@@ -0,0 +1,512 @@
+#include "graphml_parser.h"
+#include "text_reader.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <set>
+#include <vector>
+
+/*
+ * GraphML types and the entity types they are loaded as.
+ */
+static const char *graphml_types[][2] = {
+  {"NEURONTYPE_KBLIF", "Neuron_SRM_01"},
+  {"NEURONTYPE_EKERNEL", "Neuron_SRM_02"},
+  {"SYNAPSE_DEFAULT", "Synapse"},
+  {"SYNAPSE_HEBB", "Synapse_Hebb"},
+  {NULL, NULL}
+};
+
+/*
+ * GraphML data keys and the properties they are loaded as.
+ */
+static const char *graphml_params[][2] = {
+  {"absRefPeriod", "abs_refr_duration"},
+  {"neuronLFT", "last_fire_time"},
+  {"neuronLSET", "last_spike_time"},
+  {"neuron_tauM", "tau_m"},
+  {"neuron_tauRef", "tau_ref"},
+  {"neuron_constThreshold", "const_threshold"},
+  {"neuron_refWeight", "ref_weight"},
+  {"neuron_arpTime", "abs_refr_duration"},
+  {"synapse_weight", "weight"},
+  {"synapse_delay", "delay"},
+  {"neuronPSP", "mem_pot"},
+  {"neuronReset", "reset"},
+  {"neuron_tauRecov", "tau_ref"},
+  {"neuron_uReset", "u_reset"},
+  {"neuron_threshold", "const_threshold"},
+  {NULL, NULL}
+};
+
+static const char *
+graphml_lookup(const char *table[][2], const std::string &name)
+{
+  for (uint i = 0; table[i][0] != NULL; i++)
+  {
+    if (name == table[i][0]) return table[i][1];
+  }
+  return NULL;
+}
+
+/*
+ * A start or end tag with it's attributes.
+ */
+struct XmlTag
+{
+  std::string name;
+  std::vector<std::pair<std::string, std::string> > attrs;
+  bool end;
+  bool empty;
+
+  ~XmlTag();
+
+  const std::string *
+    attr(const char *name) const
+    {
+      for (uint i = 0; i < this->attrs.size(); i++)
+      {
+        if (this->attrs[i].first == name) return &this->attrs[i].second;
+      }
+      return NULL;
+    }
+};
+
+/*
+ * Out of line, as it is not worth inlining (-Winline).
+ */
+XmlTag::~XmlTag()
+{
+}
+
+class GraphMLScanner
+{
+    TextReader &r;
+    NetStreamHandler *handler;
+
+    /*
+     * Data key -> the element it is for.
+     */
+    std::map<std::string, std::string> keys;
+
+    /*
+     * GraphML types passed to the handler as templates.
+     */
+    std::set<std::string> templates;
+
+    std::string default_neuron_type;
+    std::string default_synapse_type;
+
+    /*
+     * (source, edge, target) of all edges of the graph.
+     */
+    std::vector<std::string> edges;
+
+    std::string text;
+
+  public:
+
+    GraphMLScanner(TextReader &reader, NetStreamHandler *handler) : r(reader)
+    {
+      this->handler = handler;
+    }
+
+    ~GraphMLScanner();
+
+    void
+      scan()
+      {
+        XmlTag tag;
+        bool has_graph = false;
+
+        if (!read_tag(tag, false) || tag.end || tag.name != "graphml")
+        {
+          this->r.error("graphml expected");
+        }
+        if (tag.empty) return;
+
+        while (read_tag(tag, false) && !tag.end)
+        {
+          if (tag.name == "key")
+          {
+            const std::string *id = tag.attr("id");
+            const std::string *for_el = tag.attr("for");
+            if (id == NULL) this->r.error("key without id");
+            if (this->keys.count(*id) > 0) this->r.error("duplicate key");
+            this->keys[*id] = (for_el != NULL ? *for_el : "all");
+            skip_element(tag);
+          }
+          else if (tag.name == "graph" && !has_graph)
+          {
+            has_graph = true;
+            scan_graph(tag);
+          }
+          else
+          {
+            skip_element(tag);
+          }
+        }
+      }
+
+  protected:
+
+    /*
+     * Read the next tag, skipping text (or appending it to +text+ if
+     * +keep_text+), comments and processing instructions. Returns false
+     * at the end of input.
+     */
+    bool
+      read_tag(XmlTag &tag, bool keep_text)
+      {
+        int c;
+
+        while (true)
+        {
+          while ((c = this->r.get()) != '<')
+          {
+            if (c == -1) return false;
+            if (keep_text) this->text.push_back(c);
+          }
+
+          c = this->r.peek();
+          if (c == '?')
+          {
+            skip_past("?>");
+          }
+          else if (c == '!')
+          {
+            this->r.get();
+            if (this->r.skip('-'))
+            {
+              skip_past("-->");
+            }
+            else if (this->r.skip('['))
+            {
+              // <![CDATA[ ... ]]>
+              std::string cdata;
+              this->r.read_until('[', cdata);
+              size_t start = this->text.size();
+              read_past("]]>", this->text);
+              if (!keep_text) this->text.resize(start);
+            }
+            else
+            {
+              skip_past(">");
+            }
+          }
+          else
+          {
+            break;
+          }
+        }
+
+        tag.attrs.clear();
+        tag.end = this->r.skip('/');
+        tag.empty = false;
+        read_name(tag.name, '=');
+
+        while (true)
+        {
+          this->r.skip_ws(-1);
+          c = this->r.get();
+          if (c == '>') break;
+          if (c == '/' && this->r.get() == '>')
+          {
+            tag.empty = true;
+            break;
+          }
+          if (c == -1 || tag.end) this->r.error("invalid tag");
+
+          tag.attrs.push_back(std::make_pair(std::string(1, (char)c), std::string()));
+          std::pair<std::string, std::string> &attr = tag.attrs.back();
+          std::string rest;
+          read_name(rest, '=');
+          attr.first.append(rest);
+
+          this->r.skip_ws(-1);
+          if (!this->r.skip('=')) this->r.error("\"=\" expected");
+          this->r.skip_ws(-1);
+
+          int quote = this->r.get();
+          if (quote != '"' && quote != '\'') this->r.error("quote expected");
+          this->r.read_until(quote, attr.second);
+          decode(attr.second);
+        }
+        return true;
+      }
+
+    void
+      read_name(std::string &name, int delim)
+      {
+        int c;
+        name.clear();
+        while ((c = this->r.peek()) != -1 && !isspace(c) && c != '>' && c != '/' && c != delim)
+        {
+          name.push_back(this->r.get());
+        }
+      }
+
+    /*
+     * Consume everything up to and including +end+, appending it
+     * (without +end+) to +str+.
+     */
+    void
+      read_past(const char *end, std::string &str)
+      {
+        const size_t len = strlen(end);
+        int c;
+
+        while ((c = this->r.get()) != -1)
+        {
+          str.push_back(c);
+          if (str.size() >= len && str.compare(str.size() - len, len, end) == 0)
+          {
+            str.resize(str.size() - len);
+            return;
+          }
+        }
+        this->r.error("unexpected end of file");
+      }
+
+    void
+      skip_past(const char *end)
+      {
+        std::string str;
+        read_past(end, str);
+      }
+
+    /*
+     * Skip the contents and the end tag of the element started with
+     * +tag+.
+     */
+    void
+      skip_element(const XmlTag &tag)
+      {
+        XmlTag child;
+
+        if (tag.empty) return;
+        while (read_tag(child, false))
+        {
+          if (child.end) return;
+          skip_element(child);
+        }
+        this->r.error("unexpected end of file");
+      }
+
+    /*
+     * The text of the element started with +tag+ without leading and
+     * trailing whitespace.
+     */
+    const std::string &
+      read_text(const XmlTag &tag)
+      {
+        XmlTag child;
+
+        this->text.clear();
+        if (tag.empty) return this->text;
+
+        while (read_tag(child, true))
+        {
+          if (child.end)
+          {
+            decode(this->text);
+            size_t first = this->text.find_first_not_of(" \t\r\n");
+            if (first == std::string::npos) this->text.clear();
+            else this->text = this->text.substr(first, this->text.find_last_not_of(" \t\r\n") - first + 1);
+            return this->text;
+          }
+          skip_element(child);
+        }
+        this->r.error("unexpected end of file");
+        return this->text;
+      }
+
+    static void
+      decode(std::string &str)
+      {
+        if (str.find('&') == std::string::npos) return;
+
+        std::string out;
+        for (size_t i = 0; i < str.size(); i++)
+        {
+          size_t semi;
+          if (str[i] != '&' || (semi = str.find(';', i)) == std::string::npos)
+          {
+            out.push_back(str[i]);
+            continue;
+          }
+
+          std::string entity = str.substr(i + 1, semi - i - 1);
+          if (entity == "amp") out.push_back('&');
+          else if (entity == "lt") out.push_back('<');
+          else if (entity == "gt") out.push_back('>');
+          else if (entity == "quot") out.push_back('"');
+          else if (entity == "apos") out.push_back('\'');
+          else if (entity.size() > 1 && entity[0] == '#')
+          {
+            long code = (entity[1] == 'x' ? strtol(entity.c_str() + 2, NULL, 16) : strtol(entity.c_str() + 1, NULL, 10));
+            out.push_back((char)code);
+          }
+          else
+          {
+            out.append(str, i, semi - i + 1);
+          }
+          i = semi;
+        }
+        str.swap(out);
+      }
+
+    /*
+     * Whether data +key+ may be used in an element +el+.
+     */
+    void
+      check_key(const std::string &key, const char *el)
+      {
+        std::map<std::string, std::string>::iterator it = this->keys.find(key);
+        if (it == this->keys.end() || (it->second != el && it->second != "all"))
+        {
+          this->r.error("undefined key");
+        }
+      }
+
+    void
+      scan_graph(const XmlTag &graph)
+      {
+        XmlTag tag;
+
+        if (graph.empty) return;
+
+        while (read_tag(tag, false) && !tag.end)
+        {
+          if (tag.name == "node")
+          {
+            scan_entity(tag, false);
+          }
+          else if (tag.name == "edge")
+          {
+            scan_entity(tag, true);
+          }
+          else if (tag.name == "data")
+          {
+            const std::string *key = tag.attr("key");
+            if (key == NULL) this->r.error("data without key");
+            check_key(*key, "graph");
+
+            if (*key == "graph_default_neuron_type") this->default_neuron_type = read_text(tag);
+            else if (*key == "graph_default_synapse_type") this->default_synapse_type = read_text(tag);
+            else skip_element(tag);
+          }
+          else
+          {
+            skip_element(tag);
+          }
+        }
+
+        for (uint i = 0; i < this->edges.size(); i += 3)
+        {
+          this->handler->on_connections(this->edges[i]);
+          this->handler->on_connection(this->edges[i+1]);
+          this->handler->on_connections(this->edges[i+1]);
+          this->handler->on_connection(this->edges[i+2]);
+        }
+        this->edges.clear();
+      }
+
+    /*
+     * A node (Neuron) or an edge (Synapse).
+     */
+    void
+      scan_entity(const XmlTag &el, bool edge)
+      {
+        const char *kind = (edge ? "edge" : "node");
+        const char *type_key = (edge ? "synapse_type" : "neuron_type");
+        std::string type = (edge ? this->default_synapse_type : this->default_neuron_type);
+        jsonHash *props = NULL;
+        XmlTag tag;
+
+        const std::string *id = el.attr("id");
+        if (id == NULL) this->r.error("id missing");
+        std::string entity_id = *id;
+
+        if (edge)
+        {
+          const std::string *source = el.attr("source");
+          const std::string *target = el.attr("target");
+          if (source == NULL || target == NULL) this->r.error("edge without source or target");
+          this->edges.push_back(*source);
+          this->edges.push_back(entity_id);
+          this->edges.push_back(*target);
+        }
+
+        try
+        {
+          if (!el.empty)
+          {
+            while (read_tag(tag, false) && !tag.end)
+            {
+              if (tag.name != "data")
+              {
+                skip_element(tag);
+                continue;
+              }
+
+              const std::string *key = tag.attr("key");
+              if (key == NULL) this->r.error("data without key");
+              check_key(*key, kind);
+              std::string name = *key;
+
+              const std::string &value = read_text(tag);
+              if (name == type_key)
+              {
+                type = value;
+                continue;
+              }
+
+              const char *param = graphml_lookup(graphml_params, name);
+              if (param == NULL) this->r.error("unknown GraphML key");
+
+              if (props == NULL) props = new jsonHash();
+              props->set(param, this->r.to_number(value));
+            }
+          }
+
+          if (graphml_lookup(graphml_types, type) == NULL) this->r.error("unknown GraphML type");
+
+          if (this->templates.insert(type).second)
+          {
+            jsonHash *empty = new jsonHash();
+            try
+            {
+              this->handler->on_template(type, graphml_lookup(graphml_types, type), empty);
+            }
+            catch (...)
+            {
+              empty->ref_decr();
+              throw;
+            }
+            empty->ref_decr();
+          }
+
+          this->handler->on_entity(entity_id, type, props);
+        }
+        catch (...)
+        {
+          if (props != NULL) props->ref_decr();
+          throw;
+        }
+        if (props != NULL) props->ref_decr();
+      }
+};
+
+GraphMLScanner::~GraphMLScanner()
+{
+}
+
+void
+GraphMLParser::parse_file(const char *filename, NetStreamHandler *handler)
+{
+  TextReader reader(filename);
+  GraphMLScanner scanner(reader, handler);
+  scanner.scan();
+}
@@ -0,0 +1,27 @@
+#ifndef __YINSPIRE__GRAPHML_PARSER__
+#define __YINSPIRE__GRAPHML_PARSER__
+
+#include "net_stream.h"
+
+/*
+ * Parses a net in GraphML format (see Loader_GraphML.rb and
+ * examples/nets/skorpion.graphml) without building a DOM.
+ *
+ * Nodes become Neurons and edges Synapses connecting their source
+ * with their target. Their types are given by the "neuron_type" and
+ * "synapse_type" data (or the graph's defaults) and passed to the
+ * handler as templates named after the GraphML type (e.g.
+ * "NEURONTYPE_KBLIF"). The remaining data are the properties of the
+ * entity. Only the first graph is loaded.
+ *
+ * The connections are passed to the handler at the end of the graph,
+ * so edges may refer to nodes which follow them.
+ */
+class GraphMLParser
+{
+  public:
+
+    static void parse_file(const char *filename, NetStreamHandler *handler);
+};
+
+#endif
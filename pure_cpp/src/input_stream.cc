@@ -0,0 +1,120 @@
+#include "input_stream.h"
+#include "stimulus.h"
+#include <math.h>
+#include <algorithm>
+
+class InputBuffer::Stream : public InputStream
+{
+    const InputBuffer *buffer;
+    uint pos;
+    uint end;
+
+    /*
+     * weights[pos + weight_offset] is the weight of event +pos+.
+     */
+    bool weighted;
+    long weight_offset;
+
+  public:
+
+    Stream(const InputBuffer *buffer, const Range &range)
+    {
+      this->buffer = buffer;
+      this->entity = range.entity;
+      this->pos = range.first;
+      this->end = range.end;
+      this->weighted = (range.weights >= 0);
+      this->weight_offset = (long)range.weights - (long)range.first;
+      load();
+    }
+
+    virtual bool
+      next()
+      {
+        if (++this->pos >= this->end) return false;
+        load();
+        return true;
+      }
+
+  protected:
+
+    inline void
+      load()
+      {
+        this->at = this->buffer->times[this->pos];
+        this->weight = (this->weighted ? this->buffer->weights[this->pos + this->weight_offset] : INFINITY);
+      }
+};
+
+InputBuffer::InputBuffer()
+{
+  this->finished = 0;
+}
+
+void
+InputBuffer::add(uint entity, simtime at, real weight)
+{
+  if (this->ranges.size() == this->finished || this->ranges.back().entity != entity)
+  {
+    Range r;
+    r.entity = entity;
+    r.first = r.end = this->times.size();
+    r.weights = -1;
+    this->ranges.push_back(r);
+  }
+
+  Range &r = this->ranges.back();
+
+  if (r.weights < 0 && !isinf(weight))
+  {
+    // the events so far had no weight
+    r.weights = this->weights.size();
+    this->weights.resize(this->weights.size() + (r.end - r.first), INFINITY);
+  }
+  if (r.weights >= 0) this->weights.push_back(weight);
+
+  this->times.push_back(at);
+  ++r.end;
+}
+
+static bool
+stimulus_less(const Stimulus &a, const Stimulus &b)
+{
+  return Stimulus::less(a, b);
+}
+
+void
+InputBuffer::finish(std::vector<InputStream*> &streams)
+{
+  std::vector<Stimulus> events;
+
+  for (; this->finished < this->ranges.size(); this->finished++)
+  {
+    const Range &r = this->ranges[this->finished];
+    float *t = &this->times[r.first];
+    const uint n = r.end - r.first;
+
+    if (r.weights < 0)
+    {
+      std::stable_sort(t, t + n);
+    }
+    else
+    {
+      float *w = &this->weights[r.weights];
+      events.resize(n);
+      for (uint i = 0; i < n; i++)
+      {
+        events[i].at = t[i];
+        events[i].weight = w[i];
+      }
+      std::stable_sort(events.begin(), events.end(), stimulus_less);
+      for (uint i = 0; i < n; i++)
+      {
+        t[i] = events[i].at;
+        w[i] = events[i].weight;
+      }
+    }
+
+    streams.push_back(new Stream(this, r));
+  }
+}
@@ -0,0 +1,99 @@
+#ifndef __YINSPIRE__INPUT_STREAM__
+#define __YINSPIRE__INPUT_STREAM__
+
+#include "types.h"
+#include <vector>
+
+/*
+ * The input events (external stimuli) of one entity in time order.
+ *
+ * The Simulator passes the events of all input streams to their
+ * entities only shortly before it reaches their time, so the stimuli
+ * heaps of the entities only hold what is actually in flight.
+ */
+class InputStream
+{
+  public:
+
+    /*
+     * Index of the entity (see Simulator::entity_at).
+     */
+    uint entity;
+
+    /*
+     * The current event.
+     */
+    simtime at;
+    real weight;
+
+    virtual ~InputStream() {}
+
+    /*
+     * Advance to the next event. Returns false if there is none.
+     */
+    virtual bool next() = 0;
+
+    /*
+     * Accessor function for BinaryHeap
+     */
+    inline static bool
+      less(const InputStream *a, const InputStream *b)
+      {
+        return (a->at < b->at);
+      }
+};
+
+/*
+ * Keeps the events of loaded nets in memory in compact form (4 bytes
+ * per event, 8 if the events of an entity have weights other than
+ * Infinity) and provides them as InputStreams.
+ */
+class InputBuffer
+{
+    struct Range
+    {
+      uint entity;
+      uint first;
+      uint end;
+
+      /*
+       * Offset of the weights of the range in +weights+, or -1 if
+       * they are all Infinity.
+       */
+      int weights;
+    };
+
+    class Stream;
+
+    std::vector<float> times;
+    std::vector<float> weights;
+    std::vector<Range> ranges;
+
+    /*
+     * Ranges before +finished+ have been handed out by finish().
+     */
+    uint finished;
+
+  public:
+
+    InputBuffer();
+
+    /*
+     * Add an event. Consecutive events of the same entity form one
+     * stream and need not be ordered.
+     */
+    void add(uint entity, simtime at, real weight);
+
+    /*
+     * Sort the events added since the last call and append a stream
+     * for each entity to +streams+ (which the caller has to delete).
+     */
+    void finish(std::vector<InputStream*> &streams);
+
+    /*
+     * Number of events.
+     */
+    inline uint size() const { return this->times.size(); }
+};
+
+#endif
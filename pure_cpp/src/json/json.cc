@@ -1,52 +1,46 @@
 #include "json.h"
 #include <string.h>
 #include <math.h>
+#include <stdlib.h>
 
 /* TODO:
  *   output indentation
  *   escape string (\0 characters in string?)
  */
 
-struct jsonArrayItem
+/*
+ * Grow +items+ (of +capacity+ elements) to at least +size+ elements.
+ * Returns the new capacity.
+ */
+template <typename T>
+static inline int grow(T**& items, int capacity, int size)
 {
-  jsonValue* value;
-  jsonArrayItem* next;
+  if (size <= capacity) return capacity;
 
-  jsonArrayItem(jsonValue* value, jsonArrayItem* next=NULL)
-  {
-    this->value = value;
-    this->next = next;
-    this->value->ref_incr();
-  }
+  int new_capacity = (capacity == 0 ? 4 : capacity * 2);
+  while (new_capacity < size) new_capacity *= 2;
 
-  ~jsonArrayItem()
+  T** new_items = (T**) realloc(items, sizeof(T*) * new_capacity);
+  if (new_items == NULL)
   {
-    this->value->ref_decr();
+    throw "memory allocation failed";
   }
-};
+  items = new_items;
+  return new_capacity;
+}
 
-struct jsonHashItem
+/*
+ * FNV-1a
+ */
+static inline unsigned int hash_string(const char* str)
 {
-  jsonString* key;
-  jsonValue* value;
-  jsonHashItem* next;
-
-  jsonHashItem(jsonString* key, jsonValue* value, jsonHashItem* next=NULL)
+  unsigned int h = 2166136261U;
+  for (const unsigned char* p = (const unsigned char*)str; *p != '\000'; p++)
   {
-    this->key = key;
-    this->value = value;
-    this->next = next;
-
-    this->key->ref_incr();
-    this->value->ref_incr();
+    h = (h ^ *p) * 16777619U;
   }
-
-  ~jsonHashItem()
-  {
-    this->key->ref_decr();
-    this->value->ref_decr();
-  }
-};
+  return h;
+}
 
 jsonValue::jsonValue() 
 {
@@ -197,7 +191,7 @@ jsonArrayIterator::jsonArrayIterator(jsonArray *array)
 {
   this->array = array;
   this->array->ref_incr();
-  this->pos = this->array->head;
+  this->pos = 0;
 }
 
 jsonArrayIterator::~jsonArrayIterator()
@@ -207,17 +201,17 @@ jsonArrayIterator::~jsonArrayIterator()
 
 void jsonArrayIterator::next()
 {
-  if (this->pos != NULL)
+  if (this->pos < this->array->size)
   {
-    this->pos = this->pos->next;
+    this->pos++;
   }
 }
 
 jsonValue *jsonArrayIterator::current()
 {
-  if (this->pos != NULL)
+  if (this->pos < this->array->size)
   {
-    return this->pos->value;
+    return this->array->items[this->pos];
   }
   else
   {
@@ -229,7 +223,7 @@ jsonHashIterator::jsonHashIterator(jsonHash *hash)
 {
   this->hash = hash;
   this->hash->ref_incr();
-  this->pos = this->hash->head;
+  this->pos = 0;
 }
 
 jsonHashIterator::~jsonHashIterator()
@@ -239,17 +233,17 @@ jsonHashIterator::~jsonHashIterator()
 
 void jsonHashIterator::next()
 {
-  if (this->pos != NULL)
+  if (this->pos < this->hash->size)
   {
-    this->pos = this->pos->next;
+    this->pos++;
   }
 }
 
 jsonString *jsonHashIterator::current_key()
 {
-  if (this->pos != NULL)
+  if (this->pos < this->hash->size)
   {
-    return this->pos->key;
+    return this->hash->keys[this->pos];
   }
   else
   {
@@ -259,9 +253,9 @@ jsonString *jsonHashIterator::current_key()
 
 jsonValue *jsonHashIterator::current_value()
 {
-  if (this->pos != NULL)
+  if (this->pos < this->hash->size)
   {
-    return this->pos->value;
+    return this->hash->values[this->pos];
   }
   else
   {
@@ -271,63 +265,42 @@ jsonValue *jsonHashIterator::current_value()
 
 jsonArray::jsonArray()
 {
-  head = tail = NULL;
+  items = NULL;
+  size = capacity = 0;
 }
 
 jsonArray::~jsonArray()
 {
-  jsonArrayItem* j;
-  for (jsonArrayItem* i=head; i != NULL; )
+  for (int i=0; i < size; i++)
   {
-    j = i->next;
-    delete i;
-    i = j;
+    items[i]->ref_decr();
   }
+  free(items);
 }
 
 void jsonArray::output(std::ostream& s) 
 {
   s << "[";
-  for (jsonArrayItem* i=head; i != NULL; i=i->next)
+  for (int i=0; i < size; i++)
   {
-    if (i != head) s << ", ";
-    i->value->output(s);
+    if (i != 0) s << ", ";
+    items[i]->output(s);
   }
   s << "]";
 }
 
 void jsonArray::push(jsonValue* value)
 {
-  jsonArrayItem* i = new jsonArrayItem(value);
-
-  if (head == NULL)
-  {
-    head = tail = i; 
-  }
-  else
-  {
-    tail->next = i; 
-    tail = i;
-  }
-}
-
-/*void jsonArray::each(void (*iter)(jsonValue*, void*), void* data)
-{
-  for (jsonArrayItem* i=head; i != NULL; i=i->next)
-  {
-    iter(i->value, data);
-  }
+  capacity = grow(items, capacity, size+1);
+  value->ref_incr();
+  items[size++] = value;
 }
-*/
 
 jsonValue* jsonArray::get(int index)
 {
-  for (jsonArrayItem* i=head; i != NULL; i=i->next, index--)
-  {
-    if (index == 0)
-      return i->value; 
-  }
-  return NULL;
+  if (index < 0 || index >= size)
+    return NULL;
+  return items[index];
 }
 
 const char* jsonArray::type()
@@ -337,52 +310,77 @@ const char* jsonArray::type()
 
 jsonHash::jsonHash()
 {
-  head = tail = NULL;
+  keys = NULL;
+  values = NULL;
+  size = capacity = 0;
+  index = NULL;
+  index_size = 0;
 }
 
 jsonHash::~jsonHash()
 {
-  jsonHashItem* j;
-  for (jsonHashItem* i=head; i != NULL; )
+  for (int i=0; i < size; i++)
   {
-    j = i->next;
-    delete i;
-    i = j;
+    keys[i]->ref_decr();
+    values[i]->ref_decr();
   }
+  free(keys);
+  free(values);
+  free(index);
 }
 
 void jsonHash::output(std::ostream& s) 
 {
   s << "{";
-  for (jsonHashItem* i=head; i != NULL; i=i->next)
+  for (int i=0; i < size; i++)
   {
-    if (i != head) s << ", " << std::endl;
-    i->key->output(s);
+    if (i != 0) s << ", " << std::endl;
+    keys[i]->output(s);
     s << ": ";
-    i->value->output(s);
+    values[i]->output(s);
   }
   s << "}";
 }
 
-/*void jsonHash::each(void (*iter)(jsonString*, jsonValue*, void*), void* data)
+/*
+ * Returns the slot of +key+ in +index+, which is either empty or
+ * refers to +key+.
+ */
+int jsonHash::find(const char* key)
 {
-  for (jsonHashItem* i=head; i != NULL; i=i->next)
+  int mask = index_size - 1;
+  int slot = hash_string(key) & mask;
+
+  while (index[slot] != 0 && keys[index[slot]-1]->value != key)
   {
-    iter(i->key, i->value, data);
+    slot = (slot + 1) & mask;
   }
+  return slot;
 }
-*/
 
-jsonValue* jsonHash::get(const char* key)
+void jsonHash::rehash(int new_index_size)
 {
-  for (jsonHashItem* i=head; i != NULL; i=i->next)
+  free(index);
+  index = (int*) calloc(new_index_size, sizeof(int));
+  if (index == NULL)
   {
-    if (i->key->value == key)
-    {
-      return i->value;
-    }
+    throw "memory allocation failed";
+  }
+  index_size = new_index_size;
+
+  for (int i=0; i < size; i++)
+  {
+    index[find(keys[i]->value.c_str())] = i+1;
   }
-  return NULL;
+}
+
+jsonValue* jsonHash::get(const char* key)
+{
+  if (size == 0)
+    return NULL;
+
+  int slot = find(key);
+  return (index[slot] != 0 ? values[index[slot]-1] : NULL);
 }
 
 jsonValue* jsonHash::get(std::string& key)
@@ -506,33 +504,32 @@ void jsonHash::set(const char* key, std::string& value)
 
 void jsonHash::set(jsonString* key, jsonValue* value)
 {
-  if (head == NULL)
+  // keep the load factor below 1/2
+  if (2*(size+1) > index_size)
   {
-    head = tail = new jsonHashItem(key, value); 
+    rehash(index_size == 0 ? 8 : index_size * 2);
   }
-  else
-  {
-    bool duplicate = false;
 
-    for (jsonHashItem* i=head; i != NULL; i=i->next)
-    {
-      if (i->key->value == key->value)
-      {
-        i->key->ref_decr();
-        i->value->ref_decr();
-        i->key = key;
-        i->value = value;
-        duplicate = true;
-        break;
-      }
-    }
+  key->ref_incr();
+  value->ref_incr();
 
-    if (!duplicate)
-    {
-      jsonHashItem* t = new jsonHashItem(key, value);
-      tail->next = t; 
-      tail = t;
-    }
+  int slot = find(key->value.c_str());
+
+  if (index[slot] != 0)
+  {
+    int i = index[slot]-1;
+    keys[i]->ref_decr();
+    values[i]->ref_decr();
+    keys[i] = key;
+    values[i] = value;
+  }
+  else
+  {
+    grow(values, capacity, size+1);
+    capacity = grow(keys, capacity, size+1);
+    keys[size] = key;
+    values[size] = value;
+    index[slot] = ++size;
   }
 }
 
@@ -13,9 +13,6 @@
   jsonValue *v; \
   for (jsonHashIterator iter(hash); (k=iter.current_key(), v=iter.current_value(), k) != NULL; iter.next())
 
-struct jsonArrayItem;
-struct jsonHashItem;
-
 /*
  * Forward declarations
  */
@@ -102,7 +99,7 @@ class jsonString : public jsonValue
 class jsonArrayIterator
 {
     jsonArray *array;
-    jsonArrayItem *pos;
+    int pos;
 
   public:
 
@@ -113,12 +110,16 @@ class jsonArrayIterator
     jsonValue *current();
 };
 
+/*
+ * The elements are stored contiguously, so get() is O(1).
+ */
 class jsonArray : public jsonValue
 {
   public:
 
-    jsonArrayItem* head;
-    jsonArrayItem* tail;
+    jsonValue** items;
+    int size;
+    int capacity;
 
   public:
 
@@ -134,7 +135,7 @@ class jsonArray : public jsonValue
 class jsonHashIterator
 {
     jsonHash *hash;
-    jsonHashItem *pos;
+    int pos;
 
   public:
 
@@ -147,12 +148,28 @@ class jsonHashIterator
 };
 
 
+/*
+ * Keys and values are stored contiguously in insertion order. An open
+ * addressing hash table (linear probing) maps keys to their position,
+ * so get() and set() are O(1) on average.
+ */
 class jsonHash : public jsonValue
 {
   public:
 
-    jsonHashItem* head;
-    jsonHashItem* tail;
+    jsonString** keys;
+    jsonValue** values;
+    int size;
+    int capacity;
+
+  protected:
+
+    /*
+     * Slots contain the position + 1 of a key, or 0 if empty.
+     * +index_size+ is a power of two.
+     */
+    int* index;
+    int index_size;
 
   public:
 
@@ -177,6 +194,11 @@ class jsonHash : public jsonValue
     void set(const char* key, std::string& value);
     void set(jsonString* key, jsonValue* value);
     virtual const char* type();
+
+  protected:
+
+    int find(const char* key);
+    void rehash(int new_index_size);
 };
 
 #endif
@@ -0,0 +1,559 @@
+#include "json_doc.h"
+#include "json_scan.h"
+#include <math.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+#ifndef WITHOUT_MMAP
+#include <sys/mman.h>
+#endif
+
+const jsonNode *
+jsonNode::get(const char *key) const
+{
+  if (this->type != JSON_HASH) throw "invalid type cast";
+
+  size_t len = strlen(key);
+  for (uint32_t i = 0; i < this->size; i++)
+  {
+    if (this->items[2*i].equals(key, len)) return &this->items[2*i+1];
+  }
+  return NULL;
+}
+
+jsonValue *
+jsonNode::to_value() const
+{
+  switch (this->type)
+  {
+    case JSON_NULL: return new jsonNull();
+    case JSON_TRUE: return new jsonTrue();
+    case JSON_FALSE: return new jsonFalse();
+    case JSON_NUMBER: return new jsonNumber(this->number);
+    case JSON_STRING: return new jsonString(this->str, this->size);
+
+    case JSON_ARRAY: {
+      jsonArray *array = new jsonArray();
+      for (uint32_t i = 0; i < this->size; i++)
+      {
+        jsonValue *v = this->items[i].to_value();
+        array->push(v);
+        v->ref_decr();
+      }
+      return array;
+    }
+
+    case JSON_HASH: {
+      jsonHash *hash = new jsonHash();
+      for (uint32_t i = 0; i < this->size; i++)
+      {
+        jsonString *k = (jsonString*) key(i)->to_value();
+        jsonValue *v = value(i)->to_value();
+        hash->set(k, v);
+        k->ref_decr();
+        v->ref_decr();
+      }
+      return hash;
+    }
+  }
+  throw "invalid json node";
+}
+
+/*
+ * A recursive descent parser for the grammar in json_parser.rl.
+ *
+ * The elements of arrays and hashes are collected on +stack+ and
+ * copied into the arena once the number of elements is known.
+ */
+class jsonDocParser
+{
+    const char *p;
+    const char *ps;
+    const char *pe;
+    ArenaAllocator &arena;
+    std::vector<jsonNode> stack;
+
+    /*
+     * Nesting depth of the current array or hash (1 for the top-level
+     * hash).
+     */
+    uint depth;
+
+    /*
+     * See jsonDocument(filename, deferred, pieces).
+     */
+    const char *const *deferred;
+    uint pieces;
+    std::vector<jsonSection> *sections;
+
+  public:
+
+    jsonDocParser(const char *content, size_t size, ArenaAllocator &arena) : arena(arena)
+    {
+      this->ps = this->p = content;
+      this->pe = content + size;
+      this->depth = 0;
+      this->deferred = NULL;
+      this->pieces = 1;
+      this->sections = NULL;
+    }
+
+    /*
+     * Parse [p, pe) of a document starting at +ps+ (for error
+     * messages).
+     */
+    jsonDocParser(const char *ps, const char *p, const char *pe, ArenaAllocator &arena) : arena(arena)
+    {
+      this->ps = ps;
+      this->p = p;
+      this->pe = pe;
+      this->depth = 0;
+      this->deferred = NULL;
+      this->pieces = 1;
+      this->sections = NULL;
+    }
+
+    void
+      defer(const char *const *deferred, uint pieces, std::vector<jsonSection> *sections)
+      {
+        this->deferred = deferred;
+        this->pieces = (pieces > 0 ? pieces : 1);
+        this->sections = sections;
+      }
+
+    jsonNode *
+      parse()
+      {
+        skip_ws();
+        parse_value();
+        skip_ws();
+        if (this->p != this->pe) error();
+
+        jsonNode *root = (jsonNode*) this->arena.allocate(sizeof(jsonNode));
+        *root = this->stack.back();
+        return root;
+      }
+
+    /*
+     * Parse the elements (key/value pairs if +type+ is JSON_HASH) of
+     * a range of a jsonSection into an array (hash). Every range but
+     * the +last+ one ends with a ",". Only a section with a single
+     * range may be empty.
+     */
+    jsonNode *
+      parse_range(uint32_t type, bool first, bool last)
+      {
+        size_t count = 0;
+
+        while (true)
+        {
+          skip_ws();
+          if (this->p == this->pe && (!last || (first && count == 0))) break;
+
+          if (type == JSON_HASH) parse_pair(); else parse_value();
+          ++count;
+
+          skip_ws();
+          if (this->p == this->pe)
+          {
+            if (!last) error();
+            break;
+          }
+          if (*this->p != ',') error();
+          ++this->p;
+        }
+
+        jsonNode *items = pop_items(type == JSON_HASH ? 2*count : count);
+        jsonNode *root = (jsonNode*) this->arena.allocate(sizeof(jsonNode));
+        root->type = type;
+        root->size = count;
+        root->items = items;
+        return root;
+      }
+
+  protected:
+
+    void
+      error()
+      {
+        std::cout << "error at: " << (this->p - this->ps) << std::endl;
+        throw "error occured while parsing";
+      }
+
+    inline void
+      skip_ws()
+      {
+        while (true)
+        {
+          this->p = json_skip_ws(this->p, this->pe);
+
+          if (this->p+1 < this->pe && this->p[0] == '/' && this->p[1] == '/')
+          {
+            while (this->p < this->pe && *this->p != '\n' && *this->p != '\r') ++this->p;
+          }
+          else
+          {
+            break;
+          }
+        }
+      }
+
+    inline bool
+      match(const char *word, size_t len)
+      {
+        if ((size_t)(this->pe - this->p) < len || memcmp(this->p, word, len) != 0)
+          return false;
+        this->p += len;
+        return true;
+      }
+
+    inline void
+      push(uint32_t type, uint32_t size)
+      {
+        jsonNode n;
+        n.type = type;
+        n.size = size;
+        n.items = NULL;
+        this->stack.push_back(n);
+      }
+
+    /*
+     * Move the topmost +count+ nodes of the stack into the arena.
+     */
+    jsonNode *
+      pop_items(size_t count)
+      {
+        if (count == 0) return NULL;
+
+        jsonNode *items = (jsonNode*) this->arena.allocate(sizeof(jsonNode) * count);
+        memcpy(items, &this->stack[this->stack.size() - count], sizeof(jsonNode) * count);
+        this->stack.resize(this->stack.size() - count);
+        return items;
+      }
+
+    void
+      parse_string()
+      {
+        const char quote = *this->p++;
+        const char *start = this->p;
+        const char *end = json_find_quote(start, this->pe, quote);
+        if (end == NULL) error();
+
+        push(JSON_STRING, end - start);
+        this->stack.back().str = start;
+        this->p = end + 1;
+      }
+
+    void
+      parse_label()
+      {
+        const char *start = this->p;
+        while (this->p < this->pe && (*this->p == '_' || isalnum(*this->p))) ++this->p;
+
+        push(JSON_STRING, this->p - start);
+        this->stack.back().str = start;
+      }
+
+    void
+      parse_number()
+      {
+        const char *start = this->p;
+
+        if (*this->p == '+' || *this->p == '-') ++this->p;
+
+        push(JSON_NUMBER, 0);
+
+        if (match("Infinity", 8))
+        {
+          this->stack.back().number = (*start == '-' ? -INFINITY : INFINITY);
+          return;
+        }
+
+        this->p = json_parse_number(start, this->pe, this->stack.back().number);
+        if (this->p == NULL)
+        {
+          this->p = start;
+          error();
+        }
+      }
+
+    void
+      parse_value()
+      {
+        if (this->p >= this->pe) error();
+
+        switch (*this->p)
+        {
+          case '{': parse_hash(); break;
+          case '[': parse_array(); break;
+          case '"':
+          case '\'': parse_string(); break;
+          case 'n': if (!match("null", 4)) error(); push(JSON_NULL, 0); break;
+          case 't': if (!match("true", 4)) error(); push(JSON_TRUE, 0); break;
+          case 'f': if (!match("false", 5)) error(); push(JSON_FALSE, 0); break;
+          default: parse_number();
+        }
+      }
+
+    /*
+     * Skip the array or hash at +p+ without parsing it's elements, and
+     * split it into about +pieces+ ranges of whole elements.
+     */
+    void
+      scan_section(const std::string &key)
+      {
+        const char open = *this->p;
+        const char close = (open == '[' ? ']' : '}');
+        uint level = 1;
+
+        this->sections->push_back(jsonSection());
+        jsonSection &s = this->sections->back();
+        s.key = key;
+        s.type = (open == '[' ? JSON_ARRAY : JSON_HASH);
+
+        ++this->p;
+        s.bounds.push_back(this->p);
+        const size_t piece = (this->pe - this->p) / this->pieces + 1;
+
+        while (true)
+        {
+          skip_ws();
+          if (this->p >= this->pe) error();
+
+          switch (*this->p)
+          {
+            case '"':
+            case '\'': {
+              const char *end = json_find_quote(this->p + 1, this->pe, *this->p);
+              if (end == NULL) error();
+              this->p = end + 1;
+              continue;
+            }
+            case '[':
+            case '{':
+              ++level;
+              break;
+            case ']':
+            case '}':
+              if (--level > 0) break;
+              if (*this->p != close) error();
+              s.bounds.push_back(this->p);
+              ++this->p;
+              return;
+            case ',':
+              if (level == 1 && (size_t)(this->p + 1 - s.bounds.back()) >= piece)
+              {
+                s.bounds.push_back(this->p + 1);
+              }
+              break;
+          }
+          ++this->p;
+        }
+      }
+
+    inline bool
+      is_deferred(const jsonNode &key)
+      {
+        if (this->deferred == NULL || this->depth != 1) return false;
+
+        for (const char *const *d = this->deferred; *d != NULL; d++)
+        {
+          if (key.equals(*d)) return true;
+        }
+        return false;
+      }
+
+    void
+      parse_pair()
+      {
+        if (this->p >= this->pe) error();
+        if (*this->p == '"' || *this->p == '\'') parse_string();
+        else if (*this->p == '_' || isalpha(*this->p)) parse_label();
+        else error();
+
+        skip_ws();
+        if (this->p >= this->pe || *this->p != ':') error();
+        ++this->p;
+        skip_ws();
+
+        if (this->p < this->pe && (*this->p == '[' || *this->p == '{') && is_deferred(this->stack.back()))
+        {
+          scan_section(this->stack.back().as_string());
+          push(JSON_NULL, 0);
+        }
+        else
+        {
+          parse_value();
+        }
+      }
+
+    void
+      parse_array()
+      {
+        size_t count = 0;
+        ++this->p;
+        ++this->depth;
+
+        skip_ws();
+        if (this->p < this->pe && *this->p == ']')
+        {
+          ++this->p;
+        }
+        else
+        {
+          while (true)
+          {
+            skip_ws();
+            parse_value();
+            ++count;
+            skip_ws();
+            if (this->p >= this->pe) error();
+            if (*this->p == ']') { ++this->p; break; }
+            if (*this->p != ',') error();
+            ++this->p;
+          }
+        }
+
+        jsonNode *items = pop_items(count);
+        push(JSON_ARRAY, count);
+        this->stack.back().items = items;
+        --this->depth;
+      }
+
+    void
+      parse_hash()
+      {
+        size_t count = 0;
+        ++this->p;
+        ++this->depth;
+
+        skip_ws();
+        if (this->p < this->pe && *this->p == '}')
+        {
+          ++this->p;
+        }
+        else
+        {
+          while (true)
+          {
+            skip_ws();
+            parse_pair();
+            ++count;
+
+            skip_ws();
+            if (this->p >= this->pe) error();
+            if (*this->p == '}') { ++this->p; break; }
+            if (*this->p != ',') error();
+            ++this->p;
+          }
+        }
+
+        jsonNode *items = pop_items(2*count);
+        push(JSON_HASH, count);
+        this->stack.back().items = items;
+        --this->depth;
+      }
+};
+
+jsonDocument::jsonDocument(const char *filename)
+{
+  load(filename, NULL, 1);
+}
+
+jsonDocument::jsonDocument(const char *filename, const char *const *deferred, uint pieces)
+{
+  load(filename, deferred, pieces);
+}
+
+void
+jsonDocument::load(const char *filename, const char *const *deferred, uint pieces)
+{
+  int fh = open(filename, O_RDONLY);
+  if (fh < 0)
+  {
+    throw "cannot open file";
+  }
+
+  off_t sz = lseek(fh, 0, SEEK_END);
+  if (sz < 0)
+  {
+    close(fh);
+    throw "error";
+  }
+  lseek(fh, 0, SEEK_SET);
+  this->mem_size = sz;
+
+#ifdef WITHOUT_MMAP
+  this->mapped = false;
+  this->mem = (char*) malloc(this->mem_size + 1);
+  if (this->mem == NULL)
+  {
+    close(fh);
+    throw "malloc failed";
+  }
+  if (read(fh, this->mem, this->mem_size) != (ssize_t)this->mem_size)
+  {
+    free(this->mem);
+    close(fh);
+    throw "couldn't read entire file";
+  }
+#else
+  this->mapped = true;
+  this->mem = (char*) mmap(NULL, this->mem_size, PROT_READ, MAP_SHARED, fh, 0);
+  if (this->mem == MAP_FAILED)
+  {
+    close(fh);
+    throw "mmap failed";
+  }
+#endif
+  close(fh);
+
+  try
+  {
+    jsonDocParser parser(this->mem, this->mem_size, this->arena);
+    parser.defer(deferred, pieces, &this->sections);
+    this->root = parser.parse();
+  }
+  catch (...)
+  {
+    unmap();
+    throw;
+  }
+}
+
+jsonDocument::~jsonDocument()
+{
+  unmap();
+}
+
+void
+jsonDocument::unmap()
+{
+#ifndef WITHOUT_MMAP
+  if (this->mapped)
+  {
+    munmap(this->mem, this->mem_size);
+    return;
+  }
+#endif
+  free(this->mem);
+}
+
+const jsonSection *
+jsonDocument::section(const char *key) const
+{
+  for (uint i = 0; i < this->sections.size(); i++)
+  {
+    if (this->sections[i].key == key) return &this->sections[i];
+  }
+  return NULL;
+}
+
+jsonFragment::jsonFragment(const jsonDocument &doc, const jsonSection &section, uint range)
+{
+  jsonDocParser parser(doc.mem, section.bounds[range], section.bounds[range+1], this->arena);
+  this->root = parser.parse_range(section.type, range == 0, range + 1 == section.ranges());
+}
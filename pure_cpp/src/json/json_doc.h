@@ -0,0 +1,189 @@
+#ifndef __YINSPIRE__JSON_DOC__
+#define __YINSPIRE__JSON_DOC__
+
+#include "json.h"
+#include "arena_allocator.h"
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+enum jsonNodeType
+{
+  JSON_NULL = 0,
+  JSON_TRUE,
+  JSON_FALSE,
+  JSON_NUMBER,
+  JSON_STRING,
+  JSON_ARRAY,
+  JSON_HASH
+};
+
+/*
+ * A compact (16 bytes) JSON value of a jsonDocument.
+ *
+ * Strings are (pointer, length) views into the input and are not
+ * NUL-terminated. The elements of an array are stored contiguously in
+ * +items+, as are the key/value pairs of a hash (key at 2*i, value at
+ * 2*i+1).
+ */
+struct jsonNode
+{
+  uint32_t type;
+
+  /*
+   * Length of a string, number of elements of an array or number of
+   * pairs of a hash.
+   */
+  uint32_t size;
+
+  union
+  {
+    double number;
+    const char *str;
+    jsonNode *items;
+  };
+
+  inline bool is_type(jsonNodeType t) const { return this->type == (uint32_t)t; }
+
+  inline double
+    as_number() const
+    {
+      if (this->type != JSON_NUMBER) throw "invalid type cast";
+      return this->number;
+    }
+
+  inline std::string
+    as_string() const
+    {
+      if (this->type != JSON_STRING) throw "invalid type cast";
+      return std::string(this->str, this->size);
+    }
+
+  /*
+   * Compare a string node with +s+.
+   */
+  inline bool
+    equals(const char *s, size_t len) const
+    {
+      return (this->type == JSON_STRING && this->size == len &&
+          memcmp(this->str, s, len) == 0);
+    }
+
+  inline bool equals(const char *s) const { return equals(s, strlen(s)); }
+
+  inline bool equals(const jsonNode *n) const { return equals(n->str, n->size); }
+
+  /*
+   * Element +i+ of an array or NULL.
+   */
+  inline const jsonNode *
+    at(uint32_t i) const
+    {
+      if (this->type != JSON_ARRAY) throw "invalid type cast";
+      return (i < this->size ? &this->items[i] : NULL);
+    }
+
+  inline const jsonNode *key(uint32_t i) const { return &this->items[2*i]; }
+  inline const jsonNode *value(uint32_t i) const { return &this->items[2*i+1]; }
+
+  /*
+   * The value for +key+ of a hash or NULL.
+   *
+   * O(n)
+   */
+  const jsonNode *get(const char *key) const;
+
+  /*
+   * Convert into a (reference counted) jsonValue.
+   */
+  jsonValue *to_value() const;
+};
+
+/*
+ * The unparsed value (an array or hash) of a key of the top-level hash
+ * of a jsonDocument, split into ranges of whole elements (key/value
+ * pairs of a hash). Range +i+ is [bounds[i], bounds[i+1]).
+ */
+struct jsonSection
+{
+  std::string key;
+  uint32_t type;
+  std::vector<const char*> bounds;
+
+  inline uint ranges() const { return this->bounds.size() - 1; }
+};
+
+/*
+ * A JSON document parsed from a file into jsonNodes allocated from a
+ * single arena. The file stays mapped into memory (or read, if
+ * compiled WITHOUT_MMAP) as long as the document lives, as strings
+ * refer to it. Destroying the document releases everything at once.
+ *
+ * Accepts the same dialect as jsonParser.
+ */
+class jsonDocument
+{
+    friend class jsonFragment;
+
+  protected:
+
+    ArenaAllocator arena;
+    char *mem;
+    size_t mem_size;
+    bool mapped;
+
+  public:
+
+    const jsonNode *root;
+
+    /*
+     * The deferred values, in the order of the file.
+     */
+    std::vector<jsonSection> sections;
+
+  public:
+
+    jsonDocument(const char *filename);
+
+    /*
+     * Arrays and hashes which are the values of the top-level keys in
+     * +deferred+ (NULL terminated) are not parsed, but only scanned
+     * for the boundaries of their elements. They are null in +root+
+     * and split into about +pieces+ sections, which can be parsed
+     * independently (and concurrently) with jsonFragment.
+     */
+    jsonDocument(const char *filename, const char *const *deferred, uint pieces);
+
+    ~jsonDocument();
+
+    /*
+     * The deferred value of +key+ or NULL.
+     */
+    const jsonSection *section(const char *key) const;
+
+  protected:
+
+    void load(const char *filename, const char *const *deferred, uint pieces);
+    void unmap();
+};
+
+/*
+ * The elements of one range of a jsonSection, parsed into their own
+ * arena. +root+ is an array (or hash) of them. Strings refer to the
+ * jsonDocument, which has to outlive the fragment.
+ */
+class jsonFragment
+{
+  protected:
+
+    ArenaAllocator arena;
+
+  public:
+
+    const jsonNode *root;
+
+    jsonFragment(const jsonDocument &doc, const jsonSection &section, uint range);
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <string.h>
 #include <iostream>
 #include "json_parser.h"
+#include "json_scan.h"
 
 #define PB(x) values.push_back(x)
 
@@ -16,20 +17,17 @@ inline static jsonString* json_string(char* from, char* to)
   return new jsonString(from, to-from);
 }
 
-inline static jsonNumber* json_number(char* from, char* to, char* buf, int maxsz)
+inline static jsonNumber* json_number(char* from, char* to)
 {
-  const int sz = to-from; 
+  double value = 0.0;
 
-  if (sz > maxsz) throw "fatal";
-
-  memcpy(buf, from, sz);
-  buf[sz] = '\000';
+  if (json_parse_number(from, to, value) != to) throw "fatal";
  
-  return new jsonNumber(strtod(buf, NULL));
+  return new jsonNumber(value);
 }
 
 
-#line 33 "src/json/json_parser.cc"
+#line 31 "src/json/json_parser.cc"
 static const char _jsonParser_actions[] = {
 	0, 1, 0, 1, 1, 1, 2, 1, 
 	3, 1, 4, 1, 5, 1, 6, 1, 
@@ -375,15 +373,13 @@ static const int jsonParser_en_main = 1;
 static const int jsonParser_en_hash = 36;
 static const int jsonParser_en_array = 97;
 
-#line 91 "src/json/json_parser.rl"
+#line 89 "src/json/json_parser.rl"
 
 jsonValue* jsonParser::parse(char* content, int size)
 {
   int cs;
   int top;
   int stack[20];
-  char numbuf[61];
-  const int numbufsz = 60;
 
   char *ps = content;
   char *p = ps;
@@ -395,14 +391,14 @@ jsonValue* jsonParser::parse(char* content, int size)
   std::vector<int> array_i;
 
   
-#line 399 "src/json/json_parser.cc"
+#line 395 "src/json/json_parser.cc"
 	{
 	cs = jsonParser_start;
 	top = 0;
 	}
-#line 110 "src/json/json_parser.rl"
+#line 106 "src/json/json_parser.rl"
   
-#line 406 "src/json/json_parser.cc"
+#line 402 "src/json/json_parser.cc"
 	{
 	int _klen;
 	unsigned int _trans;
@@ -494,7 +490,7 @@ _match:
 	case 4:
 #line 11 "src/json/json_parser.rl"
 	{
-    PB(json_number(tstart, p, numbuf, numbufsz));
+    PB(json_number(tstart, p));
   }
 	break;
 	case 5:
@@ -568,7 +564,7 @@ _match:
     {cs = stack[--top]; goto _again;}
   }
 	break;
-#line 572 "src/json/json_parser.cc"
+#line 568 "src/json/json_parser.cc"
 		}
 	}
 
@@ -579,7 +575,7 @@ _again:
 		goto _resume;
 	_out: {}
 	}
-#line 111 "src/json/json_parser.rl"
+#line 107 "src/json/json_parser.rl"
 
   if (p != pe)
   {
@@ -9,7 +9,7 @@
 
   exp = ("e"|"E") ("+"|"-")? [0-9]+;
   number = (("+" | "-")? ([0-9] | [1-9] [0-9]*) ("." [0-9]*  )? exp?) >{ tstart=p; } %{
-    PB(json_number(tstart, p, numbuf, numbufsz));
+    PB(json_number(tstart, p));
   };
 
   pos_inf = (("+")? "Infinity") %{ PB(new jsonNumber(INFINITY)); };
@@ -67,6 +67,7 @@
 #include <string.h>
 #include <iostream>
 #include "json_parser.h"
+#include "json_scan.h"
 
 #define PB(x) values.push_back(x)
 
@@ -75,16 +76,13 @@ inline static jsonString* json_string(char* from, char* to)
   return new jsonString(from, to-from);
 }
 
-inline static jsonNumber* json_number(char* from, char* to, char* buf, int maxsz)
+inline static jsonNumber* json_number(char* from, char* to)
 {
-  const int sz = to-from; 
+  double value = 0.0;
 
-  if (sz > maxsz) throw "fatal";
-
-  memcpy(buf, from, sz);
-  buf[sz] = '\000';
+  if (json_parse_number(from, to, value) != to) throw "fatal";
  
-  return new jsonNumber(strtod(buf, NULL));
+  return new jsonNumber(value);
 }
 
 %% write data;
@@ -94,8 +92,6 @@ jsonValue* jsonParser::parse(char* content, int size)
   int cs;
   int top;
   int stack[20];
-  char numbuf[61];
-  const int numbufsz = 60;
 
   char *ps = content;
   char *p = ps;
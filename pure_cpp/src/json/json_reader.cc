@@ -0,0 +1,320 @@
+#include "json_reader.h"
+#include "json_scan.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <iostream>
+
+jsonReader::jsonReader(FILE *file, size_t buf_size)
+{
+  this->file = file;
+  this->buf_size = buf_size;
+  this->buf = (char*) malloc(buf_size);
+  this->pos = 0;
+  this->end = 0;
+  this->offset = 0;
+  this->eof = false;
+
+  if (this->buf == NULL)
+  {
+    throw "malloc failed";
+  }
+}
+
+jsonReader::jsonReader()
+{
+  this->file = NULL;
+  this->buf = NULL;
+  this->buf_size = 0;
+  this->pos = 0;
+  this->end = 0;
+  this->offset = 0;
+  this->eof = false;
+}
+
+jsonReader::~jsonReader()
+{
+  free(this->buf);
+}
+
+bool
+jsonReader::fill()
+{
+  if (this->eof) return false;
+
+  this->offset += this->end;
+  this->pos = 0;
+  this->end = fread(this->buf, 1, this->buf_size, this->file);
+
+  if (this->end == 0)
+  {
+    this->eof = true;
+    return false;
+  }
+  return true;
+}
+
+void
+jsonReader::error(const char *msg)
+{
+  std::cout << "error at: " << (this->offset + this->pos) << std::endl;
+  throw msg;
+}
+
+void
+jsonReader::skip_ws()
+{
+  int c;
+  while ((c = peek_char()) != -1)
+  {
+    if (json_is_ws(c))
+    {
+      this->pos = json_skip_ws(this->buf + this->pos, this->buf + this->end) - this->buf;
+    }
+    else if (c == '/')
+    {
+      ++this->pos;
+      if (read_char() != '/') error("error occured while parsing");
+      while ((c = read_char()) != -1 && c != '\n' && c != '\r');
+    }
+    else
+    {
+      break;
+    }
+  }
+}
+
+bool
+jsonReader::match(const char *word)
+{
+  for (const char *w = word; *w != '\000'; w++)
+  {
+    if (read_char() != *w) return false;
+  }
+  return true;
+}
+
+int
+jsonReader::peek()
+{
+  skip_ws();
+  return peek_char();
+}
+
+void
+jsonReader::expect(char c)
+{
+  skip_ws();
+  if (read_char() != c) error("error occured while parsing");
+}
+
+void
+jsonReader::expect_end()
+{
+  skip_ws();
+  if (peek_char() != -1) error("error occured while parsing");
+}
+
+bool
+jsonReader::next_element(bool &first, char close)
+{
+  int c = peek();
+
+  if (c == close)
+  {
+    ++this->pos;
+    return false;
+  }
+
+  if (first)
+  {
+    first = false;
+  }
+  else
+  {
+    if (c != ',') error("error occured while parsing");
+    ++this->pos;
+  }
+  return true;
+}
+
+void
+jsonReader::read_string(std::string &str)
+{
+  int c = peek();
+  str.clear();
+
+  if (c == '"' || c == '\'')
+  {
+    const char quote = read_char();
+    while (true)
+    {
+      if (this->pos >= this->end && !fill()) error("error occured while parsing");
+
+      const char *from = this->buf + this->pos;
+      const char *to = json_find_quote(from, this->buf + this->end, quote);
+
+      if (to != NULL)
+      {
+        str.append(from, to - from);
+        this->pos += to - from + 1;
+        break;
+      }
+      str.append(from, this->buf + this->end - from);
+      this->pos = this->end;
+    }
+  }
+  else if (c == '_' || isalpha(c))
+  {
+    while ((c = peek_char()) != -1 && (c == '_' || isalnum(c)))
+    {
+      str.push_back((char)c);
+      ++this->pos;
+    }
+  }
+  else
+  {
+    error("error occured while parsing");
+  }
+}
+
+void
+jsonReader::read_key(std::string &key)
+{
+  read_string(key);
+  expect(':');
+}
+
+double
+jsonReader::read_number()
+{
+  char numbuf[61];
+  int sz = 0;
+  int c = peek();
+
+  if (c == '+' || c == '-')
+  {
+    numbuf[sz++] = (char)c;
+    ++this->pos;
+    c = peek_char();
+  }
+
+  if (c == 'I')
+  {
+    if (!match("Infinity")) error("error occured while parsing");
+    return (sz > 0 && numbuf[0] == '-') ? -INFINITY : INFINITY;
+  }
+
+  while ((c = peek_char()) != -1 && (isdigit(c) || c == '.' || c == 'e' ||
+        c == 'E' || ((c == '+' || c == '-') && (numbuf[sz-1] == 'e' || numbuf[sz-1] == 'E'))))
+  {
+    if (sz >= 60) error("fatal");
+    numbuf[sz++] = (char)c;
+    ++this->pos;
+  }
+  numbuf[sz] = '\000';
+
+  double value;
+  if (json_parse_number(numbuf, numbuf+sz, value) != numbuf+sz)
+  {
+    error("error occured while parsing");
+  }
+  return value;
+}
+
+jsonValue *
+jsonReader::read_value()
+{
+  std::string str;
+  int c = peek();
+
+  switch (c)
+  {
+    case '{': {
+      jsonHash *hash = new jsonHash();
+      ++this->pos;
+      for (bool first = true; next_element(first, '}'); )
+      {
+        read_key(str);
+        jsonString *key = new jsonString(str);
+        jsonValue *value = read_value();
+        hash->set(key, value);
+        key->ref_decr();
+        value->ref_decr();
+      }
+      return hash;
+    }
+
+    case '[': {
+      jsonArray *array = new jsonArray();
+      ++this->pos;
+      for (bool first = true; next_element(first, ']'); )
+      {
+        jsonValue *value = read_value();
+        array->push(value);
+        value->ref_decr();
+      }
+      return array;
+    }
+
+    case '"':
+    case '\'':
+      read_string(str);
+      return new jsonString(str);
+
+    case 'n':
+      if (!match("null")) error("error occured while parsing");
+      return new jsonNull();
+
+    case 't':
+      if (!match("true")) error("error occured while parsing");
+      return new jsonTrue();
+
+    case 'f':
+      if (!match("false")) error("error occured while parsing");
+      return new jsonFalse();
+
+    default:
+      return new jsonNumber(read_number());
+  }
+}
+
+void
+jsonReader::skip_value()
+{
+  std::string str;
+  int c = peek();
+
+  switch (c)
+  {
+    case '{':
+      ++this->pos;
+      for (bool first = true; next_element(first, '}'); )
+      {
+        read_key(str);
+        skip_value();
+      }
+      break;
+
+    case '[':
+      ++this->pos;
+      for (bool first = true; next_element(first, ']'); )
+      {
+        skip_value();
+      }
+      break;
+
+    case '"':
+    case '\'':
+      read_string(str);
+      break;
+
+    case 'n': if (!match("null")) error("error occured while parsing"); break;
+    case 't': if (!match("true")) error("error occured while parsing"); break;
+    case 'f': if (!match("false")) error("error occured while parsing"); break;
+
+    default:
+      read_number();
+  }
+}
@@ -0,0 +1,121 @@
+#ifndef __YINSPIRE__JSON_READER__
+#define __YINSPIRE__JSON_READER__
+
+#include "json.h"
+#include <stdio.h>
+#include <string>
+
+/*
+ * A pull-style JSON reader which reads the input in chunks and never
+ * builds a DOM, unless explicitly requested with read_value().
+ *
+ * It accepts the same dialect as jsonParser: unquoted labels as keys,
+ * single or double quoted strings (without escapes), "//" comments
+ * and (+/-)Infinity.
+ *
+ * Example:
+ *
+ *   jsonReader r(file);
+ *   r.expect('[');
+ *   for (bool first = true; r.next_element(first, ']'); )
+ *   {
+ *     double d = r.read_number();
+ *   }
+ */
+class jsonReader
+{
+  protected:
+
+    FILE *file;
+    char *buf;
+    size_t buf_size;
+    size_t pos;
+    size_t end;
+    bool eof;
+
+    /*
+     * Number of bytes consumed before +buf+ (used for error messages).
+     */
+    size_t offset;
+
+  public:
+
+    jsonReader(FILE *file, size_t buf_size=1<<16);
+    virtual ~jsonReader();
+
+    /*
+     * Skip whitespace and comments and return the next character
+     * without consuming it (or -1 at the end of input).
+     */
+    int peek();
+
+    /*
+     * Skip whitespace and consume character +c+. Throws otherwise.
+     */
+    void expect(char c);
+
+    /*
+     * Iterate over the elements of an array or the key/value pairs of
+     * a hash. Consumes the separating "," or the +close+ character, in
+     * which case it returns false.
+     */
+    bool next_element(bool &first, char close);
+
+    /*
+     * Read a quoted string or a label into +str+.
+     */
+    void read_string(std::string &str);
+
+    double read_number();
+
+    /*
+     * Read a key of a hash including the ":".
+     */
+    void read_key(std::string &key);
+
+    /*
+     * Read any value into a DOM. Use only for small values.
+     */
+    jsonValue *read_value();
+
+    void skip_value();
+
+    /*
+     * Throws if there is anything but whitespace left.
+     */
+    void expect_end();
+
+  protected:
+
+    /*
+     * For subclasses which provide the input themselves by overriding
+     * fill(). +buf+ is not allocated.
+     */
+    jsonReader();
+
+    /*
+     * Refill +buf+ and reset +pos+ and +end+. Returns false if there
+     * is no more input.
+     */
+    virtual bool fill();
+
+    inline int
+      read_char()
+      {
+        if (this->pos >= this->end && !fill()) return -1;
+        return (unsigned char) this->buf[this->pos++];
+      }
+
+    inline int
+      peek_char()
+      {
+        if (this->pos >= this->end && !fill()) return -1;
+        return (unsigned char) this->buf[this->pos];
+      }
+
+    void skip_ws();
+    bool match(const char *word);
+    void error(const char *msg);
+};
+
+#endif
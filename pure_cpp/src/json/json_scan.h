@@ -0,0 +1,178 @@
+#ifndef __YINSPIRE__JSON_SCAN__
+#define __YINSPIRE__JSON_SCAN__
+
+/*
+ * Scanning primitives for the JSON parsers. They operate on a buffer
+ * [p, pe) and process 16 bytes at a time with SSE2 if available.
+ *
+ * Also contains a fast number parser which avoids strtod for the
+ * common case of short decimal numbers.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * 16 bit mask of the whitespace characters (as in isspace(3)) in the
+ * 16 bytes at +p+.
+ */
+#ifdef __SSE2__
+static inline unsigned int
+json_ws_mask16(const char *p)
+{
+  __m128i c = _mm_loadu_si128((const __m128i*)p);
+  __m128i sp = _mm_cmpeq_epi8(c, _mm_set1_epi8(' '));
+  __m128i ctl = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('\t' - 1)),
+      _mm_cmplt_epi8(c, _mm_set1_epi8('\r' + 1)));
+  return _mm_movemask_epi8(_mm_or_si128(sp, ctl));
+}
+#endif
+
+static inline bool
+json_is_ws(char c)
+{
+  return (c == ' ' || (c >= '\t' && c <= '\r'));
+}
+
+/*
+ * Returns the first non-whitespace character in [p, pe) or +pe+.
+ * Does not skip comments.
+ */
+static inline const char *
+json_skip_ws(const char *p, const char *pe)
+{
+  // most of the time there is no or just a single whitespace
+  if (p < pe && !json_is_ws(*p)) return p;
+
+#ifdef __SSE2__
+  while (pe - p >= 16)
+  {
+    unsigned int non_ws = ~json_ws_mask16(p) & 0xFFFF;
+    if (non_ws != 0) return p + __builtin_ctz(non_ws);
+    p += 16;
+  }
+#endif
+
+  while (p < pe && json_is_ws(*p)) ++p;
+  return p;
+}
+
+/*
+ * Returns the first occurence of +quote+ in [p, pe) or NULL.
+ */
+static inline const char *
+json_find_quote(const char *p, const char *pe, char quote)
+{
+#ifdef __SSE2__
+  __m128i q = _mm_set1_epi8(quote);
+  while (pe - p >= 16)
+  {
+    unsigned int m = _mm_movemask_epi8(_mm_cmpeq_epi8(
+          _mm_loadu_si128((const __m128i*)p), q));
+    if (m != 0) return p + __builtin_ctz(m);
+    p += 16;
+  }
+#endif
+
+  return (const char*) memchr(p, quote, pe - p);
+}
+
+static inline bool
+json_is_digit(char c)
+{
+  return (c >= '0' && c <= '9');
+}
+
+/*
+ * Parses a number (without Infinity) at [p, pe) into +value+ and
+ * returns the end of the number, or NULL if there is no valid number.
+ *
+ * Numbers with at most 19 significant digits and a mantissa and
+ * decimal exponent that are exactly representable as a double are
+ * computed with a single multiplication or division (Clinger's fast
+ * path), which gives the correctly rounded result, i.e. the same as
+ * strtod. Everything else is passed on to strtod.
+ */
+static inline const char *
+json_parse_number(const char *p, const char *pe, double &value)
+{
+  static const double pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  const char *start = p;
+  bool negative = false;
+  uint64_t mantissa = 0;
+  int digits = 0;  // significant digits (without leading zeros)
+  int exp10 = 0;
+
+  if (p < pe && (*p == '+' || *p == '-'))
+  {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  const char *int_start = p;
+  for (; p < pe && json_is_digit(*p); p++)
+  {
+    mantissa = mantissa * 10 + (*p - '0');
+    if (mantissa != 0) ++digits;
+  }
+  if (p == int_start) return NULL;
+
+  if (p < pe && *p == '.')
+  {
+    ++p;
+    for (; p < pe && json_is_digit(*p); p++)
+    {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa != 0) ++digits;
+      --exp10;
+    }
+  }
+
+  if (p < pe && (*p == 'e' || *p == 'E'))
+  {
+    const char *e = p + 1;
+    bool exp_negative = false;
+    int exp = 0;
+
+    if (e < pe && (*e == '+' || *e == '-'))
+    {
+      exp_negative = (*e == '-');
+      ++e;
+    }
+    if (e == pe || !json_is_digit(*e)) return NULL;
+
+    for (; e < pe && json_is_digit(*e); e++)
+    {
+      if (exp < 100000) exp = exp * 10 + (*e - '0');
+    }
+    exp10 += (exp_negative ? -exp : exp);
+    p = e;
+  }
+
+  if (digits <= 19 && mantissa <= ((uint64_t)1 << 53) && exp10 >= -22 && exp10 <= 22)
+  {
+    double d = (double) mantissa;
+    d = (exp10 < 0 ? d / pow10[-exp10] : d * pow10[exp10]);
+    value = (negative ? -d : d);
+    return p;
+  }
+
+  char numbuf[64];
+  const size_t sz = p - start;
+  if (sz >= sizeof(numbuf)) return NULL;
+  memcpy(numbuf, start, sz);
+  numbuf[sz] = '\000';
+  value = strtod(numbuf, NULL);
+  return p;
+}
+
+#endif
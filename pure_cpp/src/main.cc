@@ -1,47 +1,483 @@
 #include "simulator.h"
+#include "net_compiler.h"
+#include "net_file.h"
+#include "spike_file.h"
+#include "fire_log.h"
+#include "spike_db.h"
+#include "net_dumper.h"
+#include "weight_publisher.h"
+#include "net_stream.h"
+#include "net_format.h"
 #include <iostream>
+#include <fstream>
+#include <vector>
+#include <set>
+#include <stdio.h>
+#include <unistd.h>
 
 #include "synapse.h"
 #include "neuron_srm_01.h"
 
 #define DEF_TYPE(t) NeuralEntity *make_##t() { return new t(); }
 #define REG_TYPE(t, s) (s)->entity_register_type(#t, make_##t)
+#define REG_SHARED_TYPE(t, s) (s)->entity_register_type(#t, make_##t, make_##t##_Shared)
 
 DEF_TYPE(Synapse)
 DEF_TYPE(Neuron_SRM_01)
+DEF_TYPE(Neuron_SRM_01_Shared)
+
+/*
+ * Add the elements of the "," separated +list+ to +set+.
+ */
+static void
+split_list(const char *list, std::set<std::string> &set)
+{
+  for (const char *p = list; ; p++)
+  {
+    const char *end = strchr(p, ',');
+    if (end == NULL) end = p + strlen(p);
+    if (end != p) set.insert(std::string(p, end - p));
+    if (*end == '\0') break;
+    p = end;
+  }
+}
+
+/*
+ * Print the current snapshot of the weight file +filename+.
+ */
+static void
+print_weights(const char *filename)
+{
+  WeightReader reader(filename);
+  std::vector<float> weights;
+  double at;
+  char weight[32];
+
+  reader.read(weights, at);
+  printf("# at %g\n", at);
+  for (uint i = 0; i < reader.size(); i++)
+  {
+    FireLogReader::format_real(weight, sizeof(weight), weights[i]);
+    printf("%s\t%s\n", reader.id(i), weight);
+  }
+}
+
+/*
+ * The name of snapshot +n+ of a dump to +filename+: "net.yin" becomes
+ * "net.n.yin".
+ */
+static std::string
+snapshot_name(const char *filename, uint n)
+{
+  std::string name(filename);
+  char num[16];
+  snprintf(num, sizeof(num), ".%u", n);
+
+  const size_t dot = name.rfind('.');
+  const size_t slash = name.rfind('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return name + num;
+  return name.insert(dot, num);
+}
+
+/*
+ * Print the spikes of neuron +id+ (or of all neurons if NULL) with
+ * from <= at < to from the spike database +db+.
+ */
+static void
+query(const char *filename, const char *id, simtime from, simtime to)
+{
+  SpikeDb db(filename);
+  uint64_t first, count;
+  char weight[32], at[32];
+
+  if (id != NULL)
+  {
+    const uint32_t n = db.find(id);
+    if (n == SPIKE_DB_NONE) return;
+
+    db.spikes(n, from, to, first, count);
+    for (uint64_t s = first; s < first + count; s++)
+    {
+      FireLogReader::format_real(weight, sizeof(weight), db.weights != NULL ? db.weights[s] : INFINITY);
+      FireLogReader::format_real(at, sizeof(at), db.times[s]);
+      printf("%s\t%s@%s\n", id, weight, at);
+    }
+  }
+  else
+  {
+    db.window(from, to, first, count);
+    for (uint64_t s = first; s < first + count; s++)
+    {
+      FireLogReader::format_real(at, sizeof(at), db.raster[s].at);
+      printf("%s\t%s\n", db.id(db.raster[s].neuron), at);
+    }
+  }
+}
+
+static int
+usage()
+{
+  std::cout << "USAGE: yinspire [options] net stop_at [tolerance]" << std::endl;
+  std::cout << "       yinspire [options] --compile out.cc net" << std::endl;
+  std::cout << "       yinspire --convert out.net net" << std::endl;
+  std::cout << "       yinspire --query db.spdb [id] from to" << std::endl;
+  std::cout << "       yinspire --weights weights.bin" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Nets are JSON (.json), Yin (.yin), GraphML (.graphml) or binary" << std::endl;
+  std::cout << "(see --convert) files. Spike trains (.spike) are merged into a net." << std::endl;
+  std::cout << "Append :FORMAT (e.g. net.txt:yin) to give the format explicitly." << std::endl;
+  std::cout << "Spike trains are converted into binary spike files, which are" << std::endl;
+  std::cout << "decoded while the simulation runs. Fire logs (see --record) are" << std::endl;
+  std::cout << "converted into text (id<TAB>weight@at per line, - for stdout)," << std::endl;
+  std::cout << "or, like text logs, into a spike database if out ends in .spdb." << std::endl;
+  std::cout << std::endl;
+  std::cout << "OPTIONS:" << std::endl;
+  std::cout << "  --shared-params   share immutable parameters of entities" << std::endl;
+  std::cout << "                    loaded from the same template" << std::endl;
+  std::cout << "  --stream          load JSON nets without building a DOM" << std::endl;
+  std::cout << "  --threads N       load JSON nets on N threads" << std::endl;
+  std::cout << "  --pipeline        read, parse, construct and connect JSON nets" << std::endl;
+  std::cout << "                    in stages on separate threads, and report" << std::endl;
+  std::cout << "                    the time of each stage" << std::endl;
+  std::cout << "  --lazy            create entities and connections only when they" << std::endl;
+  std::cout << "                    are first used" << std::endl;
+  std::cout << "  --defer-events    pass the events of the nets to their entities" << std::endl;
+  std::cout << "                    only when the simulation reaches them" << std::endl;
+  std::cout << "  --merge FILE      merge the net in FILE into the loaded net" << std::endl;
+  std::cout << "  --prefix P        prefix the ids of the entities of the nets" << std::endl;
+  std::cout << "                    merged by the following --merge options" << std::endl;
+  std::cout << "  --record FILE     record all fire events into a binary fire log" << std::endl;
+  std::cout << "  --spike-db FILE   write the fire events into a spike database" << std::endl;
+  std::cout << "                    for --query after the run" << std::endl;
+  std::cout << "  --record-id x,y   record only the fire events of these entities" << std::endl;
+  std::cout << "  --record-type x,y record only the fire events of entities of" << std::endl;
+  std::cout << "                    these types" << std::endl;
+  std::cout << "  --stats FILE      write statistics of the fire events (rates, ISI," << std::endl;
+  std::cout << "                    population rate) to FILE (- for stdout)" << std::endl;
+  std::cout << "  --stats-bin W     bin width of the population rate (default: 1)" << std::endl;
+  std::cout << "  --stats-correlate x,y" << std::endl;
+  std::cout << "                    correlate the binned fires of these entities" << std::endl;
+  std::cout << "  --stats-every T   write the statistics also every T time units" << std::endl;
+  std::cout << "  --counts FILE     write the number of fire events of each" << std::endl;
+  std::cout << "                    (recorded) entity to FILE (- for stdout)" << std::endl;
+  std::cout << "  --counts-window W count the fire events in windows of W" << std::endl;
+  std::cout << "  --dump FILE       dump the net with it's current state to FILE" << std::endl;
+  std::cout << "                    after the run (.yin, .dot or binary)" << std::endl;
+  std::cout << "  --dump-every T    dump snapshots every T time units into" << std::endl;
+  std::cout << "                    FILE.1, FILE.2, ... (before the extension)" << std::endl;
+  std::cout << "  --dump-delta      snapshots after the first contain only the" << std::endl;
+  std::cout << "                    entities that changed" << std::endl;
+  std::cout << "  --publish-weights FILE" << std::endl;
+  std::cout << "                    keep the weights of all synapses in FILE, for" << std::endl;
+  std::cout << "                    other processes to map (see --weights)" << std::endl;
+  std::cout << "  --publish-every T update the weights every T time units" << std::endl;
+  std::cout << "                    (default: at the start and the end)" << std::endl;
+  std::cout << "  --resolution R    round spike times to multiples of R when" << std::endl;
+  std::cout << "                    converting spike trains (default: exact)" << std::endl;
+  return 1;
+}
 
 int main(int argc, char** argv)
 {
   Simulator sim;
-  simtime stop_at;
+  simtime stop_at = 0.0;
   real tolerance = 0.0;
   char *net;
+  char *compile_to = NULL;
+  char *convert_to = NULL;
+  char *prefix = NULL;
+  char *record_to = NULL;
+  char *spike_db = NULL;
+  char *query_db = NULL;
+  double resolution = 0.0;
+  char *stats_to = NULL;
+  simtime stats_bin = 1.0;
+  simtime stats_every = INFINITY;
+  std::set<std::string> stats_correlate;
+  char *counts_to = NULL;
+  simtime counts_window = INFINITY;
+  char *dump_to = NULL;
+  simtime dump_every = INFINITY;
+  bool dump_delta = false;
+  char *weights_to = NULL;
+  simtime weights_every = INFINITY;
+  char *weights_file = NULL;
+  std::vector<std::pair<char*, char*> > merges;
+  int i;
+
+  for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++)
+  {
+    if (strcmp(argv[i], "--compile") == 0 && i+1 < argc)
+    {
+      compile_to = argv[++i];
+    }
+    else if (strcmp(argv[i], "--convert") == 0 && i+1 < argc)
+    {
+      convert_to = argv[++i];
+    }
+    else if (strcmp(argv[i], "--shared-params") == 0)
+    {
+      sim.load_shared_params = true;
+    }
+    else if (strcmp(argv[i], "--stream") == 0)
+    {
+      sim.load_streaming = true;
+    }
+    else if (strcmp(argv[i], "--pipeline") == 0)
+    {
+      sim.load_pipelined = true;
+    }
+    else if (strcmp(argv[i], "--lazy") == 0)
+    {
+      sim.load_lazy = true;
+    }
+    else if (strcmp(argv[i], "--defer-events") == 0)
+    {
+      sim.load_deferred_events = true;
+    }
+    else if (strcmp(argv[i], "--merge") == 0 && i+1 < argc)
+    {
+      merges.push_back(std::make_pair(argv[++i], prefix));
+    }
+    else if (strcmp(argv[i], "--prefix") == 0 && i+1 < argc)
+    {
+      prefix = argv[++i];
+    }
+    else if (strcmp(argv[i], "--record") == 0 && i+1 < argc)
+    {
+      record_to = argv[++i];
+    }
+    else if (strcmp(argv[i], "--spike-db") == 0 && i+1 < argc)
+    {
+      spike_db = argv[++i];
+    }
+    else if (strcmp(argv[i], "--query") == 0 && i+1 < argc)
+    {
+      query_db = argv[++i];
+    }
+    else if (strcmp(argv[i], "--record-id") == 0 && i+1 < argc)
+    {
+      split_list(argv[++i], sim.record_ids);
+    }
+    else if (strcmp(argv[i], "--record-type") == 0 && i+1 < argc)
+    {
+      split_list(argv[++i], sim.record_types);
+    }
+    else if (strcmp(argv[i], "--stats") == 0 && i+1 < argc)
+    {
+      stats_to = argv[++i];
+    }
+    else if (strcmp(argv[i], "--stats-bin") == 0 && i+1 < argc)
+    {
+      stats_bin = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--stats-correlate") == 0 && i+1 < argc)
+    {
+      split_list(argv[++i], stats_correlate);
+    }
+    else if (strcmp(argv[i], "--stats-every") == 0 && i+1 < argc)
+    {
+      stats_every = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--counts") == 0 && i+1 < argc)
+    {
+      counts_to = argv[++i];
+    }
+    else if (strcmp(argv[i], "--counts-window") == 0 && i+1 < argc)
+    {
+      counts_window = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--dump") == 0 && i+1 < argc)
+    {
+      dump_to = argv[++i];
+    }
+    else if (strcmp(argv[i], "--dump-every") == 0 && i+1 < argc)
+    {
+      dump_every = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--dump-delta") == 0)
+    {
+      dump_delta = true;
+    }
+    else if (strcmp(argv[i], "--publish-weights") == 0 && i+1 < argc)
+    {
+      weights_to = argv[++i];
+    }
+    else if (strcmp(argv[i], "--publish-every") == 0 && i+1 < argc)
+    {
+      weights_every = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--weights") == 0 && i+1 < argc)
+    {
+      weights_file = argv[++i];
+    }
+    else if (strcmp(argv[i], "--resolution") == 0 && i+1 < argc)
+    {
+      resolution = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--threads") == 0 && i+1 < argc)
+    {
+      int threads = atoi(argv[++i]);
+      sim.load_threads = MAX(threads, 1);
+    }
+    else
+    {
+      return usage();
+    }
+  }
+
+  argc -= i;
+  argv += i;
 
-  if (argc == 3 || argc == 4)
+  if (weights_file != NULL && argc == 0)
+  {
+    print_weights(weights_file);
+    return 0;
+  }
+
+  if (query_db != NULL && (argc == 2 || argc == 3))
+  {
+    query(query_db, (argc == 3 ? argv[0] : NULL), atof(argv[argc-2]), atof(argv[argc-1]));
+    return 0;
+  }
+
+  if ((compile_to != NULL || convert_to != NULL) && argc == 1)
+  {
+    net = argv[0];
+  }
+  else if (compile_to == NULL && convert_to == NULL && (argc == 2 || argc == 3))
   {
-    net = argv[1];
-    stop_at = atof(argv[2]);
+    net = argv[0];
+    stop_at = atof(argv[1]);
 
-    if (argc == 4)
+    if (argc == 3)
     {
-      tolerance = atof(argv[3]);
+      tolerance = atof(argv[2]);
     }
   }
   else
   {
-    std::cout << "USAGE: yinspire net stop_at [tolerance]" << std::endl;
-    return 1;
+    return usage();
+  }
+
+  if (convert_to != NULL && strlen(convert_to) > 5 && strcmp(convert_to + strlen(convert_to) - 5, ".spdb") == 0)
+  {
+    SpikeDbWriter writer;
+    if (FireLogReader::is_fire_log(net)) writer.add_fire_log(net);
+    else writer.add_text_log(net);
+    writer.write(convert_to);
+    return 0;
+  }
+
+  if (convert_to != NULL && FireLogReader::is_fire_log(net))
+  {
+    FireLogReader::write_text(net, convert_to);
+    return 0;
+  }
+
+  if (convert_to != NULL)
+  {
+    std::string path;
+    NetFormat format = NetFormats::detect(net, path);
+    if (format == NET_FORMAT_SPIKE)
+    {
+      SpikeFileWriter writer;
+      writer.resolution = resolution;
+      NetFormats::parse_file(format, path.c_str(), &writer);
+      writer.write(convert_to);
+    }
+    else
+    {
+      NetFileWriter writer;
+      NetFormats::parse_file(format, path.c_str(), &writer);
+      writer.write(convert_to);
+    }
+    return 0;
   }
 
   REG_TYPE(Synapse, &sim);
-  REG_TYPE(Neuron_SRM_01, &sim);
+  REG_SHARED_TYPE(Neuron_SRM_01, &sim);
+
+  if (compile_to != NULL)
+  {
+    sim.load(net);
+    for (uint m = 0; m < merges.size(); m++) sim.merge(merges[m].first, merges[m].second);
+    std::ofstream out(compile_to);
+    NetCompiler(&sim).emit(out);
+    return 0;
+  }
 
   std::cout << "net: " << net << std::endl;
   std::cout << "stop_at: " << stop_at << std::endl;
   std::cout << "tolerance: " << tolerance << std::endl;
 
   sim.load(net);
+  for (uint m = 0; m < merges.size(); m++) sim.merge(merges[m].first, merges[m].second);
+
+  if (sim.load_times.total > 0.0)
+  {
+    const NetPipelineTimes &t = sim.load_times;
+    std::cout << "load read: " << t.read << "s (waiting " << t.read_wait << "s)" << std::endl;
+    std::cout << "load parse: " << t.parse << "s (waiting " << t.parse_wait << "s)" << std::endl;
+    std::cout << "load construct: " << t.construct << "s (waiting " << t.construct_wait << "s)" << std::endl;
+    std::cout << "load connect: " << t.connect << "s (waiting " << t.connect_wait << "s)" << std::endl;
+    std::cout << "load total: " << t.total << "s" << std::endl;
+  }
+
+  // the spike database is built from a fire log
+  std::string fire_log = (record_to != NULL ? record_to : "");
+  if (spike_db != NULL && record_to == NULL) fire_log = std::string(spike_db) + ".fires";
+
+  if (!fire_log.empty()) sim.record_open(fire_log.c_str());
+  if (stats_to != NULL) sim.stats_open(stats_bin, stats_correlate);
+  if (counts_to != NULL) sim.counts_open(counts_window, stop_at);
+
+  NetDumper dumper(&sim);
+  uint snapshots = 0;
+  WeightPublisher *publisher = (weights_to != NULL ? new WeightPublisher(&sim, weights_to) : NULL);
+
+  // run up to each checkpoint (if any) and write the statistics and
+  // snapshots
+  simtime next_stats = (stats_to != NULL && stats_every > 0.0 ? stats_every : INFINITY);
+  simtime next_dump = (dump_to != NULL && dump_every > 0.0 ? dump_every : INFINITY);
+  simtime next_weights = (publisher != NULL && weights_every > 0.0 ? weights_every : INFINITY);
+  while (MIN(MIN(next_stats, next_dump), next_weights) < stop_at)
+  {
+    const simtime t = MIN(MIN(next_stats, next_dump), next_weights);
+    sim.run(t);
+    if (t == next_weights)
+    {
+      publisher->publish();
+      next_weights += weights_every;
+    }
+    if (t == next_stats)
+    {
+      sim.stats_write(stats_to);
+      next_stats += stats_every;
+    }
+    if (t == next_dump)
+    {
+      ++snapshots;
+      dumper.dump_file(snapshot_name(dump_to, snapshots).c_str(), dump_delta && snapshots > 1);
+      next_dump += dump_every;
+    }
+  }
   sim.run(stop_at);
+  sim.record_close();
+  if (publisher != NULL) publisher->publish();
+  delete publisher;
+  if (stats_to != NULL) sim.stats_write(stats_to);
+  if (counts_to != NULL) sim.counts_write(counts_to);
+  if (dump_to != NULL && snapshots == 0) dumper.dump_file(dump_to);
+  else if (dump_to != NULL) dumper.dump_file(snapshot_name(dump_to, snapshots + 1).c_str(), dump_delta);
+
+  if (spike_db != NULL)
+  {
+    SpikeDbWriter writer;
+    writer.add_fire_log(fire_log.c_str());
+    writer.write(spike_db);
+    if (record_to == NULL) unlink(fire_log.c_str());
+  }
 
   std::cout << sim.stat_event_counter << std::endl;
   std::cout << sim.stat_fire_counter << std::endl;
@@ -0,0 +1,136 @@
+#include "mapped_file.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifndef WITHOUT_MMAP
+#include <sys/mman.h>
+#endif
+
+MappedFile::MappedFile(const char *filename, size_t min_size, const char *invalid)
+{
+  this->invalid = invalid;
+
+  int fh = open(filename, O_RDONLY);
+  if (fh < 0)
+  {
+    throw "cannot open file";
+  }
+
+  off_t sz = lseek(fh, 0, SEEK_END);
+  if (sz < (off_t)min_size)
+  {
+    close(fh);
+    throw invalid;
+  }
+  lseek(fh, 0, SEEK_SET);
+  this->size = sz;
+
+#ifdef WITHOUT_MMAP
+  this->mapped = false;
+  this->mem = (char*) malloc(this->size);
+  if (this->mem == NULL)
+  {
+    close(fh);
+    throw "malloc failed";
+  }
+  if (read(fh, this->mem, this->size) != (ssize_t)this->size)
+  {
+    free(this->mem);
+    close(fh);
+    throw "couldn't read entire file";
+  }
+#else
+  this->mapped = true;
+  this->mem = (char*) mmap(NULL, this->size, PROT_READ, MAP_SHARED, fh, 0);
+  if (this->mem == MAP_FAILED)
+  {
+    close(fh);
+    throw "mmap failed";
+  }
+#endif
+  close(fh);
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef WITHOUT_MMAP
+  if (this->mapped)
+  {
+    munmap(this->mem, this->size);
+    return;
+  }
+#endif
+  free(this->mem);
+}
+
+void
+MappedFile::check_header(const char *magic, uint32_t version, uint32_t byte_order,
+    const char *unsupported) const
+{
+  uint32_t v[2];
+
+  if (this->size < 16) throw this->invalid;
+  memcpy(v, this->mem + 8, sizeof(v));
+
+  if (memcmp(this->mem, magic, 8) != 0 || v[1] != byte_order)
+  {
+    throw this->invalid;
+  }
+
+  if (v[0] != version)
+  {
+    throw unsupported;
+  }
+}
+
+void *
+MappedFile::section(uint64_t offset, uint64_t count, size_t elem_size) const
+{
+  if (offset == 0) return NULL;
+
+  if (offset > this->size || (elem_size > 0 && count > (this->size - offset) / elem_size))
+  {
+    throw this->invalid;
+  }
+  return this->mem + offset;
+}
+
+bool
+MappedFile::has_magic(const char *filename, const char *magic)
+{
+  char buf[8];
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL) return false;
+  bool res = (fread(buf, 1, 8, f) == 8 && memcmp(buf, magic, 8) == 0);
+  fclose(f);
+  return res;
+}
+
+uint64_t
+write_section(FILE *f, uint64_t &pos, const void *data, uint64_t count, size_t elem_size)
+{
+  static const char zero[8] = {0,0,0,0,0,0,0,0};
+  uint64_t offset = pos;
+  uint64_t bytes = count * elem_size;
+
+  if (bytes > 0 && fwrite(data, 1, bytes, f) != bytes) throw "write failed";
+  pos += bytes;
+
+  if (pos % 8 != 0)
+  {
+    if (fwrite(zero, 1, 8 - pos % 8, f) != 8 - pos % 8) throw "write failed";
+    pos += 8 - pos % 8;
+  }
+
+  return offset;
+}
+
+void
+write_header(FILE *f, const void *header, size_t size)
+{
+  if (fseek(f, 0, SEEK_SET) != 0 || fwrite(header, 1, size, f) != size)
+  {
+    throw "write failed";
+  }
+}
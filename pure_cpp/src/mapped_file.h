@@ -0,0 +1,72 @@
+#ifndef __YINSPIRE__MAPPED_FILE__
+#define __YINSPIRE__MAPPED_FILE__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * A binary file (NetFile, SpikeFile, SpikeDb) mapped into memory, or
+ * read, if compiled WITHOUT_MMAP. The file stays there until the
+ * MappedFile is destroyed.
+ *
+ * All these files start with an 8 byte magic, a uint32_t version and
+ * a uint32_t byte order mark, followed by 8 byte aligned sections
+ * referenced by their offset (0 for missing sections).
+ */
+class MappedFile
+{
+    bool mapped;
+
+    /*
+     * Thrown if the file is too short or a section is out of bounds.
+     */
+    const char *invalid;
+
+  public:
+
+    char *mem;
+    size_t size;
+
+    /*
+     * Map +filename+, which must have at least +min_size+ bytes.
+     */
+    MappedFile(const char *filename, size_t min_size, const char *invalid);
+    ~MappedFile();
+
+    /*
+     * Check the magic, byte order and version at the start of the
+     * file. Throws +unsupported+ for other versions.
+     */
+    void check_header(const char *magic, uint32_t version, uint32_t byte_order,
+        const char *unsupported) const;
+
+    /*
+     * The section of +count+ elements of +elem_size+ bytes at
+     * +offset+, or NULL if +offset+ is 0.
+     */
+    void *section(uint64_t offset, uint64_t count, size_t elem_size) const;
+
+    /*
+     * Returns true if +filename+ starts with the 8 bytes of +magic+.
+     */
+    static bool has_magic(const char *filename, const char *magic);
+
+  private:
+
+    MappedFile(const MappedFile &other);
+    MappedFile &operator=(const MappedFile &other);
+};
+
+/*
+ * Append +count+ elements of +elem_size+ bytes to +f+ at +pos+,
+ * padded to 8 bytes. Returns the offset of the section.
+ */
+uint64_t write_section(FILE *f, uint64_t &pos, const void *data, uint64_t count, size_t elem_size);
+
+/*
+ * Overwrite the header at the start of +f+ with +header+.
+ */
+void write_header(FILE *f, const void *header, size_t size);
+
+#endif
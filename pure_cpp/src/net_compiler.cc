@@ -0,0 +1,352 @@
+#include "net_compiler.h"
+#include "simulator.h"
+#include "neuron_srm_01.h"
+#include "synapse.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <typeinfo>
+
+/*
+ * Output a real as a float literal which reads back bit-identical.
+ */
+static void
+emit_real(std::ostream &out, real v)
+{
+  if (isinf(v))
+  {
+    out << (v < 0.0 ? "-INFINITY" : "INFINITY");
+    return;
+  }
+
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.9g", (double)v);
+  out << buf;
+  if (strpbrk(buf, ".e") == NULL) out << ".0";
+  out << "f";
+}
+
+static void
+emit_string(std::ostream &out, const char *str)
+{
+  out << '"';
+  for (const char *p = str; *p != '\000'; p++)
+  {
+    if (*p == '"' || *p == '\\') out << '\\';
+    out << *p;
+  }
+  out << '"';
+}
+
+NetCompiler::NetCompiler(Simulator *simulator)
+{
+  this->simulator = simulator;
+}
+
+NetCompiler::~NetCompiler()
+{
+}
+
+void
+NetCompiler::emit(std::ostream &out)
+{
+  collect();
+
+  out << "/*" << std::endl;
+  out << " * Generated by \"inspire --compile\". DO NOT EDIT." << std::endl;
+  out << " *" << std::endl;
+  out << " * " << this->neurons.size() << " neurons, "
+      << this->class_params.size() << " neuron classes" << std::endl;
+  out << " */" << std::endl;
+  out << "#include \"compiled/runtime.h\"" << std::endl << std::endl;
+
+  out << "const uint net_size = " << this->neurons.size() << ";" << std::endl;
+  out << "NeuronState net_state[" << MAX(this->neurons.size(), 1) << "];" << std::endl << std::endl;
+
+  emit_classes(out);
+  emit_init(out);
+  emit_fanout(out);
+  emit_ids(out);
+  emit_initial(out);
+  emit_dispatch(out);
+
+  out << "int main(int argc, char **argv)" << std::endl;
+  out << "{" << std::endl;
+  out << "  return net_main(argc, argv);" << std::endl;
+  out << "}" << std::endl;
+}
+
+static bool
+id_less(const NeuralEntity *a, const NeuralEntity *b)
+{
+  return strcmp(a->get_id(), b->get_id()) < 0;
+}
+
+/*
+ * Collect all neurons and assign each of them a parameter class.
+ */
+void
+NetCompiler::collect()
+{
+  this->simulator->entity_materialize_all();
+  this->simulator->input_feed(INFINITY);
+
+  const EntityTable &entities = this->simulator->entities;
+
+  for (uint i = 0; i < entities.size(); i++)
+  {
+    NeuralEntity *entity = entities.at(i);
+    if (entity == NULL) continue;
+
+    if (typeid(*entity) == typeid(Neuron_SRM_01) || typeid(*entity) == typeid(Neuron_SRM_01_Shared))
+    {
+      this->neurons.push_back((Neuron*) entity);
+    }
+    else if (typeid(*entity) != typeid(Synapse))
+    {
+      throw "entity type not supported by the net compiler";
+    }
+  }
+
+  // net_lookup binary searches the ids, so the neurons are numbered in
+  // id order (not in the order of the entity table)
+  std::sort(this->neurons.begin(), this->neurons.end(), id_less);
+
+  for (uint i = 0; i < this->neurons.size(); i++)
+  {
+    Neuron *neuron = this->neurons[i];
+    NeuronParams p;
+    NeuronInit init;
+
+    if (typeid(*neuron) == typeid(Neuron_SRM_01))
+      neuron_state((Neuron_SRM_01*) neuron, p, init);
+    else
+      neuron_state((Neuron_SRM_01_Shared*) neuron, p, init);
+
+    this->neuron_index[neuron] = i;
+    this->neuron_class.push_back(classify(p));
+    this->neuron_init.push_back(init);
+  }
+}
+
+template <class Storage>
+void
+NetCompiler::neuron_state(Neuron_SRM_01_T<Storage> *neuron, NeuronParams &p, NeuronInit &init)
+{
+  const Neuron_SRM_01_Params &params = neuron->params.get();
+
+  p.tau_m = params.tau_m;
+  p.tau_ref = params.tau_ref;
+  p.ref_weight = params.ref_weight;
+  p.const_threshold = params.const_threshold;
+  p.abs_refr_duration = params.abs_refr_duration;
+
+  init.mem_pot = neuron->mem_pot;
+  init.last_spike_time = neuron->last_spike_time;
+  init.last_fire_time = neuron->last_fire_time;
+}
+
+/*
+ * Neurons with bitwise identical parameters share a class.
+ *
+ * O(log n)
+ */
+uint
+NetCompiler::classify(const NeuronParams &p)
+{
+  const real values[5] = {
+    p.tau_m, p.tau_ref, p.ref_weight, p.const_threshold, p.abs_refr_duration
+  };
+  const std::string key((const char*) values, sizeof(values));
+
+  std::map<std::string, uint>::iterator it = this->class_map.find(key);
+  if (it != this->class_map.end()) return it->second;
+
+  this->class_params.push_back(p);
+  this->class_map[key] = this->class_params.size() - 1;
+  return this->class_params.size() - 1;
+}
+
+void
+NetCompiler::emit_classes(std::ostream &out)
+{
+  for (uint c = 0; c < this->class_params.size(); c++)
+  {
+    const NeuronParams &p = this->class_params[c];
+
+    out << "struct Class_" << c << std::endl << "{" << std::endl;
+    out << "  static inline real tau_m() { return "; emit_real(out, p.tau_m); out << "; }" << std::endl;
+    out << "  static inline real tau_ref() { return "; emit_real(out, p.tau_ref); out << "; }" << std::endl;
+    out << "  static inline real ref_weight() { return "; emit_real(out, p.ref_weight); out << "; }" << std::endl;
+    out << "  static inline real const_threshold() { return "; emit_real(out, p.const_threshold); out << "; }" << std::endl;
+    out << "  static inline simtime abs_refr_duration() { return "; emit_real(out, p.abs_refr_duration); out << "; }" << std::endl;
+    out << "};" << std::endl << std::endl;
+  }
+
+  // the smallest type that holds all class indices
+  const uint classes = this->class_params.size();
+  const char *type = (classes <= 0x100 ? "unsigned char" : (classes <= 0x10000 ? "unsigned short" : "uint"));
+
+  out << "static const " << type << " net_class[] = {";
+  for (uint i = 0; i < this->neuron_class.size(); i++)
+  {
+    if (i % 32 == 0) out << std::endl << "  ";
+    out << this->neuron_class[i] << ",";
+  }
+  out << std::endl << "  0" << std::endl << "};" << std::endl << std::endl;
+}
+
+void
+NetCompiler::emit_init(std::ostream &out)
+{
+  out << "const NeuronInit net_init[] = {" << std::endl;
+  for (uint i = 0; i < this->neuron_init.size(); i++)
+  {
+    const NeuronInit &init = this->neuron_init[i];
+    out << "  {";
+    emit_real(out, init.mem_pot);
+    out << ", ";
+    emit_real(out, init.last_spike_time);
+    out << ", ";
+    emit_real(out, init.last_fire_time);
+    out << "}," << std::endl;
+  }
+  out << "  {0.0f, 0.0f, 0.0f}" << std::endl << "};" << std::endl << std::endl;
+}
+
+/*
+ * Emit the fan-out edges in the same order as Neuron::fire_synapses
+ * traverses the post synapses.
+ */
+void
+NetCompiler::emit_fanout(std::ostream &out)
+{
+  std::vector<uint> start;
+  uint edges = 0;
+
+  out << "const FanoutEdge net_fanout[] = {" << std::endl;
+
+  for (uint i = 0; i < this->neurons.size(); i++)
+  {
+    Neuron *neuron = this->neurons[i];
+    start.push_back(edges);
+
+    for (Synapse *syn = neuron->first_post_synapse; syn != NULL;
+        syn = syn->next_post_synapse)
+    {
+      /*
+       * See Synapse::stimulate. A synapse looping back to it's pre
+       * Neuron never propagates.
+       */
+      if (syn->post_neuron == NULL || syn->post_neuron == neuron)
+        continue;
+
+      out << "  {" << this->neuron_index[syn->post_neuron] << ", ";
+      emit_real(out, syn->weight);
+      out << ", ";
+      emit_real(out, syn->delay);
+      out << "}," << std::endl;
+      ++edges;
+    }
+  }
+  start.push_back(edges);
+
+  out << "  {0, 0.0f, 0.0f}" << std::endl << "};" << std::endl << std::endl;
+
+  out << "const uint net_fanout_start[] = {";
+  for (uint i = 0; i < start.size(); i++)
+  {
+    if (i % 16 == 0) out << std::endl << "  ";
+    out << start[i];
+    if (i+1 < start.size()) out << ",";
+  }
+  out << std::endl << "};" << std::endl << std::endl;
+}
+
+void
+NetCompiler::emit_ids(std::ostream &out)
+{
+  out << "const char *const net_ids[] = {" << std::endl;
+  for (uint i = 0; i < this->neurons.size(); i++)
+  {
+    out << "  ";
+    emit_string(out, this->neurons[i]->get_id());
+    out << "," << std::endl;
+  }
+  out << "  NULL" << std::endl << "};" << std::endl << std::endl;
+}
+
+static std::ostream *emit_initial_out;
+static uint emit_initial_neuron;
+static uint emit_initial_count;
+
+static void
+emit_initial_stimulus(const Stimulus &s, void *data)
+{
+  std::ostream &out = *emit_initial_out;
+  out << "  {" << emit_initial_neuron << ", ";
+  emit_real(out, s.at);
+  out << ", ";
+  emit_real(out, s.weight);
+  out << "}," << std::endl;
+  ++emit_initial_count;
+}
+
+static void
+emit_initial_schedule(NeuralEntity *const &entity, void *data)
+{
+  std::map<NeuralEntity*, uint> &index = *((std::map<NeuralEntity*, uint>*)data);
+  *emit_initial_out << "  " << index[entity] << "," << std::endl;
+  ++emit_initial_count;
+}
+
+/*
+ * The heaps are emitted in array order. Pushing the elements of a
+ * heap in array order into an empty heap results in the very same
+ * array.
+ */
+void
+NetCompiler::emit_initial(std::ostream &out)
+{
+  emit_initial_out = &out;
+  emit_initial_count = 0;
+
+  out << "const InitialStimulus net_initial_stimuli[] = {" << std::endl;
+  for (uint i = 0; i < this->neurons.size(); i++)
+  {
+    emit_initial_neuron = i;
+    this->neurons[i]->stimuli_pq.each(emit_initial_stimulus, NULL);
+  }
+  out << "  {0, 0.0f, 0.0f}" << std::endl << "};" << std::endl;
+  out << "const uint net_initial_stimuli_size = " << emit_initial_count << ";" << std::endl << std::endl;
+
+  emit_initial_count = 0;
+  out << "const uint net_initial_schedule[] = {" << std::endl;
+  this->simulator->schedule_pq.each(emit_initial_schedule, &this->neuron_index);
+  out << "  0" << std::endl << "};" << std::endl;
+  out << "const uint net_initial_schedule_size = " << emit_initial_count << ";" << std::endl;
+  out << "const uint net_initial_event_counter = " << this->simulator->stat_event_counter << ";" << std::endl << std::endl;
+}
+
+void
+NetCompiler::emit_dispatch(std::ostream &out)
+{
+  const char *fns[2][2] = {
+    {"void net_stimulate(uint i, simtime at, real weight)", "srm01_stimulate<Class_%u>(i, at, weight)"},
+    {"void net_process(uint i, simtime at)", "srm01_process<Class_%u>(i, at)"}
+  };
+  char buf[128];
+
+  for (uint f = 0; f < 2; f++)
+  {
+    out << fns[f][0] << std::endl << "{" << std::endl;
+    out << "  switch (net_class[i])" << std::endl << "  {" << std::endl;
+    for (uint c = 0; c < this->class_params.size(); c++)
+    {
+      snprintf(buf, sizeof(buf), fns[f][1], c);
+      out << "    case " << c << ": " << buf << "; break;" << std::endl;
+    }
+    out << "  }" << std::endl << "}" << std::endl << std::endl;
+  }
+}
@@ -0,0 +1,99 @@
+#ifndef __YINSPIRE__NET_COMPILER__
+#define __YINSPIRE__NET_COMPILER__
+
+#include "types.h"
+#include <ostream>
+#include <map>
+#include <string>
+#include <vector>
+
+class Simulator;
+class NeuralEntity;
+class Neuron;
+template <class Storage> class Neuron_SRM_01_T;
+
+/*
+ * Translates a loaded net into a C++ file that, compiled together
+ * with "compiled/runtime.h", results in a simulator specialized for
+ * exactly this net.
+ *
+ * Neurons with identical parameters share a class whose parameters
+ * are emitted as constants. The initial state of each neuron is
+ * emitted into a table, so that it does not split classes. Synapses are folded into static fan-out
+ * tables of their pre Neurons. The state of all stimuli pq's and of
+ * the schedule pq after loading is emitted as well, so that a
+ * compiled net without external input reproduces the results of
+ * "inspire" exactly.
+ *
+ * Only Neuron_SRM_01 (shared or not) and Synapse are supported.
+ */
+class NetCompiler
+{
+  protected:
+
+    Simulator *simulator;
+
+    /*
+     * All neurons in id order. Their position is their index in the
+     * compiled net.
+     */
+    std::vector<Neuron*> neurons;
+    std::map<NeuralEntity*, uint> neuron_index;
+
+    /*
+     * The immutable parameters of a neuron.
+     */
+    struct NeuronParams
+    {
+      real tau_m, tau_ref, ref_weight, const_threshold;
+      simtime abs_refr_duration;
+    };
+
+    /*
+     * The state of a neuron after loading.
+     */
+    struct NeuronInit
+    {
+      real mem_pot;
+      simtime last_spike_time, last_fire_time;
+    };
+
+    /*
+     * The parameter class and initial state of each neuron.
+     */
+    std::vector<uint> neuron_class;
+    std::vector<NeuronInit> neuron_init;
+    std::vector<NeuronParams> class_params;
+
+    /*
+     * The bytes of the parameters of a class -> it's index.
+     */
+    std::map<std::string, uint> class_map;
+
+  public:
+
+    NetCompiler(Simulator *simulator);
+    ~NetCompiler();
+
+    /*
+     * Write the C++ source of the compiled net to +out+.
+     */
+    void emit(std::ostream &out);
+
+  protected:
+
+    void collect();
+    template <class Storage> static void neuron_state(Neuron_SRM_01_T<Storage> *neuron,
+        NeuronParams &p, NeuronInit &init);
+    uint classify(const NeuronParams &p);
+
+    void emit_classes(std::ostream &out);
+    void emit_init(std::ostream &out);
+    void emit_fanout(std::ostream &out);
+    void emit_ids(std::ostream &out);
+    void emit_initial(std::ostream &out);
+    void emit_dispatch(std::ostream &out);
+
+};
+
+#endif
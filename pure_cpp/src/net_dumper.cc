@@ -0,0 +1,433 @@
+#include "net_dumper.h"
+#include "net_file.h"
+#include "simulator.h"
+#include "neuron.h"
+#include "synapse.h"
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <set>
+
+/*
+ * The targets of the connections of an entity, collected by
+ * collect_connection (each_connection has no user data).
+ */
+static std::vector<NeuralEntity*> *collect_targets;
+
+static void
+collect_connection(NeuralEntity *self, NeuralEntity *conn)
+{
+  collect_targets->push_back(conn);
+}
+
+static void
+collect_stimulus(const Stimulus &s, void *data)
+{
+  ((std::vector<Stimulus>*) data)->push_back(s);
+}
+
+/*
+ * FNV-1a
+ */
+static inline uint64_t
+hash_bytes(uint64_t h, const void *data, size_t len)
+{
+  const unsigned char *p = (const unsigned char*) data;
+  for (size_t i = 0; i < len; i++)
+  {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+#define HASH_INIT 14695981039346656037ULL
+
+static uint64_t
+hash_state(jsonHash *data)
+{
+  uint64_t h = HASH_INIT;
+
+  jsonHashIterator_EACH(data, key, value)
+  {
+    h = hash_bytes(h, key->value.data(), key->value.size() + 1);
+    const char *type = value->type();
+    h = hash_bytes(h, type, strlen(type));
+    if (value->is_type("number"))
+    {
+      h = hash_bytes(h, &value->asNumber()->value, sizeof(double));
+    }
+  }
+  return (h != 0 ? h : 1);
+}
+
+static uint64_t
+hash_connections(const std::vector<NeuralEntity*> &targets)
+{
+  uint64_t h = HASH_INIT;
+
+  for (uint i = 0; i < targets.size(); i++)
+  {
+    uint index = targets[i]->get_index();
+    h = hash_bytes(h, &index, sizeof(index));
+  }
+  return (h != 0 ? h : 1);
+}
+
+NetDumper::NetDumper(Simulator *simulator)
+{
+  this->simulator = simulator;
+}
+
+NetDumper::~NetDumper()
+{
+}
+
+uint
+NetDumper::dump(NetStreamHandler *handler, bool changed_only)
+{
+  if (!changed_only) this->simulator->entity_materialize_all();
+
+  const EntityTable &entities = this->simulator->entities;
+  const uint n = entities.size();
+  std::vector<NeuralEntity*> targets;
+  std::vector<bool> dumped(n, false);
+  std::vector<bool> connections_dumped(n, false);
+  std::set<std::string> types;
+  uint count = 0;
+
+  this->state_hashes.resize(n, 0);
+  this->connection_hashes.resize(n, 0);
+  collect_targets = &targets;
+
+  /*
+   * Find the entities that changed. Their states are dumped again
+   * below, so that only one of them is in memory at a time.
+   */
+  for (uint i = 0; i < n; i++)
+  {
+    NeuralEntity *entity = entities.at(i);
+    if (entity == NULL) continue;
+    if (entity->entity_type() == NULL) throw "entity type cannot be dumped";
+
+    jsonHash *state = new jsonHash();
+    entity->dump(state);
+    const uint64_t h = hash_state(state);
+    state->ref_decr();
+
+    targets.clear();
+    entity->each_connection(collect_connection);
+    const uint64_t ch = hash_connections(targets);
+
+    if (!changed_only || h != this->state_hashes[i]) dumped[i] = true;
+    if (!changed_only || ch != this->connection_hashes[i])
+    {
+      dumped[i] = connections_dumped[i] = true;
+
+      // the targets have to be part of the dump, too
+      for (uint t = 0; t < targets.size(); t++)
+      {
+        if (targets[t]->get_index() != ENTITY_NO_INDEX) dumped[targets[t]->get_index()] = true;
+      }
+    }
+    this->state_hashes[i] = h;
+    this->connection_hashes[i] = ch;
+  }
+
+  for (uint i = 0; i < n; i++)
+  {
+    if (dumped[i]) types.insert(entities.at(i)->entity_type());
+  }
+  for (std::set<std::string>::iterator t = types.begin(); t != types.end(); t++)
+  {
+    handler->on_template(*t, *t, NULL);
+  }
+
+  for (uint i = 0; i < n; i++)
+  {
+    if (!dumped[i]) continue;
+
+    NeuralEntity *entity = entities.at(i);
+    jsonHash *state = new jsonHash();
+    try
+    {
+      entity->dump(state);
+      handler->on_entity(entities.name(i), entity->entity_type(), state);
+    }
+    catch (...)
+    {
+      state->ref_decr();
+      throw;
+    }
+    state->ref_decr();
+    ++count;
+  }
+
+  for (uint i = 0; i < n; i++)
+  {
+    if (!connections_dumped[i]) continue;
+
+    targets.clear();
+    entities.at(i)->each_connection(collect_connection);
+    if (targets.empty()) continue;
+
+    handler->on_connections(entities.name(i));
+    for (uint t = 0; t < targets.size(); t++)
+    {
+      if (targets[t]->get_index() != ENTITY_NO_INDEX) handler->on_connection(targets[t]->get_id());
+    }
+  }
+
+  std::vector<Stimulus> stimuli;
+  for (uint i = 0; i < n; i++)
+  {
+    if (!dumped[i] || entities.at(i)->stimuli_pq.empty()) continue;
+
+    stimuli.clear();
+    entities.at(i)->stimuli_pq.each(collect_stimulus, &stimuli);
+    std::sort(stimuli.begin(), stimuli.end(), Stimulus::less);
+
+    handler->on_events(entities.name(i));
+    for (uint s = 0; s < stimuli.size(); s++)
+    {
+      handler->on_event(stimuli[s].at, stimuli[s].weight);
+    }
+  }
+
+  return count;
+}
+
+static void
+dot_string(std::ostream &out, const char *str)
+{
+  out << '"';
+  for (const char *p = str; *p != '\000'; p++)
+  {
+    if (*p == '"' || *p == '\\') out << '\\';
+    out << *p;
+  }
+  out << '"';
+}
+
+void
+NetDumper::dump_dot(std::ostream &out)
+{
+  this->simulator->entity_materialize_all();
+
+  const EntityTable &entities = this->simulator->entities;
+  std::vector<NeuralEntity*> targets;
+  collect_targets = &targets;
+
+  out << "digraph {" << std::endl;
+  out << "node [shape = circle];" << std::endl;
+
+  for (uint i = 0; i < entities.size(); i++)
+  {
+    Neuron *neuron = dynamic_cast<Neuron*>(entities.at(i));
+    if (neuron == NULL) continue;
+
+    targets.clear();
+    neuron->each_connection(collect_connection);
+    for (uint t = 0; t < targets.size(); t++)
+    {
+      Synapse *syn = dynamic_cast<Synapse*>(targets[t]);
+      if (syn == NULL || syn->get_index() == ENTITY_NO_INDEX ||
+          syn->get_post_neuron() == NULL || syn->get_post_neuron()->get_index() == ENTITY_NO_INDEX)
+      {
+        continue;
+      }
+
+      dot_string(out, entities.name(i));
+      out << " -> ";
+      dot_string(out, syn->get_post_neuron()->get_id());
+      out << " [label = ";
+      dot_string(out, syn->get_id());
+      out << " ];" << std::endl;
+    }
+  }
+  out << "}" << std::endl;
+}
+
+uint
+NetDumper::dump_file(const char *filename, bool changed_only)
+{
+  const char *ext = strrchr(filename, '.');
+  uint count = 0;
+
+  if (ext != NULL && (strcmp(ext, ".yin") == 0 || strcmp(ext, ".dot") == 0))
+  {
+    std::ofstream out(filename);
+    if (!out) throw "cannot open file";
+
+    if (strcmp(ext, ".dot") == 0)
+    {
+      dump_dot(out);
+    }
+    else
+    {
+      YinWriter writer(out);
+      count = dump(&writer, changed_only);
+      writer.finish();
+    }
+
+    out.close();
+    if (!out) throw "write failed";
+  }
+  else
+  {
+    NetFileWriter writer;
+    count = dump(&writer, changed_only);
+    writer.write(filename);
+  }
+  return count;
+}
+
+YinWriter::YinWriter(std::ostream &out) : out(out)
+{
+  this->line = LINE_NONE;
+  this->items = 0;
+}
+
+void
+YinWriter::on_template(const std::string &name, const std::string &type, jsonHash *data)
+{
+  // types are implicit templates of the same name
+  if (name == type && (data == NULL || data->size == 0)) return;
+
+  end_line();
+  this->out << "TEMPLATE ";
+  write_id(name);
+  this->out << " < ";
+  write_id(type);
+  this->out << " ";
+  write_properties(data);
+}
+
+void
+YinWriter::on_entity(const std::string &id, const std::string &template_name, jsonHash *data)
+{
+  end_line();
+  this->out << "ENTITY ";
+  write_id(id);
+  this->out << " = ";
+  write_id(template_name);
+  this->out << " ";
+  write_properties(data);
+}
+
+void
+YinWriter::on_connections(const std::string &from)
+{
+  end_line();
+  this->out << "CONNECT ";
+  write_id(from);
+  this->out << " -> ";
+  this->line = LINE_CONNECT;
+  this->items = 0;
+}
+
+void
+YinWriter::on_connection(const std::string &to)
+{
+  if (this->items++ > 0) this->out << ", ";
+  write_id(to);
+}
+
+void
+YinWriter::on_events(const std::string &id)
+{
+  end_line();
+  this->out << std::endl << "STIMULATE ";
+  write_id(id);
+  this->out << " ! {" << std::endl << "  ";
+  this->line = LINE_EVENTS;
+  this->items = 0;
+}
+
+void
+YinWriter::on_event(simtime at, real weight)
+{
+  if (this->items > 0) this->out << (this->items % 5 == 0 ? "\n  " : " ");
+  ++this->items;
+
+  if (!isinf(weight) || weight < 0.0)
+  {
+    write_number(weight);
+    this->out << "@";
+  }
+  write_number(at);
+}
+
+void
+YinWriter::finish()
+{
+  end_line();
+  this->out.flush();
+}
+
+void
+YinWriter::end_line()
+{
+  if (this->line == LINE_CONNECT) this->out << std::endl;
+  else if (this->line == LINE_EVENTS) this->out << std::endl << "}" << std::endl;
+  this->line = LINE_NONE;
+}
+
+void
+YinWriter::write_id(const std::string &id)
+{
+  bool word = !id.empty();
+  for (uint i = 0; i < id.size() && word; i++)
+  {
+    const char c = id[i];
+    word = ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_');
+  }
+
+  if (word) this->out << id;
+  else this->out << '"' << id << '"';
+}
+
+/*
+ * Numbers are written with enough digits to read back as the same
+ * float.
+ */
+void
+YinWriter::write_number(double value)
+{
+  if (isinf(value))
+  {
+    this->out << (value < 0.0 ? "-Infinity" : "Infinity");
+    return;
+  }
+
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.9g", value);
+  this->out << buf;
+  if (strpbrk(buf, ".en") == NULL) this->out << ".0";
+}
+
+void
+YinWriter::write_properties(jsonHash *data)
+{
+  if (data == NULL || data->size == 0)
+  {
+    this->out << std::endl;
+    return;
+  }
+
+  this->out << "{" << std::endl;
+  jsonHashIterator_EACH(data, key, value)
+  {
+    this->out << "  ";
+    write_id(key->value);
+    this->out << " = ";
+    if (value->is_type("number")) write_number(value->asNumber()->value);
+    else if (value->is_type("true")) this->out << "true";
+    else if (value->is_type("false")) this->out << "false";
+    else throw "property cannot be dumped";
+    this->out << std::endl;
+  }
+  this->out << "}" << std::endl;
+}
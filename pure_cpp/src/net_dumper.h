@@ -0,0 +1,109 @@
+#ifndef __YINSPIRE__NET_DUMPER__
+#define __YINSPIRE__NET_DUMPER__
+
+#include "types.h"
+#include "net_stream.h"
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class Simulator;
+
+/*
+ * Dumps the entities of a Simulator with their current state (see
+ * NeuralEntity::dump), their connections and pending stimuli, like
+ * the Ruby dumpers (lib/Yinspire/Dumpers).
+ *
+ * The net is passed to a NetStreamHandler, e.g. a NetFileWriter for
+ * the binary format or a YinWriter, so that the dump can be loaded
+ * again. Only entities with an id are dumped. Input events that were
+ * not passed to their entities yet (see Simulator::load_deferred_events)
+ * are not part of the dump.
+ *
+ * Incremental dumps (+changed_only+) contain only the entities whose
+ * state or outgoing connections changed since the previous dump by
+ * the same NetDumper, e.g. the weights of plastic synapses and the
+ * membrane potentials of neurons that were stimulated. Entities whose
+ * connections changed are dumped with all of them, and with their
+ * targets, so that every dump is a complete net by itself. To detect
+ * changes, a hash of the state of each entity is kept (16 bytes per
+ * entity).
+ */
+class NetDumper
+{
+  protected:
+
+    Simulator *simulator;
+
+    /*
+     * Hash of the state and of the connections of each entity (by
+     * index) at the previous dump, 0 if not dumped yet.
+     */
+    std::vector<uint64_t> state_hashes;
+    std::vector<uint64_t> connection_hashes;
+
+  public:
+
+    NetDumper(Simulator *simulator);
+    ~NetDumper();
+
+    /*
+     * Dump the net (or what changed since the last dump) to
+     * +handler+. Returns the number of entities dumped.
+     */
+    uint dump(NetStreamHandler *handler, bool changed_only=false);
+
+    /*
+     * Write the net in the GraphViz dot format (Neurons as nodes,
+     * Synapses as edges) to +out+. Unconnected synapses are not shown.
+     */
+    void dump_dot(std::ostream &out);
+
+    /*
+     * Dump the net to +filename+ in the yin format (.yin), the dot
+     * format (.dot) or the binary net format (otherwise). Returns the
+     * number of entities dumped.
+     */
+    uint dump_file(const char *filename, bool changed_only=false);
+};
+
+/*
+ * Writes the net passed to it in the Yin format (see YinParser), as
+ * Dumper_Yin does. finish() has to be called at the end.
+ */
+class YinWriter : public NetStreamHandler
+{
+  protected:
+
+    std::ostream &out;
+
+    /*
+     * What the last line written was, so that it can be continued
+     * (connections, events) or finished.
+     */
+    enum { LINE_NONE, LINE_CONNECT, LINE_EVENTS } line;
+    uint items;
+
+  public:
+
+    YinWriter(std::ostream &out);
+
+    virtual void on_template(const std::string &name, const std::string &type, jsonHash *data);
+    virtual void on_entity(const std::string &id, const std::string &template_name, jsonHash *data);
+    virtual void on_connections(const std::string &from);
+    virtual void on_connection(const std::string &to);
+    virtual void on_events(const std::string &id);
+    virtual void on_event(simtime at, real weight);
+
+    void finish();
+
+  protected:
+
+    void end_line();
+    void write_id(const std::string &id);
+    void write_number(double value);
+    void write_properties(jsonHash *data);
+};
+
+#endif
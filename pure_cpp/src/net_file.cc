@@ -0,0 +1,403 @@
+#include "net_file.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+NetFile::NetFile(const char *filename) : file(filename, sizeof(NetFileHeader), "invalid net file")
+{
+  this->file.check_header(NET_FILE_MAGIC, NET_FILE_VERSION, NET_FILE_BYTE_ORDER, "unsupported net file version");
+  this->header = (NetFileHeader*) this->file.mem;
+
+  NetFileHeader *h = this->header;
+  this->templates = (NetFileTemplate*) this->file.section(h->off_templates, h->num_templates, sizeof(NetFileTemplate));
+  this->properties = (NetFileProperty*) this->file.section(h->off_properties, h->num_properties, sizeof(NetFileProperty));
+  this->entity_ids = (uint32_t*) this->file.section(h->off_entity_ids, h->num_entities, sizeof(uint32_t));
+  this->entity_templates = (uint32_t*) this->file.section(h->off_entity_templates, h->num_entities, sizeof(uint32_t));
+  this->connection_index = (uint32_t*) this->file.section(h->off_connection_index, (uint64_t)h->num_entities+1, sizeof(uint32_t));
+  this->connection_targets = (uint32_t*) this->file.section(h->off_connection_targets, h->num_connections, sizeof(uint32_t));
+  this->event_entities = (uint32_t*) this->file.section(h->off_event_entities, h->num_event_groups, sizeof(uint32_t));
+  this->event_index = (uint32_t*) this->file.section(h->off_event_index, (uint64_t)h->num_event_groups+1, sizeof(uint32_t));
+  this->event_times = (float*) this->file.section(h->off_event_times, h->num_events, sizeof(float));
+  this->event_weights = (float*) this->file.section(h->off_event_weights, h->num_events, sizeof(float));
+  this->strings = (const char*) this->file.section(h->off_strings, h->strings_size, 1);
+
+  validate();
+}
+
+NetFile::~NetFile()
+{
+}
+
+/*
+ * +index+ (of +n+ + 1 elements) starts at 0, never decreases and ends
+ * at +total+.
+ */
+static bool
+valid_index(const uint32_t *index, uint32_t n, uint32_t total)
+{
+  if (index == NULL || index[0] != 0 || index[n] != total) return false;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    if (index[i] > index[i+1]) return false;
+  }
+  return true;
+}
+
+/*
+ * Check all references between the sections, so that a net file can
+ * be used without further bounds checks.
+ */
+void
+NetFile::validate()
+{
+  const NetFileHeader *h = this->header;
+
+  if ((h->num_templates > 0 && this->templates == NULL) ||
+      (h->num_properties > 0 && this->properties == NULL) ||
+      (h->num_entities > 0 && (this->entity_ids == NULL || this->entity_templates == NULL)) ||
+      (h->num_connections > 0 && this->connection_targets == NULL) ||
+      (h->num_event_groups > 0 && this->event_entities == NULL) ||
+      (h->num_events > 0 && this->event_times == NULL) ||
+      (h->strings_size > 0 && this->strings == NULL))
+  {
+    throw "invalid net file";
+  }
+
+  // every string ends within the strings section
+  if (h->strings_size > 0 && this->strings[h->strings_size-1] != '\0')
+  {
+    throw "invalid net file";
+  }
+
+  for (uint32_t t = 0; t < h->num_templates; t++)
+  {
+    const NetFileTemplate &tmpl = this->templates[t];
+    if (tmpl.name >= h->strings_size || tmpl.type >= h->strings_size ||
+        tmpl.first_property > h->num_properties ||
+        tmpl.num_properties > h->num_properties - tmpl.first_property)
+    {
+      throw "invalid net file";
+    }
+  }
+
+  for (uint32_t p = 0; p < h->num_properties; p++)
+  {
+    if (this->properties[p].key >= h->strings_size) throw "invalid net file";
+  }
+
+  for (uint32_t i = 0; i < h->num_entities; i++)
+  {
+    if (this->entity_ids[i] >= h->strings_size ||
+        this->entity_templates[i] >= h->num_templates)
+    {
+      throw "invalid net file";
+    }
+  }
+
+  if (!valid_index(this->connection_index, h->num_entities, h->num_connections) ||
+      !valid_index(this->event_index, h->num_event_groups, h->num_events))
+  {
+    throw "invalid net file";
+  }
+
+  for (uint32_t c = 0; c < h->num_connections; c++)
+  {
+    if (this->connection_targets[c] >= h->num_entities) throw "invalid net file";
+  }
+
+  for (uint32_t g = 0; g < h->num_event_groups; g++)
+  {
+    if (this->event_entities[g] >= h->num_entities) throw "invalid net file";
+  }
+}
+
+bool
+NetFile::is_net_file(const char *filename)
+{
+  return MappedFile::has_magic(filename, NET_FILE_MAGIC);
+}
+
+jsonHash *
+NetFile::template_hash(uint32_t t) const
+{
+  const NetFileTemplate &tmpl = this->templates[t];
+  jsonHash *hash = new jsonHash();
+
+  for (uint32_t i = tmpl.first_property; i < tmpl.first_property + tmpl.num_properties; i++)
+  {
+    const NetFileProperty &prop = this->properties[i];
+    switch (prop.kind)
+    {
+      case NET_FILE_NUMBER: hash->set(string(prop.key), prop.value); break;
+      case NET_FILE_TRUE: hash->set(string(prop.key), true); break;
+      case NET_FILE_FALSE: hash->set(string(prop.key), false); break;
+      default: throw "invalid net file";
+    }
+  }
+
+  return hash;
+}
+
+NetFileWriter::NetFileWriter()
+{
+  this->has_event_weights = false;
+  this->current_entity = 0;
+  this->event_index.push_back(0);
+}
+
+NetFileWriter::~NetFileWriter()
+{
+}
+
+uint32_t
+NetFileWriter::add_string(const char *str)
+{
+  uint32_t offset = this->strings.size();
+  this->strings.append(str);
+  this->strings.push_back('\000');
+  return offset;
+}
+
+uint32_t
+NetFileWriter::add_template(const char *name, const char *type, jsonHash *data)
+{
+  NetFileTemplate t;
+  t.name = add_string(name);
+  t.type = add_string(type);
+  t.first_property = this->properties.size();
+  t.num_properties = 0;
+
+  if (data != NULL) add_properties(t, data);
+
+  this->templates.push_back(t);
+  return this->templates.size() - 1;
+}
+
+void
+NetFileWriter::add_properties(NetFileTemplate &t, jsonHash *data)
+{
+  jsonHashIterator_EACH(data, key, val)
+  {
+    NetFileProperty prop;
+    prop.key = add_string(key->value.c_str());
+    prop.value = 0.0;
+
+    if (val->is_type("number"))
+    {
+      prop.kind = NET_FILE_NUMBER;
+      prop.value = val->asNumber()->value;
+    }
+    else if (val->is_type("true"))
+    {
+      prop.kind = NET_FILE_TRUE;
+    }
+    else if (val->is_type("false"))
+    {
+      prop.kind = NET_FILE_FALSE;
+    }
+    else
+    {
+      throw "unsupported property type";
+    }
+
+    this->properties.push_back(prop);
+    ++t.num_properties;
+  }
+}
+
+/*
+ * A copy of template +template_index+ with the properties of +data+
+ * appended, which take precedence when the net is loaded. Entities
+ * with equal properties share the copy.
+ */
+uint32_t
+NetFileWriter::add_template_variant(uint32_t template_index, jsonHash *data)
+{
+  std::string key((const char*)&template_index, sizeof(template_index));
+  {
+    jsonHashIterator_EACH(data, k, val)
+    {
+      double value = (val->is_type("number") ? val->asNumber()->value : 0.0);
+      key.append(k->value);
+      key.push_back('\000');
+      key.append(val->type());
+      key.append((const char*)&value, sizeof(value));
+    }
+  }
+
+  std::map<std::string, uint32_t>::iterator it = this->template_variants.find(key);
+  if (it != this->template_variants.end()) return it->second;
+
+  NetFileTemplate t = this->templates[template_index];
+  const uint32_t first = t.first_property;
+
+  t.first_property = this->properties.size();
+  for (uint32_t i = first; i < first + t.num_properties; i++)
+  {
+    this->properties.push_back(this->properties[i]);
+  }
+  add_properties(t, data);
+
+  this->templates.push_back(t);
+  return (this->template_variants[key] = this->templates.size() - 1);
+}
+
+uint32_t
+NetFileWriter::add_entity(const char *id, uint32_t template_index)
+{
+  this->entity_ids.push_back(add_string(id));
+  this->entity_templates.push_back(template_index);
+  this->connections.push_back(std::vector<uint32_t>());
+  return this->entity_ids.size() - 1;
+}
+
+void
+NetFileWriter::add_connection(uint32_t from, uint32_t to)
+{
+  this->connections[from].push_back(to);
+}
+
+void
+NetFileWriter::add_event(uint32_t entity, simtime at, real weight)
+{
+  if (this->event_entities.empty() || this->event_entities.back() != entity)
+  {
+    this->event_entities.push_back(entity);
+    this->event_index.push_back(this->event_index.back());
+  }
+
+  this->event_times.push_back(at);
+  this->event_weights.push_back(weight);
+  ++this->event_index.back();
+
+  if (!isinf(weight) || weight < 0.0) this->has_event_weights = true;
+}
+
+void
+NetFileWriter::on_template(const std::string &name, const std::string &type, jsonHash *data)
+{
+  this->template_map[name] = add_template(name.c_str(), type.c_str(), data);
+}
+
+void
+NetFileWriter::on_entity(const std::string &id, const std::string &template_name, jsonHash *data)
+{
+  std::map<std::string, uint32_t>::iterator it = this->template_map.find(template_name);
+  if (it == this->template_map.end()) throw "unknown template";
+
+  uint32_t t = it->second;
+  if (data != NULL) t = add_template_variant(t, data);
+  this->entity_map[id] = add_entity(id.c_str(), t);
+}
+
+uint32_t
+NetFileWriter::lookup(const std::string &id)
+{
+  std::map<std::string, uint32_t>::iterator it = this->entity_map.find(id);
+  if (it == this->entity_map.end()) throw "unknown entity";
+  return it->second;
+}
+
+void
+NetFileWriter::on_connections(const std::string &from)
+{
+  this->current_entity = lookup(from);
+}
+
+void
+NetFileWriter::on_connection(const std::string &to)
+{
+  add_connection(this->current_entity, lookup(to));
+}
+
+void
+NetFileWriter::on_events(const std::string &id)
+{
+  this->current_entity = lookup(id);
+}
+
+void
+NetFileWriter::on_event(simtime at, real weight)
+{
+  add_event(this->current_entity, at, weight);
+}
+
+template <typename T>
+static inline const T *
+data_of(const std::vector<T> &v)
+{
+  return (v.empty() ? NULL : &v[0]);
+}
+
+void
+NetFileWriter::write(const char *filename)
+{
+  NetFileHeader h;
+  memset(&h, 0, sizeof(h));
+
+  std::vector<uint32_t> connection_index;
+  std::vector<uint32_t> connection_targets;
+
+  connection_index.push_back(0);
+  for (uint32_t i = 0; i < this->connections.size(); i++)
+  {
+    connection_targets.insert(connection_targets.end(),
+        this->connections[i].begin(), this->connections[i].end());
+    connection_index.push_back(connection_targets.size());
+  }
+
+  FILE *f = fopen(filename, "wb");
+  if (f == NULL) throw "cannot open file";
+
+  try
+  {
+    write_sections(f, h, connection_index, connection_targets);
+  }
+  catch (...)
+  {
+    fclose(f);
+    throw;
+  }
+  if (fclose(f) != 0) throw "write failed";
+}
+
+/*
+ * Write a dummy header first, then all sections and finally the
+ * real header.
+ */
+void
+NetFileWriter::write_sections(FILE *f, NetFileHeader &h,
+    const std::vector<uint32_t> &connection_index, const std::vector<uint32_t> &connection_targets)
+{
+  uint64_t pos = 0;
+  write_section(f, pos, &h, 1, sizeof(h));
+
+  memcpy(h.magic, NET_FILE_MAGIC, 8);
+  h.version = NET_FILE_VERSION;
+  h.byte_order = NET_FILE_BYTE_ORDER;
+  h.num_templates = this->templates.size();
+  h.num_properties = this->properties.size();
+  h.num_entities = this->entity_ids.size();
+  h.num_connections = connection_targets.size();
+  h.num_event_groups = this->event_entities.size();
+  h.num_events = this->event_times.size();
+  h.strings_size = this->strings.size();
+
+  h.off_templates = write_section(f, pos, data_of(this->templates), h.num_templates, sizeof(NetFileTemplate));
+  h.off_properties = write_section(f, pos, data_of(this->properties), h.num_properties, sizeof(NetFileProperty));
+  h.off_entity_ids = write_section(f, pos, data_of(this->entity_ids), h.num_entities, sizeof(uint32_t));
+  h.off_entity_templates = write_section(f, pos, data_of(this->entity_templates), h.num_entities, sizeof(uint32_t));
+  h.off_connection_index = write_section(f, pos, data_of(connection_index), h.num_entities+1, sizeof(uint32_t));
+  h.off_connection_targets = write_section(f, pos, data_of(connection_targets), h.num_connections, sizeof(uint32_t));
+  h.off_event_entities = write_section(f, pos, data_of(this->event_entities), h.num_event_groups, sizeof(uint32_t));
+  h.off_event_index = write_section(f, pos, data_of(this->event_index), h.num_event_groups+1, sizeof(uint32_t));
+  h.off_event_times = write_section(f, pos, data_of(this->event_times), h.num_events, sizeof(float));
+  if (this->has_event_weights)
+  {
+    h.off_event_weights = write_section(f, pos, data_of(this->event_weights), h.num_events, sizeof(float));
+  }
+  h.off_strings = write_section(f, pos, this->strings.data(), h.strings_size, 1);
+
+  write_header(f, &h, sizeof(h));
+}
@@ -0,0 +1,226 @@
+#ifndef __YINSPIRE__NET_FILE__
+#define __YINSPIRE__NET_FILE__
+
+#include "types.h"
+#include "mapped_file.h"
+#include "json/json.h"
+#include "net_stream.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+/*
+ * A versioned binary net format that can be mapped into memory and
+ * used without any parsing.
+ *
+ * Layout (all sections 8 byte aligned, native byte order):
+ *
+ *   NetFileHeader
+ *   templates         NetFileTemplate[num_templates]
+ *   properties        NetFileProperty[num_properties]
+ *   entity_ids        uint32_t[num_entities]    (string offsets)
+ *   entity_templates  uint32_t[num_entities]
+ *   connection_index  uint32_t[num_entities+1]  (CSR)
+ *   connection_targets uint32_t[num_connections] (entity indices)
+ *   event_entities    uint32_t[num_event_groups]
+ *   event_index       uint32_t[num_event_groups+1] (CSR)
+ *   event_times       float[num_events]
+ *   event_weights     float[num_events] (optional, default Infinity)
+ *   strings           NUL-terminated strings
+ *
+ * Connections are grouped by their source entity. For each source the
+ * targets are in the order in which they were connected.  Events are
+ * grouped by entity in the order in which they are applied.
+ */
+
+#define NET_FILE_MAGIC "YINSPIRE"
+#define NET_FILE_VERSION 1
+#define NET_FILE_BYTE_ORDER 0x01020304
+
+struct NetFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+
+  uint32_t num_templates;
+  uint32_t num_properties;
+  uint32_t num_entities;
+  uint32_t num_connections;
+  uint32_t num_event_groups;
+  uint32_t num_events;
+
+  uint64_t strings_size;
+
+  uint64_t off_templates;
+  uint64_t off_properties;
+  uint64_t off_entity_ids;
+  uint64_t off_entity_templates;
+  uint64_t off_connection_index;
+  uint64_t off_connection_targets;
+  uint64_t off_event_entities;
+  uint64_t off_event_index;
+  uint64_t off_event_times;
+  uint64_t off_event_weights;
+  uint64_t off_strings;
+};
+
+/*
+ * A template, i.e. an entity type plus a list of properties
+ * (properties[first_property ... first_property+num_properties-1]).
+ */
+struct NetFileTemplate
+{
+  uint32_t name;
+  uint32_t type;
+  uint32_t first_property;
+  uint32_t num_properties;
+};
+
+enum NetFilePropertyKind
+{
+  NET_FILE_NUMBER = 0,
+  NET_FILE_TRUE = 1,
+  NET_FILE_FALSE = 2
+};
+
+struct NetFileProperty
+{
+  uint32_t key;
+  uint32_t kind;
+  double value;
+};
+
+/*
+ * Read access to a binary net file. The file is mapped into memory
+ * (or read, if compiled WITHOUT_MMAP) and stays there until the
+ * NetFile is destroyed.
+ */
+class NetFile
+{
+  protected:
+
+    MappedFile file;
+
+  public:
+
+    NetFileHeader *header;
+    NetFileTemplate *templates;
+    NetFileProperty *properties;
+    uint32_t *entity_ids;
+    uint32_t *entity_templates;
+    uint32_t *connection_index;
+    uint32_t *connection_targets;
+    uint32_t *event_entities;
+    uint32_t *event_index;
+    float *event_times;
+    float *event_weights;
+    const char *strings;
+
+  public:
+
+    NetFile(const char *filename);
+    ~NetFile();
+
+    /*
+     * Returns true if +filename+ starts with NET_FILE_MAGIC.
+     */
+    static bool is_net_file(const char *filename);
+
+    inline const char *
+      string(uint32_t offset) const
+      {
+        return this->strings + offset;
+      }
+
+    /*
+     * Build a jsonHash with the properties of template +t+.
+     */
+    jsonHash *template_hash(uint32_t t) const;
+
+  protected:
+
+    void validate();
+};
+
+/*
+ * Builds a binary net file. Entities, connections and events are
+ * added one by one, e.g. by a loader, or directly from a "yinspire.c"
+ * JSON net passed to NetStreamParser.
+ */
+class NetFileWriter : public NetStreamHandler
+{
+  protected:
+
+    std::vector<NetFileTemplate> templates;
+    std::vector<NetFileProperty> properties;
+    std::vector<uint32_t> entity_ids;
+    std::vector<uint32_t> entity_templates;
+    std::vector<std::vector<uint32_t> > connections;
+    std::vector<uint32_t> event_entities;
+    std::vector<uint32_t> event_index;
+    std::vector<float> event_times;
+    std::vector<float> event_weights;
+    bool has_event_weights;
+    std::string strings;
+
+    /*
+     * Used when converting a "yinspire.c" net.
+     */
+    std::map<std::string, uint32_t> template_map;
+    std::map<std::string, uint32_t> entity_map;
+    uint32_t current_entity;
+
+    /*
+     * Templates created for entities with own properties (see
+     * add_template_variant).
+     */
+    std::map<std::string, uint32_t> template_variants;
+
+  public:
+
+    NetFileWriter();
+    virtual ~NetFileWriter();
+
+    /*
+     * Add a template with properties from +data+ (may be NULL) and
+     * return it's index.
+     */
+    uint32_t add_template(const char *name, const char *type, jsonHash *data);
+
+    /*
+     * Add an entity and return it's index.
+     */
+    uint32_t add_entity(const char *id, uint32_t template_index);
+
+    void add_connection(uint32_t from, uint32_t to);
+
+    /*
+     * Add an event for +entity+. Consecutive events of the same entity
+     * are grouped together.
+     */
+    void add_event(uint32_t entity, simtime at, real weight);
+
+    virtual void on_template(const std::string &name, const std::string &type, jsonHash *data);
+    virtual void on_entity(const std::string &id, const std::string &template_name, jsonHash *data);
+    virtual void on_connections(const std::string &from);
+    virtual void on_connection(const std::string &to);
+    virtual void on_events(const std::string &id);
+    virtual void on_event(simtime at, real weight);
+
+    void write(const char *filename);
+
+  protected:
+
+    void write_sections(FILE *f, NetFileHeader &h, const std::vector<uint32_t> &connection_index,
+        const std::vector<uint32_t> &connection_targets);
+
+    uint32_t add_string(const char *str);
+    void add_properties(NetFileTemplate &t, jsonHash *data);
+    uint32_t add_template_variant(uint32_t template_index, jsonHash *data);
+    uint32_t lookup(const std::string &id);
+};
+
+#endif
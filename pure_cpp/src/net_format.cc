@@ -0,0 +1,56 @@
+#include "net_format.h"
+#include "net_file.h"
+#include "yin_parser.h"
+#include "graphml_parser.h"
+#include "spike_parser.h"
+#include "spike_file.h"
+#include <string.h>
+
+static bool
+format_from_name(const char *name, NetFormat &format)
+{
+  if (strcmp(name, "json") == 0) format = NET_FORMAT_JSON;
+  else if (strcmp(name, "yin") == 0) format = NET_FORMAT_YIN;
+  else if (strcmp(name, "graphml") == 0) format = NET_FORMAT_GRAPHML;
+  else if (strcmp(name, "spike") == 0 || strcmp(name, "spikes") == 0) format = NET_FORMAT_SPIKE;
+  else return false;
+  return true;
+}
+
+NetFormat
+NetFormats::detect(const char *filename, std::string &path)
+{
+  NetFormat format;
+  const char *colon = strrchr(filename, ':');
+
+  if (colon != NULL && format_from_name(colon + 1, format))
+  {
+    path.assign(filename, colon - filename);
+    return format;
+  }
+
+  path = filename;
+  if (NetFile::is_net_file(filename)) return NET_FORMAT_BINARY;
+  if (SpikeFile::is_spike_file(filename)) return NET_FORMAT_SPIKE_FILE;
+
+  const char *ext = strrchr(filename, '.');
+  if (ext != NULL && strchr(ext, '/') == NULL && format_from_name(ext + 1, format))
+  {
+    return format;
+  }
+  return NET_FORMAT_JSON;
+}
+
+void
+NetFormats::parse_file(NetFormat format, const char *path, NetStreamHandler *handler)
+{
+  switch (format)
+  {
+    case NET_FORMAT_JSON: NetStreamParser::parse_file(path, handler); break;
+    case NET_FORMAT_YIN: YinParser::parse_file(path, handler); break;
+    case NET_FORMAT_GRAPHML: GraphMLParser::parse_file(path, handler); break;
+    case NET_FORMAT_SPIKE: SpikeParser::parse_file(path, handler); break;
+    case NET_FORMAT_SPIKE_FILE: SpikeFile::parse_file(path, handler); break;
+    default: throw "cannot parse binary net files";
+  }
+}
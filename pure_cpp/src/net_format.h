@@ -0,0 +1,41 @@
+#ifndef __YINSPIRE__NET_FORMAT__
+#define __YINSPIRE__NET_FORMAT__
+
+#include "net_stream.h"
+#include <string>
+
+enum NetFormat
+{
+  NET_FORMAT_BINARY = 0,
+  NET_FORMAT_JSON,
+  NET_FORMAT_YIN,
+  NET_FORMAT_GRAPHML,
+  NET_FORMAT_SPIKE,
+  NET_FORMAT_SPIKE_FILE
+};
+
+/*
+ * Selects the parser for a net file.
+ */
+class NetFormats
+{
+  public:
+
+    /*
+     * The format of +filename+, which is given explicitly as
+     * "FILE:FORMAT" (FORMAT is one of json, yin, graphml or spike, as
+     * in bin/yinspire), by the magic of the binary net or spike file
+     * formats or by the extension (.yin, .graphml, .spike). Everything
+     * else is JSON.
+     * +path+ is set to the filename without ":FORMAT".
+     */
+    static NetFormat detect(const char *filename, std::string &path);
+
+    /*
+     * Parse +path+ in +format+ (other than NET_FORMAT_BINARY) and pass
+     * it's contents to +handler+.
+     */
+    static void parse_file(NetFormat format, const char *path, NetStreamHandler *handler);
+};
+
+#endif
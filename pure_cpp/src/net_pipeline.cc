@@ -0,0 +1,512 @@
+#include "net_pipeline.h"
+#include "bounded_queue.h"
+#include "json/json_reader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <vector>
+
+#define PIPELINE_CHUNK_SIZE (256*1024)
+#define PIPELINE_CHUNKS 8
+#define PIPELINE_BATCH_ITEMS 4096
+#define PIPELINE_BATCHES 8
+
+struct PipelineChunk
+{
+  char *data;
+  size_t size;
+};
+
+enum
+{
+  ITEM_TEMPLATE = 0,
+  ITEM_ENTITY,
+  ITEM_CONNECTIONS,
+  ITEM_CONNECTION,
+  ITEM_EVENTS,
+  ITEM_EVENT
+};
+
+/*
+ * A handler call recorded by the parse stage. Strings are stored as
+ * offset and length into NetStreamBatch::strings.
+ */
+struct PipelineItem
+{
+  uint32_t kind;
+  uint32_t str, len;
+  uint32_t str2, len2;
+  simtime at;
+  real weight;
+  jsonHash *data;
+};
+
+/*
+ * A sequence of recorded handler calls.
+ */
+class NetStreamBatch
+{
+    std::vector<PipelineItem> items;
+    std::string strings;
+
+  public:
+
+    ~NetStreamBatch()
+    {
+      for (uint i = 0; i < this->items.size(); i++)
+      {
+        if (this->items[i].data != NULL) this->items[i].data->ref_decr();
+      }
+    }
+
+    inline uint size() const { return this->items.size(); }
+
+    /*
+     * True if the batch holds connections and events (for the
+     * connect stage), false if it holds templates and entities.
+     */
+    inline bool links() const { return !this->items.empty() && this->items[0].kind >= ITEM_CONNECTIONS; }
+
+    void
+      add(uint32_t kind, const std::string *s1, const std::string *s2, simtime at, real weight, jsonHash *data)
+      {
+        PipelineItem item;
+        item.kind = kind;
+        item.str = item.len = item.str2 = item.len2 = 0;
+        item.at = at;
+        item.weight = weight;
+        item.data = data;
+
+        if (s1 != NULL)
+        {
+          item.str = this->strings.size();
+          item.len = s1->size();
+          this->strings.append(*s1);
+        }
+        if (s2 != NULL)
+        {
+          item.str2 = this->strings.size();
+          item.len2 = s2->size();
+          this->strings.append(*s2);
+        }
+        if (data != NULL) data->ref_incr();
+
+        this->items.push_back(item);
+      }
+
+    void
+      replay(NetStreamHandler *handler)
+      {
+        std::string s1, s2;
+
+        for (uint i = 0; i < this->items.size(); i++)
+        {
+          const PipelineItem &item = this->items[i];
+          s1.assign(this->strings, item.str, item.len);
+
+          switch (item.kind)
+          {
+            case ITEM_TEMPLATE:
+              s2.assign(this->strings, item.str2, item.len2);
+              handler->on_template(s1, s2, item.data);
+              break;
+            case ITEM_ENTITY:
+              s2.assign(this->strings, item.str2, item.len2);
+              handler->on_entity(s1, s2, item.data);
+              break;
+            case ITEM_CONNECTIONS: handler->on_connections(s1); break;
+            case ITEM_CONNECTION: handler->on_connection(s1); break;
+            case ITEM_EVENTS: handler->on_events(s1); break;
+            case ITEM_EVENT: handler->on_event(item.at, item.weight); break;
+          }
+        }
+      }
+};
+
+/*
+ * A jsonReader which takes it's input from the chunks of the read
+ * stage instead of reading a file.
+ */
+class PipelineReader : public jsonReader
+{
+    BoundedQueue<PipelineChunk> *chunks;
+
+  public:
+
+    PipelineReader(BoundedQueue<PipelineChunk> *chunks)
+    {
+      this->chunks = chunks;
+    }
+
+    virtual ~PipelineReader()
+    {
+      free(this->buf);
+      this->buf = NULL;
+    }
+
+  protected:
+
+    virtual bool
+      fill()
+      {
+        PipelineChunk chunk;
+
+        if (this->eof) return false;
+
+        free(this->buf);
+        this->buf = NULL;
+        this->offset += this->end;
+        this->pos = this->end = 0;
+
+        if (!this->chunks->pop(chunk))
+        {
+          this->eof = true;
+          return false;
+        }
+
+        this->buf = chunk.data;
+        this->end = chunk.size;
+        return true;
+      }
+};
+
+/*
+ * Records the handler calls of the NetStreamParser into batches and
+ * passes them on to the construct stage. A batch holds either
+ * templates and entities or connections and events, never both.
+ */
+class PipelineRecorder : public NetStreamHandler
+{
+    BoundedQueue<NetStreamBatch*> *batches;
+    NetStreamBatch *batch;
+
+  public:
+
+    PipelineRecorder(BoundedQueue<NetStreamBatch*> *batches)
+    {
+      this->batches = batches;
+      this->batch = new NetStreamBatch();
+    }
+
+    virtual ~PipelineRecorder()
+    {
+      delete this->batch;
+    }
+
+    void
+      flush()
+      {
+        if (this->batch->size() == 0) return;
+
+        NetStreamBatch *full = this->batch;
+        this->batch = new NetStreamBatch();
+        if (!this->batches->push(full))
+        {
+          // the construct stage has failed
+          delete full;
+          throw "load cancelled";
+        }
+      }
+
+    virtual void
+      on_template(const std::string &name, const std::string &type, jsonHash *data)
+      {
+        add(ITEM_TEMPLATE, &name, &type, 0.0, 0.0, data);
+      }
+
+    virtual void
+      on_entity(const std::string &id, const std::string &template_name, jsonHash *data)
+      {
+        add(ITEM_ENTITY, &id, &template_name, 0.0, 0.0, data);
+      }
+
+    virtual void on_connections(const std::string &from) { add(ITEM_CONNECTIONS, &from, NULL, 0.0, 0.0, NULL); }
+    virtual void on_connection(const std::string &to) { add(ITEM_CONNECTION, &to, NULL, 0.0, 0.0, NULL); }
+    virtual void on_events(const std::string &id) { add(ITEM_EVENTS, &id, NULL, 0.0, 0.0, NULL); }
+    virtual void on_event(simtime at, real weight) { add(ITEM_EVENT, NULL, NULL, at, weight, NULL); }
+
+  protected:
+
+    /*
+     * A full batch is passed on only with the next call: the
+     * NetStreamParser releases +data+ after the handler returned, and
+     * the reference count of a jsonValue must not be changed by two
+     * threads at the same time.
+     */
+    inline void
+      add(uint32_t kind, const std::string *s1, const std::string *s2, simtime at, real weight, jsonHash *data)
+      {
+        if (this->batch->size() >= PIPELINE_BATCH_ITEMS ||
+            (this->batch->size() > 0 && this->batch->links() != (kind >= ITEM_CONNECTIONS)))
+        {
+          flush();
+        }
+        this->batch->add(kind, s1, s2, at, weight, data);
+      }
+};
+
+struct Pipeline
+{
+  FILE *file;
+  NetStreamHandler *handler;
+  BoundedQueue<PipelineChunk> chunks;
+  BoundedQueue<NetStreamBatch*> batches;
+  BoundedQueue<NetStreamBatch*> links;
+
+  /*
+   * Errors of the read, parse and construct stage, or NULL.
+   */
+  const char *read_error;
+  const char *parse_error;
+  const char *construct_error;
+
+  double read_time;
+  double parse_time;
+  double construct_time;
+
+  Pipeline() : chunks(PIPELINE_CHUNKS), batches(PIPELINE_BATCHES), links(PIPELINE_BATCHES)
+  {
+    this->file = NULL;
+    this->handler = NULL;
+    this->read_error = NULL;
+    this->parse_error = NULL;
+    this->construct_error = NULL;
+    this->read_time = 0.0;
+    this->parse_time = 0.0;
+    this->construct_time = 0.0;
+  }
+
+  ~Pipeline();
+
+  /*
+   * Stop all stages after an error.
+   */
+  void
+    cancel()
+    {
+      this->links.close();
+      this->batches.close();
+      this->chunks.close();
+    }
+
+  /*
+   * Stop all stages and release what is left in the queues. Must be
+   * called after the threads have finished.
+   */
+  void
+    drain()
+    {
+      PipelineChunk chunk;
+      NetStreamBatch *batch;
+
+      while (this->chunks.pop(chunk)) free(chunk.data);
+      while (this->batches.pop(batch)) delete batch;
+      while (this->links.pop(batch)) delete batch;
+    }
+};
+
+Pipeline::~Pipeline()
+{
+}
+
+static void *
+pipeline_read(void *arg)
+{
+  Pipeline *p = (Pipeline*) arg;
+  double start = BoundedQueue<PipelineChunk>::now();
+
+  while (true)
+  {
+    PipelineChunk chunk;
+    chunk.data = (char*) malloc(PIPELINE_CHUNK_SIZE);
+    if (chunk.data == NULL)
+    {
+      p->read_error = "malloc failed";
+      break;
+    }
+
+    chunk.size = fread(chunk.data, 1, PIPELINE_CHUNK_SIZE, p->file);
+    if (chunk.size == 0 || !p->chunks.push(chunk))
+    {
+      if (ferror(p->file)) p->read_error = "couldn't read entire file";
+      free(chunk.data);
+      break;
+    }
+  }
+  p->chunks.close();
+
+  p->read_time = BoundedQueue<PipelineChunk>::now() - start;
+  return NULL;
+}
+
+static void *
+pipeline_parse(void *arg)
+{
+  Pipeline *p = (Pipeline*) arg;
+  double start = BoundedQueue<PipelineChunk>::now();
+
+  try
+  {
+    PipelineReader reader(&p->chunks);
+    PipelineRecorder recorder(&p->batches);
+    NetStreamParser::parse(reader, &recorder);
+    recorder.flush();
+  }
+  catch (const char *err)
+  {
+    p->parse_error = err;
+  }
+  catch (...)
+  {
+    p->parse_error = "error occured while parsing";
+  }
+
+  // stops the read stage if parsing failed
+  p->chunks.close();
+  p->batches.close();
+
+  p->parse_time = BoundedQueue<PipelineChunk>::now() - start;
+  return NULL;
+}
+
+/*
+ * Replays the batches of templates and entities and passes the
+ * connections and events on to the connect stage.
+ */
+static void *
+pipeline_construct(void *arg)
+{
+  Pipeline *p = (Pipeline*) arg;
+  double start = BoundedQueue<PipelineChunk>::now();
+  NetStreamBatch *batch;
+
+  try
+  {
+    while (p->batches.pop(batch))
+    {
+      if (batch->links())
+      {
+        if (!p->links.push(batch))
+        {
+          // the connect stage has failed
+          delete batch;
+          break;
+        }
+        continue;
+      }
+
+      try
+      {
+        batch->replay(p->handler);
+      }
+      catch (...)
+      {
+        delete batch;
+        throw;
+      }
+      delete batch;
+    }
+  }
+  catch (const char *err)
+  {
+    p->construct_error = err;
+  }
+  catch (...)
+  {
+    p->construct_error = "error occured while loading";
+  }
+
+  // stops the read and parse stage if construction failed
+  if (p->construct_error != NULL) p->cancel();
+  p->links.close();
+
+  p->construct_time = BoundedQueue<PipelineChunk>::now() - start;
+  return NULL;
+}
+
+void
+NetStreamPipeline::parse_file(const char *filename, NetStreamHandler *handler, NetPipelineTimes *times)
+{
+  Pipeline p;
+  pthread_t threads[3];
+  void *(*stages[3])(void*) = {pipeline_read, pipeline_parse, pipeline_construct};
+  double start = BoundedQueue<PipelineChunk>::now();
+  uint started;
+
+  p.handler = handler;
+  p.file = fopen(filename, "rb");
+  if (p.file == NULL)
+  {
+    throw "cannot open file";
+  }
+
+  for (started = 0; started < 3; started++)
+  {
+    if (pthread_create(&threads[started], NULL, stages[started], &p) != 0) break;
+  }
+  if (started < 3)
+  {
+    p.cancel();
+    while (started > 0) pthread_join(threads[--started], NULL);
+    p.drain();
+    fclose(p.file);
+    throw "cannot create thread";
+  }
+
+  NetStreamBatch *batch;
+  const char *error = NULL;
+  double connect_start = BoundedQueue<PipelineChunk>::now();
+
+  try
+  {
+    while (p.links.pop(batch))
+    {
+      try
+      {
+        batch->replay(handler);
+      }
+      catch (...)
+      {
+        delete batch;
+        throw;
+      }
+      delete batch;
+    }
+  }
+  catch (const char *err)
+  {
+    error = err;
+  }
+  catch (...)
+  {
+    error = "error occured while loading";
+  }
+
+  // stops the other stages
+  if (error != NULL) p.cancel();
+
+  double connect_time = BoundedQueue<PipelineChunk>::now() - connect_start;
+
+  for (uint i = 3; i > 0; i--) pthread_join(threads[i-1], NULL);
+  p.drain();
+  fclose(p.file);
+
+  // the other stages fail with "load cancelled" after construction failed
+  if (error == NULL) error = p.construct_error;
+  if (error == NULL) error = p.read_error;
+  if (error == NULL) error = p.parse_error;
+  if (error != NULL) throw error;
+
+  if (times != NULL)
+  {
+    times->total = BoundedQueue<PipelineChunk>::now() - start;
+    times->read_wait = p.chunks.push_wait;
+    times->read = p.read_time - times->read_wait;
+    times->parse_wait = p.chunks.pop_wait + p.batches.push_wait;
+    times->parse = p.parse_time - times->parse_wait;
+    times->construct_wait = p.batches.pop_wait + p.links.push_wait;
+    times->construct = p.construct_time - times->construct_wait;
+    times->connect_wait = p.links.pop_wait;
+    times->connect = connect_time - times->connect_wait;
+  }
+}
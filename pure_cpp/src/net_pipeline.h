@@ -0,0 +1,49 @@
+#ifndef __YINSPIRE__NET_PIPELINE__
+#define __YINSPIRE__NET_PIPELINE__
+
+#include "net_stream.h"
+
+/*
+ * Wall clock time (in seconds) spent in each stage of a
+ * NetStreamPipeline. The time a stage was blocked on one of it's
+ * queues is not included, but given separately as +*_wait+.
+ */
+struct NetPipelineTimes
+{
+  double read, read_wait;
+  double parse, parse_wait;
+  double construct, construct_wait;
+  double connect, connect_wait;
+  double total;
+};
+
+/*
+ * Parses a "yinspire.c" net like NetStreamParser, but in four stages
+ * which run at the same time:
+ *
+ *   read:      reads the file in chunks (own thread)
+ *   parse:     parses the chunks into batches of items (own thread)
+ *   construct: passes templates and entities to the +handler+ (own
+ *              thread)
+ *   connect:   passes connections and events to the +handler+
+ *              (calling thread)
+ *
+ * The stages are connected by bounded queues, so memory usage stays
+ * independent of the size of the file. The +handler+ is called in
+ * the same order as by NetStreamParser, but from two threads: the
+ * construct stage calls on_template() and on_entity(), the connect
+ * stage all other methods. As the sections of a net are ordered, all
+ * entities have been constructed before the first connection is
+ * passed on, so the two never call the +handler+ at the same time.
+ * Constructing the last entities overlaps with parsing the
+ * connections, and connecting with parsing the rest of the file.
+ */
+class NetStreamPipeline
+{
+  public:
+
+    static void parse_file(const char *filename, NetStreamHandler *handler,
+        NetPipelineTimes *times=NULL);
+};
+
+#endif
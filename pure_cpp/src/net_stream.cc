@@ -0,0 +1,150 @@
+#include "net_stream.h"
+#include "json/json_reader.h"
+#include <stdio.h>
+#include <math.h>
+
+enum
+{
+  SECTION_FORMAT = 0,
+  SECTION_TEMPLATES,
+  SECTION_ENTITIES,
+  SECTION_CONNECTIONS,
+  SECTION_EVENTS
+};
+
+void
+NetStreamParser::parse(jsonReader &r, NetStreamHandler *handler)
+{
+  std::string key, str, name;
+  bool has_format = false;
+  int section = SECTION_FORMAT;
+  int next;
+
+  r.expect('{');
+  for (bool first = true; r.next_element(first, '}'); )
+  {
+    r.read_key(key);
+
+    if (key == "format") next = SECTION_FORMAT;
+    else if (key == "templates") next = SECTION_TEMPLATES;
+    else if (key == "entities") next = SECTION_ENTITIES;
+    else if (key == "connections") next = SECTION_CONNECTIONS;
+    else if (key == "events") next = SECTION_EVENTS;
+    else
+    {
+      r.skip_value();
+      continue;
+    }
+
+    if (next < section || (next != SECTION_FORMAT && !has_format))
+    {
+      throw "sections out of order";
+    }
+    section = next;
+
+    switch (section)
+    {
+      case SECTION_FORMAT:
+        r.read_string(str);
+        if (str != "yinspire.c") throw "unrecognized data format";
+        has_format = true;
+        break;
+
+      case SECTION_TEMPLATES:
+        r.expect('{');
+        for (bool f1 = true; r.next_element(f1, '}'); )
+        {
+          r.read_key(name);
+          r.expect('[');
+          r.read_string(str);
+          r.expect(',');
+          jsonValue *data = r.read_value();
+          r.expect(']');
+          handler->on_template(name, str, data->asHash());
+          data->ref_decr();
+        }
+        break;
+
+      case SECTION_ENTITIES:
+        r.expect('[');
+        for (bool f1 = true; r.next_element(f1, ']'); )
+        {
+          r.expect('[');
+          r.read_string(name);
+          r.expect(',');
+          r.read_string(str);
+          if (r.peek() == ',')
+          {
+            r.expect(',');
+            jsonValue *data = r.read_value();
+            r.expect(']');
+            handler->on_entity(name, str, data->asHash());
+            data->ref_decr();
+          }
+          else
+          {
+            r.expect(']');
+            handler->on_entity(name, str, NULL);
+          }
+        }
+        break;
+
+      case SECTION_CONNECTIONS:
+        r.expect('[');
+        for (bool f1 = true; r.next_element(f1, ']'); )
+        {
+          r.expect('[');
+          r.read_string(name);
+          handler->on_connections(name);
+          for (bool f2 = false; r.next_element(f2, ']'); )
+          {
+            r.read_string(str);
+            handler->on_connection(str);
+          }
+        }
+        break;
+
+      case SECTION_EVENTS:
+        r.expect('{');
+        for (bool f1 = true; r.next_element(f1, '}'); )
+        {
+          r.read_key(name);
+          handler->on_events(name);
+          r.expect('[');
+          for (bool f2 = true; r.next_element(f2, ']'); )
+          {
+            handler->on_event(r.read_number(), INFINITY);
+          }
+        }
+        break;
+    }
+  }
+  r.expect_end();
+
+  if (!has_format)
+  {
+    throw "unrecognized data format";
+  }
+}
+
+void
+NetStreamParser::parse_file(const char *filename, NetStreamHandler *handler)
+{
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL)
+  {
+    throw "cannot open file";
+  }
+
+  try
+  {
+    jsonReader r(f);
+    parse(r, handler);
+  }
+  catch (...)
+  {
+    fclose(f);
+    throw;
+  }
+  fclose(f);
+}
@@ -0,0 +1,64 @@
+#ifndef __YINSPIRE__NET_STREAM__
+#define __YINSPIRE__NET_STREAM__
+
+#include "types.h"
+#include "json/json.h"
+#include <string>
+
+class jsonReader;
+
+/*
+ * Receives the contents of a "yinspire.c" net one item at a time from
+ * a NetStreamParser.
+ */
+class NetStreamHandler
+{
+  public:
+
+    virtual ~NetStreamHandler() {}
+
+    /*
+     * +data+ is only valid during the call (ref_incr it to keep it).
+     */
+    virtual void on_template(const std::string &name, const std::string &type, jsonHash *data) = 0;
+
+    /*
+     * +data+ contains the properties given for this entity only (or
+     * NULL). They override those of the template.
+     */
+    virtual void on_entity(const std::string &id, const std::string &template_name, jsonHash *data) = 0;
+
+    /*
+     * Called once per connection list with it's source entity. The
+     * targets follow with on_connection().
+     */
+    virtual void on_connections(const std::string &from) = 0;
+    virtual void on_connection(const std::string &to) = 0;
+
+    /*
+     * Called once per entity in the "events" section, followed by one
+     * on_event() per event. +weight+ is Infinity unless the format
+     * allows to give it.
+     */
+    virtual void on_events(const std::string &id) = 0;
+    virtual void on_event(simtime at, real weight) = 0;
+};
+
+/*
+ * Parses a net in the "yinspire.c" JSON format without building a
+ * DOM, so memory usage is independent of the size of the file (except
+ * for what the handler keeps).
+ *
+ * Unlike the DOM based loader, the sections have to appear in the
+ * order "format", "templates", "entities", "connections" and
+ * "events" (every section is optional). Unknown keys are skipped.
+ */
+class NetStreamParser
+{
+  public:
+
+    static void parse_file(const char *filename, NetStreamHandler *handler);
+    static void parse(jsonReader &reader, NetStreamHandler *handler);
+};
+
+#endif
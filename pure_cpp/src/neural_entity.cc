@@ -5,9 +5,24 @@
 NeuralEntity::NeuralEntity()
 {
   this->simulator = NULL;
-  this->id = NULL;
+  this->entity_index = ENTITY_NO_INDEX;
   this->schedule_index = 0;
   this->schedule_at = INFINITY;
+  this->connections_pending = false;
+  this->recorded = true;
+  this->schedule_stepping_list_prev = NULL;
+  this->schedule_stepping_list_next = NULL;
+  this->schedule_stepping_list_internal_next = NULL;
+}
+
+NeuralEntity::NeuralEntity(const NeuralEntity &other)
+{
+  this->simulator = other.simulator;
+  this->entity_index = ENTITY_NO_INDEX;
+  this->schedule_index = 0;
+  this->schedule_at = INFINITY;
+  this->connections_pending = false;
+  this->recorded = other.recorded;
   this->schedule_stepping_list_prev = NULL;
   this->schedule_stepping_list_next = NULL;
   this->schedule_stepping_list_internal_next = NULL;
@@ -17,17 +32,46 @@ NeuralEntity::~NeuralEntity()
 {
 }
 
+NeuralEntity *
+NeuralEntity::clone() const
+{
+  return NULL;
+}
+
 
 void
 NeuralEntity::load(jsonHash *data)
 {
 }
 
+void *
+NeuralEntity::shared_params_create(jsonHash *data)
+{
+  return NULL;
+}
+
+void
+NeuralEntity::shared_params_release(void *params)
+{
+}
+
+void
+NeuralEntity::load_shared(jsonHash *data, void *params)
+{
+  load(data);
+}
+
 void
 NeuralEntity::dump(jsonHash *into)
 {
 }
 
+const char *
+NeuralEntity::entity_type() const
+{
+  return NULL;
+}
+
 static void
 iter_disconnect(NeuralEntity *self, NeuralEntity *conn)
 {
@@ -195,14 +239,15 @@ NeuralEntity::get_simulator() const
   return this->simulator; 
 }
 
-void
-NeuralEntity::set_id(const char *id)
+const char *
+NeuralEntity::get_id() const
 {
-  this->id = id;
+  if (this->entity_index == ENTITY_NO_INDEX) return NULL;
+  return this->simulator->entities.name(this->entity_index);
 }
 
-const char *
-NeuralEntity::get_id() const
+uint
+NeuralEntity::get_index() const
 {
-  return this->id;
+  return this->entity_index;
 }
@@ -2,34 +2,24 @@
 #define __YINSPIRE__NEURAL_ENTITY__
 
 #include "types.h"
+#include "stimulus.h"
 #include "memory_allocator.h"
 #include "algo/binary_heap.h"
 #include "json/json.h"
+#include "entity_table.h"
 
 class Simulator; // forward declaration
 
-/*
- * The data structure used for storing a fire impluse or any other form
- * of stimulation.
- */
-struct Stimulus
-{
-  simtime at;
-  real weight;
-
-  inline static bool
-    less(const Stimulus &a, const Stimulus &b)
-    {
-      return (a.at < b.at); 
-    }
-};
-
 /*
  * The NeuralEntity is the base class of all entities in a neural net,
  * i.e. Neurons and Synapses. 
  */
 class NeuralEntity
 {
+    friend class Simulator;
+    friend class NetCompiler;
+    friend class NetDumper;
+
   protected: 
 
     /*
@@ -43,14 +33,13 @@ class NeuralEntity
 
     /*
      * Each NeuralEntity has an +id+ associated which uniquely
-     * identifies itself within a Simulator instance. This +id+ is
-     * assigned by the Simulator and should not be changed by the
-     * NeuralEntity itself.
+     * identifies itself within a Simulator instance. It's interned by
+     * the Simulator, which assigns the entity the (dense) index of
+     * the id, +entity_index+. The id itself is looked up by get_id().
      *
-     * The reference is NOT owned by the NeuralEntity. It's the
-     * responsibility of the Simulator to allocate and free the memory! 
+     * Anonymous entities have index ENTITY_NO_INDEX.
      */
-    const char *id;
+    uint entity_index;
 
     /*
      * Index of this entity in the entity priority queue managed by the
@@ -65,6 +54,21 @@ class NeuralEntity
      */
     simtime schedule_at;
 
+    /*
+     * True if the entity belongs to a lazily loaded net and it's
+     * outgoing connections have not been created yet. Entities have
+     * to call Simulator::entity_connect_pending before they use their
+     * outgoing connections.
+     */
+    bool connections_pending;
+
+    /*
+     * False if the fire events of the entity are not recorded (see
+     * Simulator::record_ids and record_types). Set by the Simulator
+     * when the entity is created; copies keep it.
+     */
+    bool recorded;
+
     /*
      * If stepped scheduling is used, points to the previous/next
      * entity in the schedule list.
@@ -102,11 +106,25 @@ class NeuralEntity
      */
     NeuralEntity();
 
+    /*
+     * Copy constructor (see clone). Copies the state but not the
+     * identity: the copy has no id, is not scheduled and has no
+     * stimuli.
+     */
+    NeuralEntity(const NeuralEntity &other);
+
     /*
      * Destructor
      */
     virtual ~NeuralEntity();
 
+    /*
+     * Return an unconnected copy of this entity, or NULL if the entity
+     * type does not support cloning. Used to create the entities of a
+     * template from a loaded prototype without loading each of them.
+     */
+    virtual NeuralEntity *clone() const;
+
     /*
      * Load the internal state of a NeuralEntity
      * from +data+.
@@ -116,6 +134,23 @@ class NeuralEntity
      */
     virtual void load(jsonHash *data); 
 
+    /*
+     * Entities loaded from the same template can share their
+     * immutable parameters instead of each keeping a copy.
+     *
+     * +shared_params_create+ returns a new parameter block read from
+     * +data+ (or NULL if the entity type has no such parameters).
+     * The caller holds a reference to it and gives it up with
+     * +shared_params_release+. Entities using the block keep their own
+     * references, so it is freed with the last of them.
+     *
+     * +load_shared+ works like +load+ but takes the immutable
+     * parameters from +params+ (if not NULL).
+     */
+    virtual void *shared_params_create(jsonHash *data);
+    virtual void shared_params_release(void *params);
+    virtual void load_shared(jsonHash *data, void *params);
+
     /*
      * Dump the internal state of a NeuralEntity
      * and return it. Internal state does not contain 
@@ -124,6 +159,12 @@ class NeuralEntity
      */ 
     virtual void dump(jsonHash *into);
 
+    /*
+     * The name of the type of the entity, as registered with
+     * Simulator::entity_register_type, or NULL if it cannot be dumped.
+     */
+    virtual const char *entity_type() const;
+
     /*
      * Connect +self+ with +target+.
      */
@@ -136,9 +177,10 @@ class NeuralEntity
 
     /*
      * Disconnect from all connections. Uses +each_connection+ and
-     * +disconnect+.
+     * +disconnect+. Subclasses overwrite it to disconnect incoming
+     * connections as well.
      */
-    void disconnect_all();
+    virtual void disconnect_all();
 
     /*
      * Calls the iterator function for each outgoing connection.
@@ -179,9 +221,9 @@ class NeuralEntity
      * Attribute accessor functions
      */
     void        set_simulator(Simulator *simulator);
-    void        set_id(const char *id);
     Simulator  *get_simulator() const;
     const char *get_id() const;
+    uint        get_index() const;
     inline simtime get_schedule_at() const { return this->schedule_at; }
 
   protected:
@@ -8,15 +8,28 @@ Neuron::Neuron()
 {
   this->first_pre_synapse = NULL;
   this->first_post_synapse = NULL;
-  this->abs_refr_duration = 0.0;
   this->last_spike_time = -INFINITY; 
   this->last_fire_time = -INFINITY; 
   this->hebb = false;
 }
 
+Neuron::Neuron(const Neuron &other) : NeuralEntity(other)
+{
+  this->first_pre_synapse = NULL;
+  this->first_post_synapse = NULL;
+  this->last_spike_time = other.last_spike_time;
+  this->last_fire_time = other.last_fire_time;
+  this->hebb = other.hebb;
+}
+
 void
 Neuron::dump(jsonHash *into)
 {
+  super::dump(into);
+
+  into->set("last_spike_time", this->last_spike_time);
+  into->set("last_fire_time", this->last_fire_time);
+  into->set("hebb", this->hebb);
 }
 
 void
@@ -24,7 +37,6 @@ Neuron::load(jsonHash *data)
 {
   super::load(data);
 
-  this->abs_refr_duration = data->get_number("abs_refr_duration", 0.0);
   this->last_spike_time = data->get_number("last_spike_time", -INFINITY);
   this->last_fire_time = data->get_number("last_fire_time", -INFINITY);
   this->hebb = data->get_bool("hebb", false);
@@ -56,16 +68,22 @@ Neuron::connect(NeuralEntity *target)
 {
   Synapse *syn = dynamic_cast<Synapse*>(target);
 
-  if (syn->pre_neuron != NULL || syn->next_post_synapse != NULL)
+  if (syn == NULL)
+    throw "Neuron can only be connected to a Synapse";
+
+  if (syn->pre_neuron != NULL)
     throw "Synapse already connected";
 
+  syn->prev_post_synapse = NULL;
   syn->next_post_synapse = this->first_post_synapse;
+  if (this->first_post_synapse != NULL)
+    this->first_post_synapse->prev_post_synapse = syn;
   this->first_post_synapse = syn;
   syn->pre_neuron = this;
 }
 
 /*
- * O(n)
+ * O(1)
  */
 void
 Neuron::disconnect(NeuralEntity *target)
@@ -75,62 +93,80 @@ Neuron::disconnect(NeuralEntity *target)
   if (syn->pre_neuron != this)
     throw "Synapse not connected to this Neuron";
 
-  /*
-   * Find the synapse in the linked list that precedes +syn+.
-   */
-  Synapse *prev = NULL;
-  Synapse *curr = this->first_post_synapse;
-
-  while (true)
-  {
-    if (curr == NULL) break;
-    if (curr == syn) break; 
-    prev = curr;
-    curr = curr->next_post_synapse;
-  }
-
-  if (curr != syn)
-    throw "Synapse not in post synapse list";
-
   /*
    * Remove syn from linked list
    */
-  if (prev == NULL)
+  if (syn->prev_post_synapse == NULL)
   {
-    /*
-     * syn is the last synapse in the post synapse list.
-     */
     assert(this->first_post_synapse == syn);
-    this->first_post_synapse = NULL; 
+    this->first_post_synapse = syn->next_post_synapse;
   }
   else
   {
-    prev->next_post_synapse = syn->next_post_synapse;
+    syn->prev_post_synapse->next_post_synapse = syn->next_post_synapse;
+  }
+
+  if (syn->next_post_synapse != NULL)
+  {
+    syn->next_post_synapse->prev_post_synapse = syn->prev_post_synapse;
+  }
+
+  if (this->simulator != NULL && this->simulator->fire_next_post_synapse == syn)
+  {
+    this->simulator->fire_next_post_synapse = syn->next_post_synapse;
   }
 
   syn->pre_neuron = NULL;
+  syn->prev_post_synapse = NULL;
   syn->next_post_synapse = NULL;
 }
 
+/*
+ * Disconnect all pre and post synapses.
+ */
+void
+Neuron::disconnect_all()
+{
+  while (this->first_post_synapse != NULL)
+  {
+    disconnect(this->first_post_synapse);
+  }
+  while (this->first_pre_synapse != NULL)
+  {
+    this->first_pre_synapse->disconnect(this);
+  }
+}
+
 /*
  * NOTE: The stimulation weight is 0.0 below
  * as the synapse will add it's weight to the
  * preceding neurons.
+ *
+ * Synapses that are disconnected while we iterate are skipped (see
+ * Simulator::fire_next_post_synapse).
  */
 void
 Neuron::fire_synapses(simtime at)
 {
+  if (this->connections_pending) this->simulator->entity_connect_pending(this);
+
+  Simulator *sim = this->simulator;
+  Synapse *syn;
+
   if (this->hebb) 
   {
-    for (Synapse *syn = this->first_pre_synapse; syn != NULL;
-        syn = syn->next_pre_synapse)
+    sim->fire_next_pre_synapse = this->first_pre_synapse;
+    while ((syn = sim->fire_next_pre_synapse) != NULL)
     {
+      sim->fire_next_pre_synapse = syn->next_pre_synapse;
       syn->stimulate(at, 0.0, this);
     }
   }
-  for (Synapse *syn = this->first_post_synapse; syn != NULL;
-      syn = syn->next_post_synapse)
+
+  sim->fire_next_post_synapse = this->first_post_synapse;
+  while ((syn = sim->fire_next_post_synapse) != NULL)
   {
+    sim->fire_next_post_synapse = syn->next_post_synapse;
     syn->stimulate(at, 0.0, this);
   }
 }
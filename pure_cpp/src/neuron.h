@@ -11,6 +11,8 @@ class Synapse; // forward declaration
 class Neuron : public NeuralEntity
 {
     friend class Synapse;
+    friend class NetCompiler;
+    friend class Simulator;
     typedef NeuralEntity super; 
 
   protected:
@@ -21,11 +23,6 @@ class Neuron : public NeuralEntity
     Synapse *first_pre_synapse;
     Synapse *first_post_synapse;
 
-    /*
-     * Duration of the absolute refraction period.
-     */
-    simtime abs_refr_duration; 
-
     /*
      * Last spike time
      */
@@ -50,6 +47,11 @@ class Neuron : public NeuralEntity
      */
     Neuron();
 
+    /*
+     * Copy constructor. The copy is unconnected.
+     */
+    Neuron(const Neuron &other);
+
   public:
 
     virtual void dump(jsonHash *into);
@@ -60,6 +62,7 @@ class Neuron : public NeuralEntity
     virtual void disconnect(NeuralEntity *target);
     virtual void each_connection(
       void (*yield)(NeuralEntity *self, NeuralEntity *conn));
+    virtual void disconnect_all();
 
   protected:
 
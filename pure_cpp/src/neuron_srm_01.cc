@@ -4,48 +4,175 @@
 
 // formerly known as KernelbasedLIF
 
+void
+Neuron_SRM_01_Params::load(jsonHash *data)
+{
+  this->abs_refr_duration = data->get_number("abs_refr_duration", 0.0);
+  this->tau_m = data->get_number("tau_m", 0.0);
+  this->tau_ref = data->get_number("tau_ref", 0.0);
+  this->ref_weight = data->get_number("ref_weight", 0.0);
+  this->const_threshold = data->get_number("const_threshold", 0.0);
+}
+
+Neuron_SRM_01_OwnParams::Neuron_SRM_01_OwnParams()
+{
+  this->params.abs_refr_duration = 0.0;
+  this->params.tau_m = 0.0;
+  this->params.tau_ref = 0.0;
+  this->params.ref_weight = 0.0;
+  this->params.const_threshold = 0.0;
+}
+
+/*
+ * Used until the parameters are loaded. It's reference count never
+ * drops to zero, so it is never released.
+ *
+ * Reference counts are changed atomically, as neurons are cloned on
+ * several threads by Simulator::load_json_parallel.
+ */
+Neuron_SRM_01_SharedParams::Block Neuron_SRM_01_SharedParams::default_block = {{0.0, 0.0, 0.0, 0.0, 0.0}, 1};
+
+Neuron_SRM_01_SharedParams::Neuron_SRM_01_SharedParams()
+{
+  this->block = &default_block;
+  __sync_add_and_fetch(&this->block->ref_count, 1);
+}
+
+Neuron_SRM_01_SharedParams::Neuron_SRM_01_SharedParams(const Neuron_SRM_01_SharedParams &other)
+{
+  this->block = other.block;
+  __sync_add_and_fetch(&this->block->ref_count, 1);
+}
+
+Neuron_SRM_01_SharedParams::~Neuron_SRM_01_SharedParams()
+{
+  release(this->block);
+}
+
+void
+Neuron_SRM_01_SharedParams::load(jsonHash *data)
+{
+  void *block = create(data);
+  release(this->block);
+  this->block = (Block*) block;
+}
+
+void
+Neuron_SRM_01_SharedParams::share(jsonHash *data, void *block)
+{
+  if (block == NULL)
+  {
+    load(data);
+    return;
+  }
+
+  __sync_add_and_fetch(&((Block*) block)->ref_count, 1);
+  release(this->block);
+  this->block = (Block*) block;
+}
+
+void *
+Neuron_SRM_01_SharedParams::create(jsonHash *data)
+{
+  Block *block = new Block;
+  block->load(data);
+  block->ref_count = 1;
+  return block;
+}
+
+void
+Neuron_SRM_01_SharedParams::release(void *block)
+{
+  if (__sync_sub_and_fetch(&((Block*) block)->ref_count, 1) == 0) delete (Block*) block;
+}
 
-Neuron_SRM_01::Neuron_SRM_01()
+template <class Storage>
+Neuron_SRM_01_T<Storage>::Neuron_SRM_01_T()
 {
-  this->tau_m = 0.0;
-  this->tau_ref = 0.0;
-  this->ref_weight = 0.0;
   this->mem_pot = 0.0;
-  this->const_threshold = 0.0;
 }
 
+template <class Storage>
+NeuralEntity *
+Neuron_SRM_01_T<Storage>::clone() const
+{
+  return new Neuron_SRM_01_T<Storage>(*this);
+}
+
+template <class Storage>
 void
-Neuron_SRM_01::dump(jsonHash *into)
+Neuron_SRM_01_T<Storage>::dump(jsonHash *into)
+{
+  super::dump(into);
+
+  const Neuron_SRM_01_Params &p = this->params.get();
+  into->set("abs_refr_duration", p.abs_refr_duration);
+  into->set("tau_m", p.tau_m);
+  into->set("tau_ref", p.tau_ref);
+  into->set("ref_weight", p.ref_weight);
+  into->set("const_threshold", p.const_threshold);
+  into->set("mem_pot", this->mem_pot);
+}
+
+template <class Storage>
+const char *
+Neuron_SRM_01_T<Storage>::entity_type() const
 {
+  return "Neuron_SRM_01";
 }
 
+template <class Storage>
 void
-Neuron_SRM_01::load(jsonHash *data)
+Neuron_SRM_01_T<Storage>::load(jsonHash *data)
 {
   super::load(data);
 
-  this->tau_m = data->get_number("tau_m", 0.0);
-  this->tau_ref = data->get_number("tau_ref", 0.0);
-  this->ref_weight = data->get_number("ref_weight", 0.0);
+  this->params.load(data);
   this->mem_pot = data->get_number("mem_pot", 0.0);
-  this->const_threshold = data->get_number("const_threshold", 0.0);
 }
 
+template <class Storage>
+void *
+Neuron_SRM_01_T<Storage>::shared_params_create(jsonHash *data)
+{
+  return Storage::create(data);
+}
+
+template <class Storage>
+void
+Neuron_SRM_01_T<Storage>::shared_params_release(void *params)
+{
+  Storage::release(params);
+}
+
+template <class Storage>
 void
-Neuron_SRM_01::stimulate(simtime at, real weight, NeuralEntity *source)
+Neuron_SRM_01_T<Storage>::load_shared(jsonHash *data, void *params)
 {
-  if (at >= this->last_fire_time + this->abs_refr_duration)
+  super::load(data);
+
+  this->params.share(data, params);
+  this->mem_pot = data->get_number("mem_pot", 0.0);
+}
+
+template <class Storage>
+void
+Neuron_SRM_01_T<Storage>::stimulate(simtime at, real weight, NeuralEntity *source)
+{
+  if (at >= this->last_fire_time + this->params.get().abs_refr_duration)
   {
     ++this->simulator->stat_event_counter;
     super::stimulate(at, weight, source);
   }
 }
 
+template <class Storage>
 void
-Neuron_SRM_01::process(simtime at)
+Neuron_SRM_01_T<Storage>::process(simtime at)
 {
+  const Neuron_SRM_01_Params &p = this->params.get();
   real weight = stimuli_sum(at);
-  const real delta = at - this->last_fire_time - this->abs_refr_duration;
+  const real delta = at - this->last_fire_time - p.abs_refr_duration;
 
   if (delta < 0.0) return;
 
@@ -53,25 +180,29 @@ Neuron_SRM_01::process(simtime at)
    * Calculate new membrane potential
    */
 
-  this->mem_pot = weight + this->mem_pot * real_exp( -(at - this->last_spike_time)/this->tau_m );
+  this->mem_pot = weight + this->mem_pot * real_exp( -(at - this->last_spike_time)/p.tau_m );
   this->last_spike_time = at;
 
   /*
    * Calculate dynamic threshold
    */
-  const real dynamic_threshold = this->ref_weight * real_exp(-delta/this->tau_ref);
+  const real dynamic_threshold = p.ref_weight * real_exp(-delta/p.tau_ref);
 
-  if (this->mem_pot >= this->const_threshold + dynamic_threshold)
+  if (this->mem_pot >= p.const_threshold + dynamic_threshold)
   {
     fire(at);
   }
 }
 
+template <class Storage>
 void
-Neuron_SRM_01::fire(simtime at)
+Neuron_SRM_01_T<Storage>::fire(simtime at)
 {
   this->simulator->stat_record_fire_event(at, this);
   this->mem_pot = 0.0;
   this->last_fire_time = at;
   fire_synapses(at);
 }
+
+template class Neuron_SRM_01_T<Neuron_SRM_01_OwnParams>;
+template class Neuron_SRM_01_T<Neuron_SRM_01_SharedParams>;
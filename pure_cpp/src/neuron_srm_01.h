@@ -3,26 +3,126 @@
 
 #include "neuron.h"
 
-class Neuron_SRM_01 : public Neuron 
+/*
+ * The immutable parameters of a Neuron_SRM_01.
+ */
+struct Neuron_SRM_01_Params
 {
-    typedef Neuron super; 
+  /*
+   * Duration of the absolute refraction period.
+   */
+  simtime abs_refr_duration;
+
+  real tau_m;
+  real tau_ref;
+  real ref_weight;
+  real const_threshold;
+
+  void load(jsonHash *data);
+};
+
+/*
+ * Parameter storage of a Neuron_SRM_01 which keeps the parameters
+ * inline in every neuron (the default).
+ */
+class Neuron_SRM_01_OwnParams
+{
+    Neuron_SRM_01_Params params;
+
+  public:
+
+    Neuron_SRM_01_OwnParams();
+
+    inline const Neuron_SRM_01_Params &get() const { return this->params; }
+
+    inline void load(jsonHash *data) { this->params.load(data); }
+
+    /*
+     * Parameters cannot be shared, so they are always loaded.
+     */
+    inline void share(jsonHash *data, void *block) { load(data); }
+
+    static inline void *create(jsonHash *data) { return NULL; }
+    static inline void release(void *block) {}
+};
+
+/*
+ * Parameter storage of a Neuron_SRM_01 which points to a reference
+ * counted block, shared by all neurons of a template (see
+ * NeuralEntity::load_shared).
+ */
+class Neuron_SRM_01_SharedParams
+{
+    struct Block : public Neuron_SRM_01_Params
+    {
+      uint ref_count;
+    };
+
+    Block *block;
+
+    static Block default_block;
+
+  public:
+
+    Neuron_SRM_01_SharedParams();
+    Neuron_SRM_01_SharedParams(const Neuron_SRM_01_SharedParams &other);
+    ~Neuron_SRM_01_SharedParams();
+
+    inline const Neuron_SRM_01_Params &get() const { return *this->block; }
+
+    /*
+     * Load the parameters into a block of this neuron only.
+     */
+    void load(jsonHash *data);
+
+    /*
+     * Use +block+ (from +create+), or load the parameters from +data+
+     * if it is NULL.
+     */
+    void share(jsonHash *data, void *block);
+
+    /*
+     * Return a new block with one reference, which the caller
+     * releases once it no longer shares it.
+     */
+    static void *create(jsonHash *data);
+    static void release(void *block);
+
+  private:
+
+    Neuron_SRM_01_SharedParams &operator=(const Neuron_SRM_01_SharedParams &other);
+};
+
+/*
+ * The neuron model. +Storage+ determines where the immutable
+ * parameters are kept, see Neuron_SRM_01 and Neuron_SRM_01_Shared.
+ */
+template <class Storage>
+class Neuron_SRM_01_T : public Neuron
+{
+    friend class NetCompiler;
+    typedef Neuron super;
 
   protected:
 
-    real tau_m;
-    real tau_ref;
-    real ref_weight;
+    Storage params;
+
     real mem_pot;
-    real const_threshold;
 
   public:
 
-    Neuron_SRM_01();
+    Neuron_SRM_01_T();
 
   public:
 
+    virtual NeuralEntity *clone() const;
+
     virtual void dump(jsonHash *into);
+    virtual const char *entity_type() const;
     virtual void load(jsonHash *data);
+    virtual void *shared_params_create(jsonHash *data);
+    virtual void shared_params_release(void *params);
+    virtual void load_shared(jsonHash *data, void *params);
 
     virtual void stimulate(simtime at, real weight, NeuralEntity *source);
     virtual void process(simtime at);
@@ -33,4 +133,13 @@ class Neuron_SRM_01 : public Neuron
 
 };
 
+typedef Neuron_SRM_01_T<Neuron_SRM_01_OwnParams> Neuron_SRM_01;
+
+/*
+ * Allocated instead of a Neuron_SRM_01 if the Simulator loads with
+ * +load_shared_params+. Costs an indirection for each access of a
+ * parameter.
+ */
+typedef Neuron_SRM_01_T<Neuron_SRM_01_SharedParams> Neuron_SRM_01_Shared;
+
 #endif
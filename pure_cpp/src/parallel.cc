@@ -0,0 +1,57 @@
+#include "parallel.h"
+#include <pthread.h>
+#include <vector>
+
+struct parallel_range
+{
+  void (*yield)(void *data, uint from, uint to);
+  void *data;
+  uint from;
+  uint to;
+};
+
+static void *
+parallel_run(void *arg)
+{
+  parallel_range *r = (parallel_range*) arg;
+  r->yield(r->data, r->from, r->to);
+  return NULL;
+}
+
+void
+parallel_for(uint n, uint threads, void (*yield)(void *data, uint from, uint to), void *data)
+{
+  if (threads > n) threads = n;
+  if (threads <= 1)
+  {
+    if (n > 0) yield(data, 0, n);
+    return;
+  }
+
+  std::vector<parallel_range> ranges(threads);
+  std::vector<pthread_t> tids(threads);
+  std::vector<bool> started(threads, false);
+
+  for (uint i = 0; i < threads; i++)
+  {
+    ranges[i].yield = yield;
+    ranges[i].data = data;
+    ranges[i].from = (uint)(((unsigned long long)n * i) / threads);
+    ranges[i].to = (uint)(((unsigned long long)n * (i+1)) / threads);
+  }
+
+  for (uint i = 1; i < threads; i++)
+  {
+    started[i] = (pthread_create(&tids[i], NULL, parallel_run, &ranges[i]) == 0);
+  }
+
+  parallel_run(&ranges[0]);
+
+  for (uint i = 1; i < threads; i++)
+  {
+    if (started[i])
+      pthread_join(tids[i], NULL);
+    else
+      parallel_run(&ranges[i]); // run it on the calling thread instead
+  }
+}
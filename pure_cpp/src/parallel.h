@@ -0,0 +1,16 @@
+#ifndef __YINSPIRE__PARALLEL__
+#define __YINSPIRE__PARALLEL__
+
+#include "types.h"
+
+/*
+ * Splits [0, n) into +threads+ contiguous ranges and calls
+ * yield(data, from, to) for each of them on it's own thread. The
+ * calling thread processes the first range itself. Returns when all
+ * ranges are done.
+ *
+ * +yield+ must not throw.
+ */
+void parallel_for(uint n, uint threads, void (*yield)(void *data, uint from, uint to), void *data);
+
+#endif
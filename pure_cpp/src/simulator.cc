@@ -1,7 +1,16 @@
 #include <math.h>
 #include <string>
+#include <typeinfo>
 #include "simulator.h"
-#include "json/json_parser.h"
+#include "synapse.h"
+#include "neuron.h"
+#include "net_file.h"
+#include "spike_file.h"
+#include "fire_log.h"
+#include "spike_stats.h"
+#include "net_stream.h"
+#include "json/json_doc.h"
+#include "parallel.h"
 
 Simulator::Simulator()
 {
@@ -12,94 +21,1564 @@ Simulator::Simulator()
   this->stimuli_tolerance = 0.0;
   this->stat_event_counter = 0;
   this->stat_fire_counter = 0;
+  this->running = false;
+  this->fire_next_pre_synapse = NULL;
+  this->fire_next_post_synapse = NULL;
+  this->load_shared_params = false;
+  this->load_streaming = false;
+  this->load_pipelined = false;
+  memset(&this->load_times, 0, sizeof(this->load_times));
+  this->load_threads = 1;
+  this->load_time_offset = 0.0;
+  this->load_lazy = false;
+  this->lazy_net = NULL;
+  this->lazy_loading = false;
+  this->load_deferred_events = false;
+  this->fire_log = NULL;
+  this->spike_stats = NULL;
+  this->fire_count_windows = 0;
+  this->fire_count_window = INFINITY;
+}
+
+Simulator::~Simulator()
+{
+  while (!this->input_pq.empty())
+  {
+    delete this->input_pq.top();
+    this->input_pq.pop();
+  }
+  for (uint i = 0; i < this->input_files.size(); i++)
+  {
+    delete this->input_files[i];
+  }
+  if (this->lazy_net != NULL)
+  {
+    for (uint t = 0; t < this->lazy_net->templates.size(); t++)
+    {
+      template_release(this->lazy_net->templates[t]);
+    }
+    delete this->lazy_net;
+  }
+  delete this->fire_log;
+  delete this->spike_stats;
+}
+
+void
+Simulator::entity_register_type(const char *type, entity_factory_t factory,
+    entity_factory_t shared_factory)
+{
+  this->types[type] = factory;
+  if (shared_factory != NULL) this->shared_types[type] = shared_factory;
+}
+
+NeuralEntity*
+Simulator::entity_allocate(const char* type, bool shared)
+{
+  entity_factory_t factory = this->types[type];
+  if (factory == NULL) throw "unknown entity type";
+  if (shared && this->shared_types.count(type) > 0) factory = this->shared_types[type];
+
+  NeuralEntity *entity = factory();
+  entity->recorded = (this->record_types.empty() || this->record_types.count(type) > 0);
+  return entity;
+}
+
+NeuralEntity*
+Simulator::entity_create(const char *type, const char *id)
+{
+  NeuralEntity *entity = entity_allocate(type);
+
+  entity->set_simulator(this);
+  entity_register(entity, id);
+
+  return entity;
 }
 
 void
-Simulator::entity_register_type(const char *type, entity_factory_t factory)
+Simulator::entity_register(NeuralEntity *entity, const char *id)
+{
+  if (id != NULL)
+  {
+    try
+    {
+      const size_t len = strlen(id);
+      if (this->lazy_net != NULL && entity_is_lazy(this->entities.index(id, len)))
+      {
+        throw "duplicate entity id";
+      }
+      entity->entity_index = this->entities.insert(id, len, entity);
+    }
+    catch (...)
+    {
+      delete entity;
+      throw;
+    }
+  }
+  record_select(entity, id);
+}
+
+void
+Simulator::entity_destroy(NeuralEntity *entity)
+{
+  Neuron *neuron = dynamic_cast<Neuron*>(entity);
+  if (neuron != NULL)
+  {
+    std::vector<Synapse*> anonymous;
+    for (Synapse *syn = neuron->first_post_synapse; syn != NULL; syn = syn->next_post_synapse)
+    {
+      if (syn->entity_index == ENTITY_NO_INDEX) anonymous.push_back(syn);
+    }
+    for (Synapse *syn = neuron->first_pre_synapse; syn != NULL; syn = syn->next_pre_synapse)
+    {
+      // a synapse looping back is in both lists
+      if (syn->entity_index == ENTITY_NO_INDEX && syn->pre_neuron != neuron) anonymous.push_back(syn);
+    }
+    for (uint i = 0; i < anonymous.size(); i++)
+    {
+      entity_destroy(anonymous[i]);
+    }
+  }
+
+  entity->disconnect_all();
+
+  if (entity->schedule_index != 0)
+  {
+    this->schedule_pq.remove(entity->schedule_index);
+  }
+  entity->schedule_at = INFINITY;
+  entity->schedule_disable_stepping();
+
+  if (entity->entity_index != ENTITY_NO_INDEX)
+  {
+    this->entities.remove(entity->entity_index);
+  }
+
+  this->destroyed_entities.push_back(entity);
+  if (!this->running) release_destroyed_entities();
+}
+
+void
+Simulator::release_destroyed_entities()
+{
+  for (uint i = 0; i < this->destroyed_entities.size(); i++)
+  {
+    delete this->destroyed_entities[i];
+  }
+  this->destroyed_entities.clear();
+}
+
+Synapse*
+Simulator::synapse_create(Neuron *pre, Neuron *post, real weight, simtime delay)
+{
+  Synapse *syn = new Synapse();
+  syn->set_simulator(this);
+  syn->set_weight(weight);
+  syn->set_delay(delay);
+  pre->connect(syn);
+  syn->connect(post);
+  return syn;
+}
+
+void
+Simulator::entity_load(NeuralEntity *entity, EntityTemplate &t)
+{
+  if (this->load_shared_params)
+  {
+    if (t.shared_params == NULL)
+    {
+      t.shared_params = entity->shared_params_create(t.data);
+    }
+    entity->load_shared(t.data, t.shared_params);
+  }
+  else
+  {
+    entity->load(t.data);
+  }
+}
+
+void
+Simulator::template_init(EntityTemplate &t, const std::string &name, const std::string &type, jsonHash *data)
+{
+  t.name = name;
+  t.type = type;
+  t.data = data;
+  t.prototype = NULL;
+  t.shared_params = NULL;
+  t.lazy_template = ENTITY_NO_INDEX;
+  data->ref_incr();
+}
+
+void
+Simulator::template_release(EntityTemplate &t)
+{
+  // the entities of the template keep their own references
+  if (t.shared_params != NULL) t.prototype->shared_params_release(t.shared_params);
+  t.shared_params = NULL;
+  delete t.prototype;
+  t.prototype = NULL;
+  if (t.data != NULL) t.data->ref_decr();
+  t.data = NULL;
+}
+
+NeuralEntity*
+Simulator::template_prototype(EntityTemplate &t)
+{
+  if (t.prototype == NULL)
+  {
+    t.prototype = entity_allocate(t.type.c_str(), this->load_shared_params);
+    t.prototype->set_simulator(this);
+    entity_load(t.prototype, t);
+  }
+  return t.prototype;
+}
+
+NeuralEntity*
+Simulator::template_instantiate(EntityTemplate &t)
+{
+  template_prototype(t);
+
+  NeuralEntity *entity = t.prototype->clone();
+  if (entity != NULL && typeid(*entity) != typeid(*t.prototype))
+  {
+    // clone() inherited from a base class
+    delete entity;
+    entity = NULL;
+  }
+  if (entity == NULL)
+  {
+    // the entity type does not support cloning
+    entity = entity_allocate(t.type.c_str(), this->load_shared_params);
+    entity->set_simulator(this);
+    entity_load(entity, t);
+  }
+  return entity;
+}
+
+uint
+Simulator::entity_create_from(EntityTemplate &t, const char *id, jsonHash *overrides)
+{
+  NeuralEntity *entity;
+  std::string prefixed;
+
+  if (!this->load_prefix.empty() && id != NULL)
+  {
+    prefixed = this->load_prefix;
+    prefixed.append(id);
+    id = prefixed.c_str();
+  }
+
+  if (overrides != NULL)
+  {
+    jsonHash *merged = new jsonHash();
+    {
+      jsonHashIterator_EACH(t.data, key, value) merged->set(key, value);
+    }
+    {
+      jsonHashIterator_EACH(overrides, key, value) merged->set(key, value);
+    }
+    try
+    {
+      entity = entity_create(t.type.c_str(), id);
+    }
+    catch (...)
+    {
+      merged->ref_decr();
+      throw;
+    }
+    entity->load(merged);
+    merged->ref_decr();
+
+    if (this->lazy_loading) lazy_add_entity(entity->entity_index, ENTITY_NO_INDEX);
+    return entity->entity_index;
+  }
+
+  if (this->lazy_loading && id != NULL)
+  {
+    if (t.lazy_template == ENTITY_NO_INDEX)
+    {
+      t.lazy_template = this->lazy_net->templates.size();
+      this->lazy_net->templates.push_back(EntityTemplate());
+      template_init(this->lazy_net->templates.back(), t.name, t.type, t.data);
+    }
+
+    const size_t len = strlen(id);
+    if (this->entities.index(id, len) != ENTITY_NO_INDEX) throw "duplicate entity id";
+
+    uint index = this->entities.insert(id, len, NULL);
+    lazy_add_entity(index, t.lazy_template);
+    return index;
+  }
+
+  entity = template_instantiate(t);
+  entity_register(entity, id);
+  return entity->entity_index;
+}
+
+NeuralEntity*
+Simulator::entity_at(uint index)
+{
+  NeuralEntity *entity = (index < this->entities.size() ? this->entities.at(index) : NULL);
+
+  if (entity == NULL && entity_is_lazy(index))
+  {
+    entity = entity_materialize(index);
+  }
+  return entity;
+}
+
+NeuralEntity*
+Simulator::entity_or_prototype(uint index)
+{
+  NeuralEntity *entity = (index < this->entities.size() ? this->entities.at(index) : NULL);
+
+  if (entity == NULL && entity_is_lazy(index))
+  {
+    LazyNet *lazy = this->lazy_net;
+    entity = template_prototype(lazy->templates[lazy->entity_templates[index - lazy->first]]);
+  }
+  return entity;
+}
+
+NeuralEntity*
+Simulator::entity_find(const char *id, size_t len)
+{
+  NeuralEntity *entity = entity_at(this->entities.index(id, len));
+
+  if (entity == NULL)
+  {
+    throw "unknown entity";
+  }
+  return entity;
+}
+
+uint
+Simulator::entity_resolve_index(const char *id, size_t len)
+{
+  uint index = ENTITY_NO_INDEX;
+
+  if (!this->load_prefix.empty())
+  {
+    std::string prefixed(this->load_prefix);
+    prefixed.append(id, len);
+    index = this->entities.index(prefixed.data(), prefixed.size());
+  }
+  if (index == ENTITY_NO_INDEX)
+  {
+    index = this->entities.index(id, len);
+  }
+  if (index == ENTITY_NO_INDEX)
+  {
+    throw "unknown entity";
+  }
+  return index;
+}
+
+NeuralEntity*
+Simulator::entity_resolve(const char *id, size_t len)
+{
+  NeuralEntity *entity = entity_at(entity_resolve_index(id, len));
+
+  if (entity == NULL)
+  {
+    throw "unknown entity";
+  }
+  return entity;
+}
+
+void
+Simulator::load_connect(uint from, uint to)
+{
+  LazyNet *lazy = this->lazy_net;
+
+  if (this->lazy_loading && from - lazy->first < lazy->materialized.size())
+  {
+    if ((to >= this->entities.size() || this->entities.at(to) == NULL) && !entity_is_lazy(to))
+    {
+      throw "unknown entity";
+    }
+    lazy->connections.push_back(std::make_pair(from, to));
+    return;
+  }
+
+  NeuralEntity *source = entity_at(from);
+  NeuralEntity *target = entity_at(to);
+
+  if (source == NULL || target == NULL)
+  {
+    throw "unknown entity";
+  }
+  source->connect(target);
+}
+
+void
+Simulator::load_event(uint index, simtime at, real weight)
+{
+  at += this->load_time_offset;
+
+  if (this->load_deferred_events)
+  {
+    if (index >= this->entities.size() || (this->entities.at(index) == NULL && !entity_is_lazy(index)))
+    {
+      throw "unknown entity";
+    }
+    this->input_buffer.add(index, at, weight);
+    return;
+  }
+
+  NeuralEntity *entity = entity_at(index);
+  if (entity == NULL) throw "unknown entity";
+  entity->stimulate(at, weight, NULL);
+}
+
+void
+Simulator::input_add(InputStream *stream)
+{
+  this->input_pq.push(stream);
+}
+
+void
+Simulator::input_finish()
+{
+  std::vector<InputStream*> streams;
+  this->input_buffer.finish(streams);
+  for (uint i = 0; i < streams.size(); i++)
+  {
+    input_add(streams[i]);
+  }
+}
+
+void
+Simulator::input_feed(simtime until)
+{
+  while (!this->input_pq.empty() && this->input_pq.top()->at <= until)
+  {
+    InputStream *stream = this->input_pq.top();
+    this->input_pq.pop();
+
+    // destroyed entities don't get their input
+    NeuralEntity *entity = entity_at(stream->entity);
+    if (entity != NULL) entity->stimulate(stream->at, stream->weight, NULL);
+
+    if (stream->next())
+    {
+      this->input_pq.push(stream);
+    }
+    else
+    {
+      delete stream;
+    }
+  }
+}
+
+void
+Simulator::lazy_add_entity(uint index, uint lazy_template)
+{
+  LazyNet *lazy = this->lazy_net;
+
+  // the entities of the lazy net have to be numbered consecutively
+  if (index != lazy->first + lazy->materialized.size())
+  {
+    throw "duplicate entity id";
+  }
+
+  lazy->entity_templates.push_back(lazy_template);
+  lazy->materialized.push_back(lazy_template == ENTITY_NO_INDEX);
+}
+
+/*
+ * Turn the connections collected while loading into the CSR arrays,
+ * keeping the order of the connections of each entity.
+ */
+void
+Simulator::lazy_finish()
+{
+  LazyNet *lazy = this->lazy_net;
+  const uint n = lazy->materialized.size();
+
+  this->lazy_loading = false;
+
+  lazy->connection_index.assign(n + 1, 0);
+  for (size_t c = 0; c < lazy->connections.size(); c++)
+  {
+    lazy->connection_index[lazy->connections[c].first - lazy->first + 1]++;
+  }
+  for (uint i = 0; i < n; i++)
+  {
+    lazy->connection_index[i+1] += lazy->connection_index[i];
+  }
+
+  std::vector<uint32_t> pos(lazy->connection_index.begin(), lazy->connection_index.end() - 1);
+  lazy->connection_targets.resize(lazy->connections.size());
+  for (size_t c = 0; c < lazy->connections.size(); c++)
+  {
+    lazy->connection_targets[pos[lazy->connections[c].first - lazy->first]++] =
+      lazy->connections[c].second;
+  }
+  std::vector<std::pair<uint32_t, uint32_t> >().swap(lazy->connections);
+
+  // entities already created while loading
+  for (uint i = 0; i < n; i++)
+  {
+    NeuralEntity *entity = this->entities.at(lazy->first + i);
+    if (entity != NULL)
+    {
+      entity->connections_pending = (lazy->connection_index[i] != lazy->connection_index[i+1]);
+    }
+  }
+}
+
+NeuralEntity*
+Simulator::entity_materialize(uint index)
+{
+  LazyNet *lazy = this->lazy_net;
+  const uint i = index - lazy->first;
+
+  NeuralEntity *entity = template_instantiate(lazy->templates[lazy->entity_templates[i]]);
+  entity->entity_index = index;
+  this->entities.set(index, entity);
+  lazy->materialized[i] = true;
+  record_select(entity, this->entities.name(index));
+
+  // while loading this is done by lazy_finish
+  if (!this->lazy_loading)
+  {
+    entity->connections_pending = (lazy->connection_index[i] != lazy->connection_index[i+1]);
+  }
+  return entity;
+}
+
+void
+Simulator::entity_connect_pending(NeuralEntity *entity)
+{
+  LazyNet *lazy = this->lazy_net;
+  const uint i = entity->entity_index - lazy->first;
+
+  entity->connections_pending = false;
+
+  for (uint32_t c = lazy->connection_index[i]; c < lazy->connection_index[i+1]; c++)
+  {
+    // targets destroyed in the meantime are skipped
+    NeuralEntity *target = entity_at(lazy->connection_targets[c]);
+    if (target != NULL) entity->connect(target);
+  }
+}
+
+void
+Simulator::entity_materialize_all()
+{
+  if (this->lazy_net == NULL) return;
+
+  const uint first = this->lazy_net->first;
+  const uint n = this->lazy_net->materialized.size();
+
+  for (uint i = 0; i < n; i++)
+  {
+    entity_at(first + i);
+  }
+  for (uint i = 0; i < n; i++)
+  {
+    NeuralEntity *entity = this->entities.at(first + i);
+    if (entity != NULL && entity->connections_pending) entity_connect_pending(entity);
+  }
+}
+
+void
+Simulator::merge(const char *filename, const char *prefix)
+{
+  this->load_prefix = (prefix != NULL ? prefix : "");
+  this->load_time_offset = this->schedule_current_time;
+
+  try
+  {
+    load(filename);
+  }
+  catch (...)
+  {
+    this->load_prefix.clear();
+    this->load_time_offset = 0.0;
+    throw;
+  }
+  this->load_prefix.clear();
+  this->load_time_offset = 0.0;
+}
+
+void
+Simulator::load(const char *filename)
+{
+  const bool lazy = (this->load_lazy && this->lazy_net == NULL);
+  std::string path;
+  NetFormat format = NetFormats::detect(filename, path);
+  filename = path.c_str();
+
+  if (lazy)
+  {
+    this->lazy_net = new LazyNet();
+    this->lazy_net->first = this->entities.size();
+    this->lazy_loading = true;
+  }
+
+  try
+  {
+    if (format == NET_FORMAT_BINARY)
+    {
+      load_net_file(filename);
+    }
+    else if (format == NET_FORMAT_SPIKE_FILE)
+    {
+      load_spike_file(filename);
+    }
+    else if (format != NET_FORMAT_JSON)
+    {
+      load_stream(format, filename);
+    }
+    else if (this->load_pipelined)
+    {
+      load_json_pipelined(filename);
+    }
+    else if (this->load_streaming)
+    {
+      load_stream(format, filename);
+    }
+    else
+    {
+      load_json(filename);
+    }
+  }
+  catch (...)
+  {
+    if (lazy) lazy_finish();
+    input_finish();
+    throw;
+  }
+
+  if (lazy) lazy_finish();
+  input_finish();
+}
+
+/*
+ * Entities are constructed from the template table. Connections and
+ * events refer to entities by index, so no lookup by id is required.
+ */
+void
+Simulator::load_net_file(const char *filename)
+{
+  NetFile net(filename);
+  const NetFileHeader *h = net.header;
+
+  std::vector<EntityTemplate> templates(h->num_templates);
+  std::vector<uint> entities(h->num_entities);
+
+  for (uint32_t t = 0; t < h->num_templates; t++)
+  {
+    jsonHash *data = net.template_hash(t);
+    template_init(templates[t], net.string(net.templates[t].name),
+        net.string(net.templates[t].type), data);
+    data->ref_decr();
+  }
+
+  this->entities.reserve(this->entities.size() + h->num_entities);
+  for (uint32_t i = 0; i < h->num_entities; i++)
+  {
+    entities[i] = entity_create_from(templates[net.entity_templates[i]],
+        net.string(net.entity_ids[i]));
+  }
+
+  for (uint32_t i = 0; i < h->num_entities; i++)
+  {
+    for (uint32_t c = net.connection_index[i]; c < net.connection_index[i+1]; c++)
+    {
+      load_connect(entities[i], entities[net.connection_targets[c]]);
+    }
+  }
+
+  for (uint32_t g = 0; g < h->num_event_groups; g++)
+  {
+    const uint entity = entities[net.event_entities[g]];
+    for (uint32_t e = net.event_index[g]; e < net.event_index[g+1]; e++)
+    {
+      load_event(entity, net.event_times[e],
+          net.event_weights != NULL ? net.event_weights[e] : INFINITY);
+    }
+  }
+
+  for (uint32_t t = 0; t < h->num_templates; t++)
+  {
+    template_release(templates[t]);
+  }
+}
+
+/*
+ * The spike trains are passed to their entities as InputStreams which
+ * decode them as the simulation proceeds, independent of
+ * +load_deferred_events+. The file stays loaded until the Simulator is
+ * destroyed.
+ */
+void
+Simulator::load_spike_file(const char *filename)
+{
+  SpikeFile *file = new SpikeFile(filename);
+  std::vector<InputStream*> streams;
+
+  try
+  {
+    for (uint32_t t = 0; t < file->header->num_trains; t++)
+    {
+      if (file->trains[t].num_spikes == 0) continue;
+      const uint entity = entity_resolve_index(file->string(file->trains[t].id));
+      streams.push_back(new SpikeFile::Stream(file, t, entity, this->load_time_offset));
+    }
+  }
+  catch (...)
+  {
+    for (uint i = 0; i < streams.size(); i++) delete streams[i];
+    delete file;
+    throw;
+  }
+
+  this->input_files.push_back(file);
+  for (uint i = 0; i < streams.size(); i++)
+  {
+    input_add(streams[i]);
+  }
+}
+
+struct ResolveIds
+{
+  const EntityTable *entities;
+  const std::string *prefix;
+  const jsonNode *const *ids;
+  uint *resolved;
+};
+
+static void
+resolve_ids_range(void *data, uint from, uint to)
+{
+  ResolveIds *r = (ResolveIds*) data;
+  std::string prefixed;
+
+  for (uint i = from; i < to; i++)
+  {
+    uint index = ENTITY_NO_INDEX;
+
+    if (!r->prefix->empty())
+    {
+      prefixed.assign(*r->prefix);
+      prefixed.append(r->ids[i]->str, r->ids[i]->size);
+      index = r->entities->index(prefixed.data(), prefixed.size());
+    }
+    if (index == ENTITY_NO_INDEX)
+    {
+      index = r->entities->index(r->ids[i]->str, r->ids[i]->size);
+    }
+    r->resolved[i] = index;
+  }
+}
+
+/*
+ * Lookup the indices of all +ids+ (see
+ * Simulator::entity_resolve_index) using +threads+ threads. As
+ * +entities+ is only read, no locking is required.
+ */
+static void
+resolve_ids(const EntityTable &entities, const std::string &prefix,
+    const std::vector<const jsonNode*> &ids, std::vector<uint> &resolved,
+    uint threads)
+{
+  for (uint i = 0; i < ids.size(); i++)
+  {
+    if (!ids[i]->is_type(JSON_STRING)) throw "invalid type cast";
+  }
+
+  resolved.resize(ids.size());
+  if (ids.empty()) return;
+
+  ResolveIds r;
+  r.entities = &entities;
+  r.prefix = &prefix;
+  r.ids = &ids[0];
+  r.resolved = &resolved[0];
+  parallel_for(ids.size(), threads, resolve_ids_range, &r);
+
+  for (uint i = 0; i < resolved.size(); i++)
+  {
+    if (resolved[i] == ENTITY_NO_INDEX) throw "unknown entity";
+  }
+}
+
+/*
+ * Append the ids of +connections+ to +ids+ and the start of each
+ * connection list to +start+.
+ */
+static void
+collect_connection_ids(const jsonNode *connections, std::vector<const jsonNode*> &ids,
+    std::vector<uint32_t> &start)
+{
+  for (uint32_t i = 0; i < connections->size; i++)
+  {
+    const jsonNode *conn = connections->at(i);
+    start.push_back(ids.size());
+    for (uint32_t j = 0; j < conn->size; j++)
+    {
+      ids.push_back(conn->at(j));
+    }
+  }
+}
+
+void
+Simulator::load_json_templates(const jsonNode *templates, std::map<std::string, EntityTemplate> &template_map)
+{
+  std::map<std::string, EntityTemplate>::iterator tm;
+
+  if (!templates->is_type(JSON_HASH)) throw "invalid type cast";
+
+  for (uint32_t i = 0; i < templates->size; i++)
+  {
+    const jsonNode *t = templates->value(i);
+    std::string name = templates->key(i)->as_string();
+
+    tm = template_map.find(name);
+    if (tm != template_map.end())
+    {
+      template_release(tm->second);
+      template_map.erase(tm);
+    }
+
+    const std::string type = t->at(0)->as_string();
+    jsonValue *data = t->at(1)->to_value();
+    if (data->asHash() == NULL)
+    {
+      data->ref_decr();
+      throw "invalid type cast";
+    }
+    template_init(template_map[name], name, type, data->asHash());
+    data->ref_decr();
+  }
+}
+
+void
+Simulator::load_json_entity(const jsonNode *entity_spec, std::map<std::string, EntityTemplate> &template_map)
+{
+  const std::string id = entity_spec->at(0)->as_string();
+  const std::string template_name = entity_spec->at(1)->as_string();
+
+  std::map<std::string, EntityTemplate>::iterator tm = template_map.find(template_name);
+  if (tm == template_map.end()) throw "unknown template";
+
+  if (entity_spec->size > 2)
+  {
+    jsonValue *overrides = entity_spec->at(2)->to_value();
+    try
+    {
+      if (overrides->asHash() == NULL) throw "invalid format";
+      entity_create_from(tm->second, id.c_str(), overrides->asHash());
+    }
+    catch (...)
+    {
+      overrides->ref_decr();
+      throw;
+    }
+    overrides->ref_decr();
+  }
+  else
+  {
+    entity_create_from(tm->second, id.c_str());
+  }
+}
+
+/*
+ * Stimulate the entities of +events+ (an id -> times hash), whose
+ * indices are +event_ids+.
+ */
+void
+Simulator::load_json_events(const jsonNode *events, const uint *event_ids)
+{
+  for (uint32_t i = 0; i < events->size; i++)
+  {
+    const jsonNode *times = events->value(i);
+
+    for (uint32_t j = 0; j < times->size; j++)
+    {
+      load_event(event_ids[i], times->at(j)->as_number(), INFINITY);
+    }
+  }
+}
+
+/*
+ * The net is parsed into a jsonDocument. Only the templates are
+ * converted into jsonHashes as required by NeuralEntity::load.
+ */
+void
+Simulator::load_json(const char *filename)
+{
+  if (this->load_threads > 1)
+  {
+    load_json_parallel(filename);
+    return;
+  }
+
+  jsonDocument doc(filename);
+  const jsonNode *data = doc.root;
+
+  if (!data->is_type(JSON_HASH) || data->get("format") == NULL ||
+      !data->get("format")->equals("yinspire.c"))
+  {
+    throw "unrecognized data format";
+  }
+
+  const jsonNode *templates = data->get("templates");
+  const jsonNode *entities = data->get("entities");
+  const jsonNode *connections = data->get("connections");
+  const jsonNode *events = data->get("events");
+
+  std::map<std::string, EntityTemplate> template_map;
+  std::map<std::string, EntityTemplate>::iterator tm;
+
+  /*
+   * The templates are released once the net is loaded, also if
+   * loading fails.
+   */
+  try
+  {
+    if (templates != NULL) load_json_templates(templates, template_map);
+
+    /*
+     * construct entities
+     */
+    if (entities != NULL)
+    {
+      this->entities.reserve(this->entities.size() + entities->size);
+
+      for (uint32_t i = 0; i < entities->size; i++)
+      {
+        load_json_entity(entities->at(i), template_map);
+      }
+    }
+
+    /*
+     * The ids of the connections (in +start+ ranges) and then those of
+     * the events are resolved in one go. The entities are connected
+     * and stimulated in the order of the file afterwards.
+     */
+    std::vector<const jsonNode*> ids;
+    std::vector<uint32_t> start;
+    std::vector<uint> resolved;
+
+    if (connections != NULL) collect_connection_ids(connections, ids, start);
+    start.push_back(ids.size());
+
+    if (events != NULL)
+    {
+      for (uint32_t i = 0; i < events->size; i++)
+      {
+        ids.push_back(events->key(i));
+      }
+    }
+
+    resolve_ids(this->entities, this->load_prefix, ids, resolved, 1);
+
+    /*
+     * connect entities
+     */
+    for (uint32_t i = 0; i + 1 < start.size(); i++)
+    {
+      uint from = resolved[start[i]];
+      for (uint32_t j = start[i] + 1; j < start[i+1]; j++)
+      {
+        load_connect(from, resolved[j]);
+      }
+    }
+
+    /*
+     * events
+     */
+    if (events != NULL)
+    {
+      load_json_events(events, resolved.empty() ? NULL : &resolved[start.back()]);
+    }
+  }
+  catch (...)
+  {
+    for (tm = template_map.begin(); tm != template_map.end(); ++tm)
+    {
+      template_release(tm->second);
+    }
+    throw;
+  }
+
+  for (tm = template_map.begin(); tm != template_map.end(); ++tm)
+  {
+    template_release(tm->second);
+  }
+}
+
+struct ParseFragments
 {
-  this->types[type] = factory;
+  const jsonDocument *doc;
+  std::vector<const jsonSection*> sections;
+  std::vector<uint> ranges;
+  std::vector<jsonFragment*> fragments;
+  std::vector<const char*> errors;
+
+  ~ParseFragments()
+  {
+    for (uint i = 0; i < this->fragments.size(); i++) delete this->fragments[i];
+  }
+
+  void
+    add(const jsonSection *section)
+    {
+      if (section == NULL) return;
+      for (uint r = 0; r < section->ranges(); r++)
+      {
+        this->sections.push_back(section);
+        this->ranges.push_back(r);
+      }
+    }
+
+  /*
+   * The fragments of +section+ (in order) are appended to +nodes+.
+   */
+  void
+    nodes(const jsonSection *section, std::vector<const jsonNode*> &nodes) const
+    {
+      for (uint i = 0; i < this->sections.size(); i++)
+      {
+        if (this->sections[i] == section) nodes.push_back(this->fragments[i]->root);
+      }
+    }
+};
+
+static void
+parse_fragments_range(void *data, uint from, uint to)
+{
+  ParseFragments *p = (ParseFragments*) data;
+
+  for (uint i = from; i < to; i++)
+  {
+    try
+    {
+      p->fragments[i] = new jsonFragment(*p->doc, *p->sections[i], p->ranges[i]);
+    }
+    catch (const char *err)
+    {
+      p->errors[i] = err;
+    }
+    catch (...)
+    {
+      p->errors[i] = "error occured while parsing";
+    }
+  }
 }
 
-NeuralEntity*
-Simulator::entity_allocate(const char* type)
+struct CloneEntities
 {
-  entity_factory_t factory = this->types[type];
-  return factory();
+  const jsonNode *const *specs;
+  /*
+   * Template name -> prototype, for the templates whose entities can
+   * be cloned.
+   */
+  const std::map<std::string, NeuralEntity*> *prototypes;
+  NeuralEntity **entities;
+};
+
+/*
+ * Clone the entities without own properties from the prototypes of
+ * their templates. Everything else (including invalid entries) is
+ * left for the sequential pass, which reports the errors.
+ */
+static void
+clone_entities_range(void *data, uint from, uint to)
+{
+  CloneEntities *c = (CloneEntities*) data;
+  std::map<std::string, NeuralEntity*>::const_iterator it;
+  std::string name;
+
+  for (uint i = from; i < to; i++)
+  {
+    const jsonNode *spec = c->specs[i];
+    c->entities[i] = NULL;
+
+    if (!spec->is_type(JSON_ARRAY) || spec->size != 2 || !spec->at(0)->is_type(JSON_STRING) ||
+        !spec->at(1)->is_type(JSON_STRING))
+    {
+      continue;
+    }
+
+    try
+    {
+      name.assign(spec->at(1)->str, spec->at(1)->size);
+      it = c->prototypes->find(name);
+      if (it != c->prototypes->end()) c->entities[i] = it->second->clone();
+    }
+    catch (...)
+    {
+      // created by the sequential pass, which reports the error
+    }
+  }
 }
 
+/*
+ * Like load_json, but the work is split up for +load_threads+ threads:
+ *
+ *   1. While the file is parsed, the entities, connections and events
+ *      sections are only split into ranges, which are then parsed in
+ *      parallel.
+ *   2. The entities without own properties are cloned from the
+ *      prototypes of their templates in parallel, and registered in
+ *      the order of the file afterwards.
+ *   3. The ids of the connections and events are resolved in
+ *      parallel.
+ *   4. The entities are connected in parallel (see
+ *      load_connect_parallel).
+ *   5. The events are applied in the order of the file.
+ *
+ * Indices, connection lists and errors are the same as with
+ * load_json.
+ */
 void
-Simulator::load(const char *filename)
+Simulator::load_json_parallel(const char *filename)
 {
-  jsonHash *data = jsonParser::parse_file_mmap(filename)->asHash();
+  static const char *const deferred[] = {"entities", "connections", "events", NULL};
+  const uint threads = this->load_threads;
 
-  std::string format = data->get("format")->asString()->value;
+  jsonDocument doc(filename, deferred, threads);
+  const jsonNode *data = doc.root;
 
-  if (format != "yinspire.c")
+  if (!data->is_type(JSON_HASH) || data->get("format") == NULL ||
+      !data->get("format")->equals("yinspire.c"))
   {
     throw "unrecognized data format";
   }
 
-  jsonHash *templates = data->get("templates")->asHash();
-  jsonArray *entities = data->get("entities")->asArray();
-  jsonArray *connections = data->get("connections")->asArray();
-  jsonHash *events = data->get("events")->asHash();
+  // a deferred value which is no array or hash was parsed as usual
+  for (uint i = 0; deferred[i] != NULL; i++)
+  {
+    const jsonNode *value = data->get(deferred[i]);
+    if (value != NULL && !value->is_type(JSON_NULL)) throw "invalid type cast";
+  }
+
+  const jsonNode *templates = data->get("templates");
+  const jsonSection *entities = doc.section("entities");
+  const jsonSection *connections = doc.section("connections");
+  const jsonSection *events = doc.section("events");
+
+  if ((entities != NULL && entities->type != JSON_ARRAY) ||
+      (connections != NULL && connections->type != JSON_ARRAY) ||
+      (events != NULL && events->type != JSON_HASH))
+  {
+    throw "invalid type cast";
+  }
 
   /*
-   * construct entities
+   * parse the sections
    */
-  jsonArrayIterator_EACH(entities, e)
+  ParseFragments p;
+  p.doc = &doc;
+  p.add(entities);
+  p.add(connections);
+  p.add(events);
+  p.fragments.resize(p.sections.size(), NULL);
+  p.errors.resize(p.sections.size(), NULL);
+  parallel_for(p.sections.size(), threads, parse_fragments_range, &p);
+
+  for (uint i = 0; i < p.errors.size(); i++)
   {
-    jsonArray *entity_spec = e->asArray();
-    jsonString *id = entity_spec->get(0)->asString();
-    jsonString *template_name = entity_spec->get(1)->asString();
+    if (p.errors[i] != NULL) throw p.errors[i];
+  }
 
-    jsonArray *t = templates->get(template_name)->asArray();
+  std::vector<const jsonNode*> entity_nodes, connection_nodes, event_nodes;
+  p.nodes(entities, entity_nodes);
+  p.nodes(connections, connection_nodes);
+  p.nodes(events, event_nodes);
 
-    jsonString *type = t->get(0)->asString();
-    jsonHash *hash = t->get(1)->asHash();
+  std::map<std::string, EntityTemplate> template_map;
+  std::map<std::string, EntityTemplate>::iterator tm;
 
-    NeuralEntity *entity = entity_allocate(type->value.c_str());
+  try
+  {
+    if (templates != NULL) load_json_templates(templates, template_map);
 
-    entity->set_id(strdup(id->asString()->value.c_str()));
-    entity->set_simulator(this);
-    this->entities[entity->get_id()] = entity;
+    /*
+     * construct entities
+     */
+    std::vector<const jsonNode*> specs;
+    for (uint f = 0; f < entity_nodes.size(); f++)
+    {
+      for (uint32_t i = 0; i < entity_nodes[f]->size; i++) specs.push_back(&entity_nodes[f]->items[i]);
+    }
+    this->entities.reserve(this->entities.size() + specs.size());
+
+    // entities of a lazy net are not created
+    std::map<std::string, NeuralEntity*> prototypes;
+    for (tm = template_map.begin(); tm != template_map.end() && !this->lazy_loading; ++tm)
+    {
+      try
+      {
+        NeuralEntity *entity = template_prototype(tm->second)->clone();
+        if (entity != NULL && typeid(*entity) == typeid(*tm->second.prototype)) prototypes[tm->first] = tm->second.prototype;
+        delete entity;
+      }
+      catch (...)
+      {
+        // reported if the template is used
+      }
+    }
+
+    std::vector<NeuralEntity*> cloned(specs.size(), NULL);
+    if (!prototypes.empty() && !specs.empty())
+    {
+      CloneEntities c;
+      c.specs = &specs[0];
+      c.prototypes = &prototypes;
+      c.entities = &cloned[0];
+      parallel_for(specs.size(), threads, clone_entities_range, &c);
+    }
+
+    std::string id;
+    for (uint i = 0; i < specs.size(); i++)
+    {
+      try
+      {
+        if (cloned[i] == NULL)
+        {
+          load_json_entity(specs[i], template_map);
+          continue;
+        }
+
+        id = this->load_prefix;
+        id.append(specs[i]->at(0)->str, specs[i]->at(0)->size);
+
+        // entity_register deletes the entity if it fails
+        NeuralEntity *entity = cloned[i];
+        cloned[i] = NULL;
+        entity_register(entity, id.c_str());
+      }
+      catch (...)
+      {
+        for (uint j = i; j < cloned.size(); j++) delete cloned[j];
+        throw;
+      }
+    }
+
+    /*
+     * resolve the ids of the connections (in +start+ ranges) and the
+     * events
+     */
+    std::vector<const jsonNode*> ids;
+    std::vector<uint32_t> start;
+    std::vector<uint> resolved;
+
+    for (uint f = 0; f < connection_nodes.size(); f++)
+    {
+      collect_connection_ids(connection_nodes[f], ids, start);
+    }
+    start.push_back(ids.size());
+
+    for (uint f = 0; f < event_nodes.size(); f++)
+    {
+      for (uint32_t i = 0; i < event_nodes[f]->size; i++)
+      {
+        ids.push_back(event_nodes[f]->key(i));
+      }
+    }
+
+    resolve_ids(this->entities, this->load_prefix, ids, resolved, threads);
+
+    /*
+     * connect entities
+     */
+    load_connect_parallel(resolved, start);
+
+    /*
+     * events
+     */
+    const uint *event_ids = resolved.empty() ? NULL : &resolved[start.back()];
+    for (uint f = 0; f < event_nodes.size(); f++)
+    {
+      load_json_events(event_nodes[f], event_ids);
+      event_ids += event_nodes[f]->size;
+    }
+  }
+  catch (...)
+  {
+    for (tm = template_map.begin(); tm != template_map.end(); ++tm)
+    {
+      template_release(tm->second);
+    }
+    throw;
+  }
 
-    entity->load(hash);
+  for (tm = template_map.begin(); tm != template_map.end(); ++tm)
+  {
+    template_release(tm->second);
   }
+}
+
+struct LinkEntities
+{
+  const EntityTable *entities;
+  const uint *from;
+  const uint *to;
+
+  /*
+   * The connections of owner +o+ are order[first[o]] ...
+   * order[first[o+1]-1], in the order of the file.
+   */
+  const uint *first;
+  const uint *order;
 
   /*
-   * connect entities
+   * Set by classify_links_range: the owner of each connection, or
+   * ENTITY_NO_INDEX if it can't be linked in parallel.
    */
-  jsonArrayIterator_EACH(connections, conn)
+  uint *owner;
+};
+
+/*
+ * A connection from a Neuron to a Synapse only modifies the list of
+ * post synapses of the Neuron (and the Synapse itself), one from a
+ * Synapse to a Neuron only the list of pre synapses of the Neuron. So
+ * the Neuron "owns" the connection.
+ */
+static void
+classify_links_range(void *data, uint from, uint to)
+{
+  LinkEntities *l = (LinkEntities*) data;
+
+  for (uint k = from; k < to; k++)
+  {
+    NeuralEntity *source = (l->from[k] < l->entities->size() ? l->entities->at(l->from[k]) : NULL);
+    NeuralEntity *target = (l->to[k] < l->entities->size() ? l->entities->at(l->to[k]) : NULL);
+    Neuron *neuron;
+    Synapse *syn;
+
+    l->owner[k] = ENTITY_NO_INDEX;
+    if (source == NULL || target == NULL) continue;
+
+    if ((neuron = dynamic_cast<Neuron*>(source)) != NULL && (syn = dynamic_cast<Synapse*>(target)) != NULL)
+    {
+      if (syn->get_pre_neuron() == NULL) l->owner[k] = l->from[k];
+    }
+    else if ((syn = dynamic_cast<Synapse*>(source)) != NULL && (neuron = dynamic_cast<Neuron*>(target)) != NULL)
+    {
+      if (syn->get_post_neuron() == NULL) l->owner[k] = l->to[k];
+    }
+  }
+}
+
+static void
+link_entities_range(void *data, uint from, uint to)
+{
+  LinkEntities *l = (LinkEntities*) data;
+
+  for (uint o = from; o < to; o++)
+  {
+    for (uint i = l->first[o]; i < l->first[o+1]; i++)
+    {
+      const uint k = l->order[i];
+      l->entities->at(l->from[k])->connect(l->entities->at(l->to[k]));
+    }
+  }
+}
+
+/*
+ * Connects the entities of the connection lists in +resolved+ (see
+ * load_json_parallel) without locks: the connections are sorted by
+ * the Neuron whose synapse list they modify (the source of a
+ * connection to a Synapse, the target of one from a Synapse), and all
+ * connections of a Neuron are made by the same thread, in the order
+ * of the file. So every list ends up as with load_connect.
+ *
+ * If any connection would fail (or belongs to a lazy net), all of them
+ * are made with load_connect instead, which reports the error.
+ */
+void
+Simulator::load_connect_parallel(const std::vector<uint> &resolved, const std::vector<uint32_t> &start)
+{
+  std::vector<uint> from, to;
+
+  for (uint32_t i = 0; i + 1 < start.size(); i++)
   {
-    NeuralEntity *from = NULL;
-    jsonArrayIterator_EACH(conn->asArray(), i)
+    for (uint32_t j = start[i] + 1; j < start[i+1]; j++)
     {
-      std::string &id = i->asString()->value;
-      NeuralEntity *e = this->entities[id.c_str()]; 
-      if (from == NULL) from = e;
-      else from->connect(e);
-    } 
+      from.push_back(resolved[start[i]]);
+      to.push_back(resolved[j]);
+    }
   }
+  if (from.empty()) return;
+
+  std::vector<uint> owner(from.size());
+  LinkEntities l;
+  l.entities = &this->entities;
+  l.from = &from[0];
+  l.to = &to[0];
+  l.owner = &owner[0];
+
+  bool parallel = !this->lazy_loading;
+  if (parallel) parallel_for(from.size(), this->load_threads, classify_links_range, &l);
 
   /*
-   * events
+   * A Synapse has only one pre and one post Neuron.
    */
-  jsonHashIterator_EACH(events, key, val) 
+  std::vector<unsigned char> linked(parallel ? this->entities.size() : 0, 0);
+  for (uint k = 0; k < from.size() && parallel; k++)
+  {
+    const uint syn = (owner[k] == from[k] ? to[k] : from[k]);
+    const unsigned char side = (owner[k] == from[k] ? 1 : 2);
+
+    if (owner[k] == ENTITY_NO_INDEX || (linked[syn] & side) != 0) parallel = false;
+    else linked[syn] |= side;
+  }
+
+  if (!parallel)
   {
-    NeuralEntity *entity = this->entities[key->value.c_str()];
-    jsonArrayIterator_EACH(val->asArray(), e)
+    for (uint k = 0; k < from.size(); k++) load_connect(from[k], to[k]);
+    return;
+  }
+
+  // counting sort by owner
+  std::vector<uint> first(this->entities.size() + 1, 0);
+  std::vector<uint> order(from.size());
+
+  for (uint k = 0; k < owner.size(); k++) ++first[owner[k] + 1];
+  for (uint o = 0; o < this->entities.size(); o++) first[o+1] += first[o];
+  {
+    std::vector<uint> pos(first.begin(), first.end() - 1);
+    for (uint k = 0; k < owner.size(); k++) order[pos[owner[k]]++] = k;
+  }
+
+  l.first = &first[0];
+  l.order = &order[0];
+  parallel_for(this->entities.size(), this->load_threads, link_entities_range, &l);
+}
+
+/*
+ * Creates the entities while the net is parsed. Only the templates
+ * are kept as DOM.
+ */
+class SimulatorStreamLoader : public NetStreamHandler
+{
+    Simulator *simulator;
+    std::map<std::string, Simulator::EntityTemplate> templates;
+    uint from;
+    uint entity;
+
+  public:
+
+    SimulatorStreamLoader(Simulator *simulator)
     {
-      entity->stimulate(e->asNumber()->value, INFINITY, NULL);  
+      this->simulator = simulator;
+      this->from = ENTITY_NO_INDEX;
+      this->entity = ENTITY_NO_INDEX;
     }
-  }
 
-  data->ref_decr();
+    virtual ~SimulatorStreamLoader()
+    {
+      std::map<std::string, Simulator::EntityTemplate>::iterator it;
+      for (it = this->templates.begin(); it != this->templates.end(); ++it)
+      {
+        this->simulator->template_release(it->second);
+      }
+    }
+
+    virtual void
+      on_template(const std::string &name, const std::string &type, jsonHash *data)
+      {
+        std::map<std::string, Simulator::EntityTemplate>::iterator it = this->templates.find(name);
+        if (it != this->templates.end())
+        {
+          this->simulator->template_release(it->second);
+          this->templates.erase(it);
+        }
+        this->simulator->template_init(this->templates[name], name, type, data);
+      }
+
+    virtual void
+      on_entity(const std::string &id, const std::string &template_name, jsonHash *data)
+      {
+        std::map<std::string, Simulator::EntityTemplate>::iterator it =
+          this->templates.find(template_name);
+
+        if (it == this->templates.end())
+        {
+          throw "unknown template";
+        }
+
+        this->simulator->entity_create_from(it->second, id.c_str(), data);
+      }
+
+    virtual void
+      on_connections(const std::string &from)
+      {
+        this->from = this->simulator->entity_resolve_index(from);
+      }
+
+    virtual void
+      on_connection(const std::string &to)
+      {
+        this->simulator->load_connect(this->from, this->simulator->entity_resolve_index(to));
+      }
+
+    virtual void
+      on_events(const std::string &id)
+      {
+        this->entity = this->simulator->entity_resolve_index(id);
+      }
+
+    virtual void
+      on_event(simtime at, real weight)
+      {
+        this->simulator->load_event(this->entity, at, weight);
+      }
+};
+
+void
+Simulator::load_stream(NetFormat format, const char *filename)
+{
+  SimulatorStreamLoader loader(this);
+  NetFormats::parse_file(format, filename, &loader);
+}
+
+void
+Simulator::load_json_pipelined(const char *filename)
+{
+  SimulatorStreamLoader loader(this);
+  NetStreamPipeline::parse_file(filename, &loader, &this->load_times);
 }
 
 void
 Simulator::run(simtime stop_at)
 {
+  const simtime window = MAX(this->stimuli_tolerance, 0.0);
+
+  this->running = true;
+  try
+  {
+    run_until(stop_at, window);
+  }
+  catch (...)
+  {
+    this->running = false;
+    release_destroyed_entities();
+    throw;
+  }
+  this->running = false;
+  release_destroyed_entities();
+
+  /*
+   * The net has been simulated up to +stop_at+, which is where a
+   * following run() or merge() continues.
+   */
+  if (stop_at < INFINITY)
+  {
+    this->schedule_current_time = stop_at;
+  }
+}
+
+void
+Simulator::run_until(simtime stop_at, simtime window)
+{
+
   while (true)
   {
     simtime next_stop = MIN(stop_at, this->schedule_next_step);
@@ -108,20 +1587,40 @@ Simulator::run(simtime stop_at)
      * Calculate all events from the priority queue until the next time
      * step is reached.
      */
-    while (!this->schedule_pq.empty())
+    while (true)
     {
-      NeuralEntity *top = this->schedule_pq.top();
-      if (top->get_schedule_at() >= next_stop)
+      simtime at = (this->schedule_pq.empty() ? INFINITY : this->schedule_pq.top()->get_schedule_at());
+
+      /*
+       * Input events are passed on before anything at (or within the
+       * tolerance of) their time is processed, so that they are
+       * accumulated with other stimuli as if they had been there from
+       * the start.
+       */
+      simtime input_at = input_next_at();
+      if (input_at <= at + window && MIN(at, input_at) < next_stop)
+      {
+        input_feed(MIN(at, input_at) + window);
+        continue;
+      }
+
+      if (at >= next_stop)
         break;
+
+      NeuralEntity *top = this->schedule_pq.top();
       this->schedule_current_time = top->get_schedule_at(); 
       this->schedule_pq.pop();
       top->process(top->get_schedule_at());
+
+      if (!this->destroyed_entities.empty())
+        release_destroyed_entities();
     }
 
     if (this->schedule_current_time >= stop_at)
       break;
 
-    if (this->schedule_stepping_list_root == NULL && this->schedule_pq.empty())
+    if (this->schedule_stepping_list_root == NULL && this->schedule_pq.empty() &&
+        this->input_pq.empty())
       break;
 
     /* 
@@ -145,7 +1644,173 @@ Simulator::schedule_update(NeuralEntity *entity)
 }
 
 void
-Simulator::stat_record_fire_event(simtime at, NeuralEntity *source)
+Simulator::stat_record_fire_event(simtime at, NeuralEntity *source, real weight)
 {
   ++this->stat_fire_counter;
+  if (this->fire_log != NULL && source->recorded)
+  {
+    this->fire_log->record(source->get_index(), at, weight);
+  }
+  if (this->spike_stats != NULL)
+  {
+    this->spike_stats->record(source->get_index(), at);
+  }
+  if (!this->fire_counts.empty() && source->recorded)
+  {
+    const uint index = source->get_index();
+    const uint slot = (index < this->fire_count_slots.size() ? this->fire_count_slots[index] : ENTITY_NO_INDEX);
+    if (slot != ENTITY_NO_INDEX)
+    {
+      const uint window = (at > 0.0 ? (uint)MIN(at / this->fire_count_window, this->fire_count_windows - 1) : 0);
+      ++this->fire_counts[window * this->fire_count_ids.size() + slot];
+    }
+  }
+}
+
+void
+Simulator::record_open(const char *filename)
+{
+  record_close();
+  this->fire_log = new FireLogWriter(filename);
+}
+
+void
+Simulator::record_close()
+{
+  if (this->fire_log == NULL) return;
+
+  FireLogWriter *log = this->fire_log;
+  this->fire_log = NULL;
+  try
+  {
+    log->close(this->entities);
+  }
+  catch (...)
+  {
+    delete log;
+    throw;
+  }
+  delete log;
+}
+
+void
+Simulator::stats_open(simtime bin_width, const std::set<std::string> &correlate)
+{
+  SpikeStats *stats = new SpikeStats(bin_width);
+
+  for (std::set<std::string>::const_iterator i = correlate.begin(); i != correlate.end(); i++)
+  {
+    uint index = this->entities.index(i->c_str(), i->size());
+    if (index == ENTITY_NO_INDEX)
+    {
+      delete stats;
+      throw "unknown entity";
+    }
+    stats->correlate(index);
+  }
+
+  delete this->spike_stats;
+  this->spike_stats = stats;
+}
+
+void
+Simulator::stats_write(const char *filename)
+{
+  if (this->spike_stats == NULL) return;
+
+  FILE *out = (strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w"));
+  if (out == NULL) throw "cannot open file";
+
+  this->spike_stats->write(out, this->entities, this->schedule_current_time);
+
+  if (out == stdout)
+    fflush(out);
+  else if (fclose(out) != 0)
+    throw "write failed";
+}
+
+void
+Simulator::counts_open(simtime window, simtime until)
+{
+  if (!(window > 0.0)) throw "invalid window";
+
+  const double windows = (isinf(window) || isinf(until) ? 1.0 : MAX(ceil(until / window), 1.0));
+
+  /*
+   * Only Neurons fire. The type of an entity of a lazy net that was
+   * not created yet is that of it's template.
+   */
+  std::vector<int> lazy_neuron(this->lazy_net != NULL ? this->lazy_net->templates.size() : 0, -1);
+
+  this->fire_count_slots.assign(this->entities.size(), ENTITY_NO_INDEX);
+  this->fire_count_ids.clear();
+  for (uint i = 0; i < this->entities.size(); i++)
+  {
+    NeuralEntity *entity = this->entities.at(i);
+    bool neuron = (entity != NULL && dynamic_cast<Neuron*>(entity) != NULL);
+
+    if (entity == NULL && entity_is_lazy(i))
+    {
+      const uint t = this->lazy_net->entity_templates[i - this->lazy_net->first];
+      if (lazy_neuron[t] < 0)
+      {
+        NeuralEntity *e = entity_allocate(this->lazy_net->templates[t].type.c_str());
+        lazy_neuron[t] = (dynamic_cast<Neuron*>(e) != NULL);
+        delete e;
+      }
+      neuron = (lazy_neuron[t] > 0);
+    }
+
+    if (!neuron) continue;
+    this->fire_count_slots[i] = this->fire_count_ids.size();
+    this->fire_count_ids.push_back(i);
+  }
+
+  if (windows * MAX(this->fire_count_ids.size(), 1) > 0xFFFFFFFF) throw "too many windows";
+
+  this->fire_count_windows = (uint)windows;
+  this->fire_count_window = window;
+  this->fire_counts.assign(MAX(this->fire_count_ids.size() * this->fire_count_windows, 1), 0);
+}
+
+void
+Simulator::counts_write(const char *filename)
+{
+  if (this->fire_counts.empty()) return;
+
+  FILE *out = (strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w"));
+  if (out == NULL) throw "cannot open file";
+
+  const uint slots = this->fire_count_ids.size();
+  for (uint s = 0; s < slots; s++)
+  {
+    const uint i = this->fire_count_ids[s];
+    NeuralEntity *entity = this->entities.at(i);
+    const char *id = this->entities.name(i);
+    bool recorded = (entity != NULL && entity->recorded);
+
+    if (entity == NULL && entity_is_lazy(i))
+    {
+      // entities of a lazy net which were never created did not fire,
+      // but are counted unless the record filters exclude them (as
+      // entity_allocate and record_select do for created ones)
+      const std::string &type =
+        this->lazy_net->templates[this->lazy_net->entity_templates[i - this->lazy_net->first]].type;
+      recorded = (this->record_types.empty() || this->record_types.count(type) > 0) &&
+        (this->record_ids.empty() || this->record_ids.count(id) > 0);
+    }
+    if (!recorded) continue;
+
+    fputs(id, out);
+    for (uint w = 0; w < this->fire_count_windows; w++)
+    {
+      fprintf(out, "\t%u", this->fire_counts[w * slots + s]);
+    }
+    fputc('\n', out);
+  }
+
+  if (out == stdout)
+    fflush(out);
+  else if (fclose(out) != 0)
+    throw "write failed";
 }
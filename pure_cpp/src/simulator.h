@@ -3,10 +3,26 @@
 
 #include "types.h"
 #include "neural_entity.h" 
+#include "entity_table.h"
+#include "net_pipeline.h"
+#include "net_format.h"
+#include "input_stream.h"
 #include "memory_allocator.h"
+#include "algo/binary_heap.h"
 #include "algo/indexed_binary_heap.h"
 #include <string.h>
+#include <math.h>
 #include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class Neuron;
+class Synapse;
+class SpikeFile;
+class FireLogWriter;
+class SpikeStats;
+struct jsonNode;
 
 struct ltstr
 {
@@ -19,6 +35,12 @@ struct ltstr
 class Simulator
 {
     friend class NeuralEntity;
+    friend class Neuron;
+    friend class Synapse;
+    friend class NetCompiler;
+    friend class NetDumper;
+    friend class WeightPublisher;
+    friend class SimulatorStreamLoader;
 
   protected:
 
@@ -57,9 +79,10 @@ class Simulator
     /*
      * An id -> NeuralEntity mapping
      *
-     * Contains all entities known by the simulator.
+     * Contains all entities known by the simulator, except anonymous
+     * ones.
      */
-    std::map<const char *, NeuralEntity *, ltstr> entities;
+    EntityTable entities;
 
     /*
      * An entity type name -> "factory function for this type" mapping.
@@ -67,18 +90,111 @@ class Simulator
     typedef NeuralEntity* (*entity_factory_t)();
     std::map<const char *, entity_factory_t, ltstr> types;
 
+    /*
+     * The factories of the types whose entities can share their
+     * immutable parameters, used if +load_shared_params+.
+     */
+    std::map<const char *, entity_factory_t, ltstr> shared_types;
+
+    /*
+     * Entities destroyed during the simulation. They are released
+     * after the currently processed entity has finished.
+     */
+    std::vector<NeuralEntity*> destroyed_entities;
+
+    /*
+     * True while run() processes entities. Otherwise destroyed
+     * entities are released at once.
+     */
+    bool running;
+
+    /*
+     * The synapses the firing Neuron visits next (see
+     * Neuron::fire_synapses). Disconnecting one of them moves on to
+     * the following one, so that synapses can be pruned while a Neuron
+     * iterates over them.
+     */
+    Synapse *fire_next_pre_synapse;
+    Synapse *fire_next_post_synapse;
+
+    /*
+     * Prefix prepended to the ids of the entities of the net being
+     * loaded, and time added to it's events (see merge).
+     */
+    std::string load_prefix;
+    simtime load_time_offset;
+
+    /*
+     * Events of loaded nets if +load_deferred_events+.
+     */
+    InputBuffer input_buffer;
+
+    /*
+     * The input streams ordered by the time of their next event.
+     */
+    BinaryHeap<InputStream*, MemoryAllocator<InputStream*>, InputStream> input_pq;
+
+    /*
+     * Loaded spike files, which are decoded by their streams during
+     * the simulation.
+     */
+    std::vector<SpikeFile*> input_files;
+
+    /*
+     * Pass the events of the input streams up to +until+ to their
+     * entities.
+     */
+    void input_feed(simtime until);
+
+    /*
+     * Add the streams of the events added to +input_buffer+ by the
+     * last load.
+     */
+    void input_finish();
+
+    inline simtime
+      input_next_at() const
+      {
+        return (this->input_pq.empty() ? INFINITY : this->input_pq.top()->at);
+      }
+
   public:
 
     /*
      * Constructor
      */
     Simulator();
+    ~Simulator();
 
     /*
-     * Load the neural net from +filename+.
+     * Add +stream+, whose events are passed to it's entity as the
+     * simulation reaches them. The Simulator deletes the stream once
+     * it is exhausted.
+     */
+    void input_add(InputStream *stream);
+
+    /*
+     * Load the neural net from +filename+. The file is either in the
+     * "yinspire.c" JSON format or a binary net file (see NetFile).
      */
     void load(const char *filename);
 
+    /*
+     * Add the entities, connections and events of the net in
+     * +filename+ to the already loaded (and maybe partly simulated)
+     * net. Existing entities are not touched, except for connections
+     * from or to them, so the cost only depends on the size of the
+     * merged net.
+     *
+     * The ids of the merged entities are prefixed with +prefix+ (if
+     * not NULL) to avoid collisions. Ids in connections and events
+     * refer to the merged entities first, and to the existing ones if
+     * there is no merged entity of that name. The times of the events
+     * are relative to the current time. If merging fails, the
+     * entities merged so far remain in the net.
+     */
+    void merge(const char *filename, const char *prefix=NULL);
+
     /*
      * Start the simulation.
      */
@@ -86,13 +202,45 @@ class Simulator
 
     /*
      * Register an entity type and the corresponding +factory+ function.
+     * If given, +shared_factory+ allocates entities of the same type
+     * that can share parameters (see NeuralEntity::load_shared).
+     */
+    void entity_register_type(const char *type, entity_factory_t factory,
+        entity_factory_t shared_factory=NULL);
+
+    /*
+     * Allocate an entity of the specified +type+, one created by the
+     * shared factory of the type if +shared+ and there is one.
+     */
+    NeuralEntity *entity_allocate(const char *type, bool shared=false);
+
+    /*
+     * Allocate an entity of the specified +type+ and add it to the
+     * net. If +id+ is NULL, the entity is anonymous and cannot be
+     * looked up, which avoids the cost of maintaining +entities+ when
+     * creating lots of entities during a simulation.
      */
-    void entity_register_type(const char *type, entity_factory_t factory);
+    NeuralEntity *entity_create(const char *type, const char *id);
 
     /*
-     * Allocate an entity of the specified +type+.
+     * Disconnect +entity+ from all other entities, remove it from the
+     * schedule and release it. Pending stimuli of +entity+ are
+     * dropped. The anonymous synapses of a Neuron are destroyed with
+     * it, as they could not be connected again.
+     *
+     * It's safe to call this from within process() or stimulate() of
+     * any entity (including +entity+ itself) as during a run() the
+     * memory is released only after the current entity has been
+     * processed.
      */
-    NeuralEntity *entity_allocate(const char *type);
+    void entity_destroy(NeuralEntity *entity);
+
+    /*
+     * Create an anonymous Synapse connecting +pre+ with +post+.
+     *
+     * O(1)
+     */
+    Synapse *synapse_create(Neuron *pre, Neuron *post, real weight, simtime delay);
 
     /*
      * If an entity has changed it's scheduling time,
@@ -101,16 +249,341 @@ class Simulator
      */
     void schedule_update(NeuralEntity *entity);
 
+    /*
+     * Create the outgoing connections of +entity+ of a lazily loaded
+     * net (see NeuralEntity::connections_pending).
+     */
+    void entity_connect_pending(NeuralEntity *entity);
+
+    /*
+     * Create all entities and connections of a lazily loaded net.
+     */
+    void entity_materialize_all();
+
     /*
      * Notify that a fire event has happened
      */
-    void stat_record_fire_event(simtime at, NeuralEntity *source);
+    void stat_record_fire_event(simtime at, NeuralEntity *source, real weight=INFINITY);
+
+    /*
+     * Record all fire events into a FireLog in +filename+ until
+     * record_close() is called.
+     */
+    void record_open(const char *filename);
+
+    /*
+     * Write the ids of the entities to the fire log and close it.
+     */
+    void record_close();
+
+    /*
+     * Compute statistics of all fire events from now on (see
+     * SpikeStats), with a population histogram of +bin_width+ and the
+     * correlations of the entities with +correlate+ ids.
+     */
+    void stats_open(simtime bin_width, const std::set<std::string> &correlate);
+
+    /*
+     * Write the statistics up to the current time to +filename+ ("-"
+     * for stdout). Can be called repeatedly, e.g. at checkpoints.
+     */
+    void stats_write(const char *filename);
+
+    /*
+     * Count the fire events of each (recorded) Neuron from now on,
+     * in windows of +window+ up to +until+ (INFINITY for a single
+     * window). Fire events after +until+ count into the last window.
+     */
+    void counts_open(simtime window, simtime until);
+
+    /*
+     * Write the fire counts of the recorded Neurons to +filename+
+     * ("-" for stdout), one line per entity: the id followed by the
+     * count of each window.
+     */
+    void counts_write(const char *filename);
+
+  protected:
+
+    void release_destroyed_entities();
+    void run_until(simtime stop_at, simtime window);
+
+    void load_json(const char *filename);
+    void load_json_parallel(const char *filename);
+    void load_json_events(const jsonNode *events, const uint *event_ids);
+    void load_stream(NetFormat format, const char *filename);
+    void load_json_pipelined(const char *filename);
+    void load_net_file(const char *filename);
+    void load_spike_file(const char *filename);
+
+    /*
+     * Lookup the entity with +id+. Throws if there is none.
+     */
+    NeuralEntity *entity_find(const char *id, size_t len);
+    NeuralEntity *entity_find(const std::string &id) { return entity_find(id.data(), id.size()); }
+
+    /*
+     * The entity with +index+ or NULL. Entities of a lazily loaded
+     * net are created on demand.
+     */
+    NeuralEntity *entity_at(uint index);
+
+    /*
+     * Like entity_at, but returns the prototype of the template for
+     * an entity of a lazily loaded net that was not created yet,
+     * instead of creating it. The prototype has the state the entity
+     * would be created with and must not be modified.
+     */
+    NeuralEntity *entity_or_prototype(uint index);
+
+    /*
+     * Lookup the index of the entity with +id+ as used in the net
+     * being loaded, i.e. with +load_prefix+ if there is such an
+     * entity. Throws if there is none.
+     */
+    uint entity_resolve_index(const char *id, size_t len);
+    uint entity_resolve_index(const std::string &id) { return entity_resolve_index(id.data(), id.size()); }
+
+    NeuralEntity *entity_resolve(const char *id, size_t len);
+    NeuralEntity *entity_resolve(const std::string &id) { return entity_resolve(id.data(), id.size()); }
+
+    /*
+     * Connect entity +from+ with entity +to+ (by index) while loading.
+     * If +from+ belongs to the lazily loaded net, the connection is
+     * only recorded.
+     */
+    void load_connect(uint from, uint to);
+
+    /*
+     * Connect the entities of the connection lists in +resolved+ (the
+     * source of list i at start[i], it's targets up to start[i+1]) on
+     * +load_threads+ threads.
+     */
+    void load_connect_parallel(const std::vector<uint> &resolved, const std::vector<uint32_t> &start);
+
+    /*
+     * Stimulate entity +index+ at +at+ (plus +load_time_offset+) while
+     * loading, or keep the event in +input_buffer+ if
+     * +load_deferred_events+.
+     */
+    void load_event(uint index, simtime at, real weight);
+
+    /*
+     * Register +entity+ under +id+ (if not NULL). Deletes +entity+ and
+     * throws if the id is already in use.
+     */
+    void entity_register(NeuralEntity *entity, const char *id);
+
+    /*
+     * A template of the net being loaded. The +prototype+ is loaded
+     * from +data+ on first use and copied for each entity of the
+     * template.
+     *
+     * +shared_params+ is the parameter block shared by the entities
+     * of the template if +load_shared_params+. The template holds a
+     * reference to it until it is released.
+     */
+    struct EntityTemplate
+    {
+      std::string name;
+      std::string type;
+      jsonHash *data;
+      NeuralEntity *prototype;
+      void *shared_params;
+
+      /*
+       * Index of the copy of this template in LazyNet::templates (or
+       * ENTITY_NO_INDEX).
+       */
+      uint lazy_template;
+    };
+
+    void template_init(EntityTemplate &t, const std::string &name, const std::string &type, jsonHash *data);
+    void template_release(EntityTemplate &t);
+
+    /*
+     * Add the templates of a JSON net to +template_map+, or create the
+     * entity of +entity_spec+ (id, template name and optional
+     * properties).
+     */
+    void load_json_templates(const jsonNode *templates, std::map<std::string, EntityTemplate> &template_map);
+    void load_json_entity(const jsonNode *entity_spec, std::map<std::string, EntityTemplate> &template_map);
+
+    /*
+     * The prototype of template +t+, loaded on first use.
+     */
+    NeuralEntity *template_prototype(EntityTemplate &t);
+
+    /*
+     * Load +entity+ from the data of template +t+, sharing it's
+     * immutable parameters if +load_shared_params+.
+     */
+    void entity_load(NeuralEntity *entity, EntityTemplate &t);
+
+    /*
+     * Create an (unregistered) entity of template +t+ by cloning it's
+     * prototype. Types that do not implement clone() themselves are
+     * allocated and loaded instead.
+     */
+    NeuralEntity *template_instantiate(EntityTemplate &t);
+
+    /*
+     * Create entity +id+ (prefixed with +load_prefix+) of template +t+
+     * and return it's index. If +overrides+ is given, the entity is
+     * loaded from the properties of the template merged with
+     * +overrides+. Otherwise it's a copy of the template's prototype,
+     * which is created on demand if +lazy_loading+.
+     */
+    uint entity_create_from(EntityTemplate &t, const char *id, jsonHash *overrides=NULL);
+
+    /*
+     * The entities of the net loaded with +load_lazy+, which are
+     * created on first use by entity_at().
+     *
+     * Entity +first+ + i is a copy of
+     * templates[entity_templates[i]] and is connected to the entities
+     * connection_targets[connection_index[i] ... connection_index[i+1]-1]
+     * once it uses it's connections (see entity_connect_pending).
+     * The templates are released when the Simulator is destroyed.
+     */
+    struct LazyNet
+    {
+      uint first;
+      std::vector<EntityTemplate> templates;
+      std::vector<uint32_t> entity_templates;
+      std::vector<bool> materialized;
+      std::vector<uint32_t> connection_index;
+      std::vector<uint32_t> connection_targets;
+
+      /*
+       * The (from, to) connections while loading.
+       */
+      std::vector<std::pair<uint32_t, uint32_t> > connections;
+    };
+
+    LazyNet *lazy_net;
+
+    /*
+     * True while the entities of +lazy_net+ are loaded.
+     */
+    bool lazy_loading;
+
+    void lazy_add_entity(uint index, uint lazy_template);
+    void lazy_finish();
+
+    /*
+     * Whether entity +index+ belongs to +lazy_net+ and has not been
+     * created yet.
+     */
+    inline bool
+      entity_is_lazy(uint index) const
+      {
+        return (this->lazy_net != NULL && index >= this->lazy_net->first &&
+            index - this->lazy_net->first < this->lazy_net->materialized.size() &&
+            !this->lazy_net->materialized[index - this->lazy_net->first]);
+      }
+
+    NeuralEntity *entity_materialize(uint index);
+
+    /*
+     * The fire log (or NULL), see record_open.
+     */
+    FireLogWriter *fire_log;
+
+    /*
+     * The fire statistics (or NULL), see stats_open.
+     */
+    SpikeStats *spike_stats;
+
+    /*
+     * The fire counts (empty if not counting), see counts_open. Only
+     * Neurons are counted, each in a slot: +fire_count_slots+ maps
+     * entity indices to slots (or ENTITY_NO_INDEX) and
+     * +fire_count_ids+ slots back to entity indices. The count of
+     * slot s in window w is at w * fire_count_ids.size() + s.
+     */
+    std::vector<uint> fire_counts;
+    std::vector<uint> fire_count_slots;
+    std::vector<uint> fire_count_ids;
+    uint fire_count_windows;
+    simtime fire_count_window;
+
+    /*
+     * Apply +record_ids+ to +entity+ with +id+ (NULL if anonymous).
+     */
+    inline void
+      record_select(NeuralEntity *entity, const char *id)
+      {
+        if (!this->record_ids.empty() && (id == NULL || this->record_ids.count(id) == 0))
+        {
+          entity->recorded = false;
+        }
+      }
 
   public:
 
     uint stat_fire_counter;
     uint stat_event_counter;
 
+    /*
+     * If true, entities loaded from the same template share their
+     * immutable parameters (see NeuralEntity::load_shared).
+     */
+    bool load_shared_params;
+
+    /*
+     * If true, JSON nets are loaded with a NetStreamParser instead of
+     * building a DOM first. This requires the sections of the net to
+     * be in order (see NetStreamParser).
+     */
+    bool load_streaming;
+
+    /*
+     * If true, JSON nets are loaded with a NetStreamPipeline, so that
+     * reading, parsing and creating the entities overlap. The time
+     * spent in each stage is stored in +load_times+. Implies
+     * +load_streaming+.
+     */
+    bool load_pipelined;
+    NetPipelineTimes load_times;
+
+    /*
+     * If true, the entities of the (first) loaded net are only
+     * created when they are stimulated or looked up, and their
+     * outgoing connections when they are used. Until then they take
+     * a few bytes each. Connections to an entity from entities which
+     * are not created yet do not exist, which matters only for
+     * entities that use their incoming connections (e.g. hebb
+     * Neurons).
+     */
+    bool load_lazy;
+
+    /*
+     * If true, the events of loaded nets are not passed to their
+     * entities when loading, but only shortly before the simulation
+     * reaches them (see InputStream). Events that fall into the
+     * refractory period of a Neuron are then dropped right away and
+     * not counted in +stat_event_counter+, like stimuli from Synapses.
+     */
+    bool load_deferred_events;
+
+    /*
+     * If not empty, only the fire events of the entities with one of
+     * these ids (types) are recorded. Both apply to the entities
+     * created afterwards, so they have to be set before loading.
+     */
+    std::set<std::string> record_ids;
+    std::set<std::string> record_types;
+
+    /*
+     * Number of threads used to load a JSON net (without
+     * +load_streaming+): the entities, connections and events are
+     * parsed, the entities cloned from their templates, the ids
+     * resolved and the entities connected in parallel. Registering the
+     * entities and applying the events stay sequential.
+     */
+    uint load_threads;
+
 };
 
 #endif
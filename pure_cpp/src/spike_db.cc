@@ -0,0 +1,348 @@
+#include "spike_db.h"
+#include "fire_log.h"
+#include "text_reader.h"
+#include "stimulus.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+SpikeDb::SpikeDb(const char *filename) : file(filename, sizeof(SpikeDbHeader), "invalid spike database")
+{
+  this->file.check_header(SPIKE_DB_MAGIC, SPIKE_DB_VERSION, SPIKE_DB_BYTE_ORDER, "unsupported spike database version");
+  this->header = (SpikeDbHeader*) this->file.mem;
+
+  SpikeDbHeader *h = this->header;
+  this->neuron_ids = (uint32_t*) this->file.section(h->off_neuron_ids, h->num_neurons, sizeof(uint32_t));
+  this->index = (uint64_t*) this->file.section(h->off_index, (uint64_t)h->num_neurons+1, sizeof(uint64_t));
+  this->times = (float*) this->file.section(h->off_times, h->num_spikes, sizeof(float));
+  this->weights = (float*) this->file.section(h->off_weights, h->num_spikes, sizeof(float));
+  this->raster = (SpikeDbEvent*) this->file.section(h->off_raster, h->num_spikes, sizeof(SpikeDbEvent));
+  this->strings = (const char*) this->file.section(h->off_strings, h->strings_size, 1);
+
+  if (this->index == NULL || this->index[h->num_neurons] != h->num_spikes ||
+      (h->num_neurons > 0 && this->neuron_ids == NULL) ||
+      (h->num_spikes > 0 && (this->times == NULL || this->raster == NULL)) ||
+      (h->strings_size > 0 && (this->strings == NULL || this->strings[h->strings_size-1] != '\0')))
+  {
+    throw "invalid spike database";
+  }
+  for (uint32_t i = 0; i < h->num_neurons; i++)
+  {
+    if (this->index[i] > this->index[i+1] || this->neuron_ids[i] >= h->strings_size)
+    {
+      throw "invalid spike database";
+    }
+  }
+  for (uint64_t s = 0; s < h->num_spikes; s++)
+  {
+    if (this->raster[s].neuron >= h->num_neurons)
+    {
+      throw "invalid spike database";
+    }
+  }
+}
+
+SpikeDb::~SpikeDb()
+{
+}
+
+bool
+SpikeDb::is_spike_db(const char *filename)
+{
+  return MappedFile::has_magic(filename, SPIKE_DB_MAGIC);
+}
+
+uint32_t
+SpikeDb::find(const char *id) const
+{
+  uint32_t lo = 0, hi = this->header->num_neurons;
+
+  while (lo < hi)
+  {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    const int cmp = strcmp(this->id(mid), id);
+    if (cmp == 0) return mid;
+    if (cmp < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  return SPIKE_DB_NONE;
+}
+
+void
+SpikeDb::spikes(uint32_t neuron, simtime from, simtime to, uint64_t &first, uint64_t &count) const
+{
+  const float *begin = this->times + this->index[neuron];
+  const float *end = this->times + this->index[neuron+1];
+  const float *lo = std::lower_bound(begin, end, from);
+  const float *hi = std::lower_bound(lo, end, MAX(from, to));
+
+  first = lo - this->times;
+  count = hi - lo;
+}
+
+static bool
+event_before(const SpikeDbEvent &e, simtime at)
+{
+  return e.at < at;
+}
+
+void
+SpikeDb::window(simtime from, simtime to, uint64_t &first, uint64_t &count) const
+{
+  const SpikeDbEvent *begin = this->raster;
+  const SpikeDbEvent *end = this->raster + this->header->num_spikes;
+  const SpikeDbEvent *lo = std::lower_bound(begin, end, from, event_before);
+  const SpikeDbEvent *hi = std::lower_bound(lo, end, MAX(from, to), event_before);
+
+  first = lo - begin;
+  count = hi - lo;
+}
+
+SpikeDbWriter::SpikeDbWriter()
+{
+  this->has_weights = false;
+}
+
+SpikeDbWriter::~SpikeDbWriter()
+{
+}
+
+uint32_t
+SpikeDbWriter::neuron(const std::string &id)
+{
+  const uint32_t n = this->id_map.size();
+  return this->id_map.insert(std::make_pair(id, n)).first->second;
+}
+
+void
+SpikeDbWriter::add_spike(uint32_t neuron, simtime at, real weight)
+{
+  if (!this->has_weights && (!isinf(weight) || weight < 0.0))
+  {
+    // the spikes so far had no weight
+    this->has_weights = true;
+    this->weights.resize(this->spikes.size(), INFINITY);
+  }
+  if (this->has_weights) this->weights.push_back(weight);
+
+  SpikeDbEvent e;
+  e.at = at;
+  e.neuron = neuron;
+  this->spikes.push_back(e);
+}
+
+void
+SpikeDbWriter::add(const std::string &id, simtime at, real weight)
+{
+  add_spike(neuron(id), at, weight);
+}
+
+/*
+ * Entities are looked up by id only once. Fire events of anonymous
+ * entities are skipped.
+ */
+void
+SpikeDbWriter::add_fire_log(const char *filename)
+{
+  FireLogReader log(filename);
+  FireLogRecord r;
+  std::vector<uint32_t> neurons;
+  char buf[16];
+
+  while (log.next(r))
+  {
+    if (r.entity == ENTITY_NO_INDEX) continue;
+
+    if (r.entity >= neurons.size()) neurons.resize(r.entity + 1, SPIKE_DB_NONE);
+    if (neurons[r.entity] == SPIKE_DB_NONE)
+    {
+      const char *id = log.id(r.entity);
+      if (id == NULL)
+      {
+        // not closed, use the index
+        snprintf(buf, sizeof(buf), "%u", r.entity);
+        id = buf;
+      }
+      neurons[r.entity] = neuron(id);
+    }
+
+    add_spike(neurons[r.entity], r.at, r.weight);
+  }
+}
+
+void
+SpikeDbWriter::add_text_log(const char *filename)
+{
+  TextReader r(filename);
+  std::string id;
+
+  while (r.peek() != -1)
+  {
+    if (r.skip('\n')) continue;
+
+    r.read_until('\t', id);
+    r.skip_blanks();
+    const double weight = r.read_number();
+    r.skip_blanks();
+    if (!r.skip('@')) r.error("\"@\" expected");
+    r.skip_blanks();
+    const double at = r.read_number();
+    r.skip_blanks();
+    r.skip('\r');
+    if (r.peek() != -1 && !r.skip('\n')) r.error("end of line expected");
+
+    if (!id.empty()) add(id, at, weight);
+  }
+}
+
+template <typename T>
+static inline const T *
+data_of(const std::vector<T> &v)
+{
+  return (v.empty() ? NULL : &v[0]);
+}
+
+/*
+ * Write the times (or the +weights+) of +events+ as float section
+ * through a small buffer instead of a copy of all of them. All chunks
+ * but the last have an even number of floats, so only the last one is
+ * padded.
+ */
+static uint64_t
+write_events(FILE *f, uint64_t &pos, const std::vector<Stimulus> &events, bool weights)
+{
+  float buf[4096];
+  const uint64_t offset = pos;
+
+  for (uint64_t s = 0; s < events.size(); )
+  {
+    uint n = 0;
+    for (; n < 4096 && s < events.size(); n++, s++)
+    {
+      buf[n] = (weights ? events[s].weight : events[s].at);
+    }
+    write_section(f, pos, buf, n, sizeof(float));
+  }
+
+  return offset;
+}
+
+static bool
+stimulus_less(const Stimulus &a, const Stimulus &b)
+{
+  return Stimulus::less(a, b);
+}
+
+static bool
+event_less(const SpikeDbEvent &a, const SpikeDbEvent &b)
+{
+  return a.at < b.at;
+}
+
+/*
+ * The spikes are taken out of the writer, so that they are not kept
+ * twice: the raster is sorted in place and the per neuron events only
+ * live until their sections are written.
+ */
+void
+SpikeDbWriter::write(const char *filename)
+{
+  SpikeDbHeader h;
+  memset(&h, 0, sizeof(h));
+
+  std::map<std::string, uint32_t> id_map;
+  std::vector<SpikeDbEvent> raster;
+  std::vector<real> weights;
+  const bool has_weights = this->has_weights;
+  id_map.swap(this->id_map);
+  raster.swap(this->spikes);
+  weights.swap(this->weights);
+  this->has_weights = false;
+
+  const uint32_t num_neurons = id_map.size();
+  const uint64_t num_spikes = raster.size();
+
+  /*
+   * Neurons are numbered in the order of their ids, which is the
+   * order of the map (std::string compares like strcmp).
+   */
+  std::vector<uint32_t> rank(num_neurons);
+  std::vector<uint32_t> neuron_ids(num_neurons);
+  std::string strings;
+  uint32_t n = 0;
+  for (std::map<std::string, uint32_t>::iterator it = id_map.begin(); it != id_map.end(); ++it, ++n)
+  {
+    rank[it->second] = n;
+    neuron_ids[n] = strings.size();
+    strings.append(it->first.c_str(), it->first.size() + 1);
+  }
+  id_map.clear();
+
+  std::vector<uint64_t> index(num_neurons + 1, 0);
+  for (uint64_t s = 0; s < num_spikes; s++)
+  {
+    raster[s].neuron = rank[raster[s].neuron];
+    ++index[raster[s].neuron + 1];
+  }
+  for (uint32_t i = 0; i < num_neurons; i++) index[i+1] += index[i];
+
+  std::vector<Stimulus> events(num_spikes);
+  {
+    std::vector<uint64_t> fill(index.begin(), index.end() - 1);
+    for (uint64_t s = 0; s < num_spikes; s++)
+    {
+      Stimulus &e = events[fill[raster[s].neuron]++];
+      e.at = raster[s].at;
+      e.weight = (has_weights ? weights[s] : INFINITY);
+    }
+  }
+  std::vector<real>().swap(weights);
+
+  for (uint32_t i = 0; i < num_neurons; i++)
+  {
+    std::stable_sort(events.begin() + index[i], events.begin() + index[i+1], stimulus_less);
+  }
+
+  FILE *f = fopen(filename, "wb");
+  if (f == NULL) throw "cannot open file";
+
+  try
+  {
+    /*
+     * Write a dummy header first, then all sections and finally the
+     * real header.
+     */
+    uint64_t pos = 0;
+    write_section(f, pos, &h, 1, sizeof(h));
+
+    memcpy(h.magic, SPIKE_DB_MAGIC, 8);
+    h.version = SPIKE_DB_VERSION;
+    h.byte_order = SPIKE_DB_BYTE_ORDER;
+    h.num_neurons = num_neurons;
+    h.num_spikes = num_spikes;
+    h.strings_size = strings.size();
+
+    h.off_neuron_ids = write_section(f, pos, data_of(neuron_ids), num_neurons, sizeof(uint32_t));
+    h.off_index = write_section(f, pos, data_of(index), num_neurons+1, sizeof(uint64_t));
+    h.off_times = write_events(f, pos, events, false);
+    if (has_weights)
+    {
+      h.off_weights = write_events(f, pos, events, true);
+    }
+    std::vector<Stimulus>().swap(events);
+
+    std::stable_sort(raster.begin(), raster.end(), event_less);
+    h.off_raster = write_section(f, pos, data_of(raster), num_spikes, sizeof(SpikeDbEvent));
+    h.off_strings = write_section(f, pos, strings.data(), h.strings_size, 1);
+
+    write_header(f, &h, sizeof(h));
+  }
+  catch (...)
+  {
+    fclose(f);
+    throw;
+  }
+  if (fclose(f) != 0) throw "write failed";
+}
@@ -0,0 +1,180 @@
+#ifndef __YINSPIRE__SPIKE_DB__
+#define __YINSPIRE__SPIKE_DB__
+
+#include "types.h"
+#include "mapped_file.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+/*
+ * An indexed store of the fire events of a run, which can be mapped
+ * into memory and queried without reading or copying it:
+ *
+ *   - the spikes of a neuron between two times: O(log n + k)
+ *   - all spikes between two times (raster): O(log n + k)
+ *
+ * Layout (all sections 8 byte aligned, native byte order):
+ *
+ *   SpikeDbHeader
+ *   neuron_ids  uint32_t[num_neurons]       (string offsets, sorted by id)
+ *   index       uint64_t[num_neurons+1]     (CSR)
+ *   times       float[num_spikes]           (sorted per neuron)
+ *   weights     float[num_spikes]           (optional, default Infinity)
+ *   raster      SpikeDbEvent[num_spikes]    (sorted by time)
+ *   strings     NUL-terminated strings
+ *
+ * The spikes of neuron i are times[index[i] ... index[i+1]-1].
+ */
+
+#define SPIKE_DB_MAGIC "YINSPKDB"
+#define SPIKE_DB_VERSION 1
+#define SPIKE_DB_BYTE_ORDER 0x01020304
+
+/*
+ * Returned by SpikeDb::find for unknown ids.
+ */
+#define SPIKE_DB_NONE 0xFFFFFFFF
+
+struct SpikeDbHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+
+  uint32_t num_neurons;
+  uint32_t reserved;
+  uint64_t num_spikes;
+  uint64_t strings_size;
+
+  uint64_t off_neuron_ids;
+  uint64_t off_index;
+  uint64_t off_times;
+  uint64_t off_weights;
+  uint64_t off_raster;
+  uint64_t off_strings;
+};
+
+struct SpikeDbEvent
+{
+  simtime at;
+  uint32_t neuron;
+};
+
+/*
+ * Read access to a spike database. The file is mapped into memory (or
+ * read, if compiled WITHOUT_MMAP) and stays there until the SpikeDb
+ * is destroyed.
+ */
+class SpikeDb
+{
+  protected:
+
+    MappedFile file;
+
+  public:
+
+    SpikeDbHeader *header;
+    uint32_t *neuron_ids;
+    uint64_t *index;
+    float *times;
+    float *weights;
+    SpikeDbEvent *raster;
+    const char *strings;
+
+    SpikeDb(const char *filename);
+    ~SpikeDb();
+
+    /*
+     * Returns true if +filename+ starts with SPIKE_DB_MAGIC.
+     */
+    static bool is_spike_db(const char *filename);
+
+    inline const char *
+      id(uint32_t neuron) const
+      {
+        return this->strings + this->neuron_ids[neuron];
+      }
+
+    /*
+     * The neuron with +id+ or SPIKE_DB_NONE.
+     *
+     * O(log n)
+     */
+    uint32_t find(const char *id) const;
+
+    /*
+     * The spikes of +neuron+ with from <= at < to, which are
+     * times[first ... first+count-1] (and weights).
+     *
+     * O(log n)
+     */
+    void spikes(uint32_t neuron, simtime from, simtime to, uint64_t &first, uint64_t &count) const;
+
+    /*
+     * The spikes of all neurons with from <= at < to, which are
+     * raster[first ... first+count-1].
+     *
+     * O(log n)
+     */
+    void window(simtime from, simtime to, uint64_t &first, uint64_t &count) const;
+};
+
+/*
+ * Builds a spike database from fire events, e.g. from a FireLog or a
+ * text log as written by bin/yinspire ("id\tweight@at" per line).
+ *
+ * Keeps 8 bytes per spike (12 once a spike has a weight) and about
+ * twice that while writing.
+ */
+class SpikeDbWriter
+{
+  protected:
+
+    /*
+     * Neuron numbers by id, in the order the neurons were added.
+     */
+    std::map<std::string, uint32_t> id_map;
+
+    /*
+     * The spikes in the order they were added, and their weights if
+     * any of them has one.
+     */
+    std::vector<SpikeDbEvent> spikes;
+    std::vector<real> weights;
+    bool has_weights;
+
+  public:
+
+    SpikeDbWriter();
+    ~SpikeDbWriter();
+
+    /*
+     * Add a fire event of neuron +id+.
+     */
+    void add(const std::string &id, simtime at, real weight);
+
+    /*
+     * Add the fire events of the FireLog in +filename+.
+     */
+    void add_fire_log(const char *filename);
+
+    /*
+     * Add the fire events of the text log in +filename+.
+     */
+    void add_text_log(const char *filename);
+
+    /*
+     * Write the fire events added so far to +filename+. The writer is
+     * empty afterwards.
+     */
+    void write(const char *filename);
+
+  protected:
+
+    uint32_t neuron(const std::string &id);
+    void add_spike(uint32_t neuron, simtime at, real weight);
+};
+
+#endif
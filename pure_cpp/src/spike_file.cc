@@ -0,0 +1,336 @@
+#include "spike_file.h"
+#include "stimulus.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+SpikeFile::SpikeFile(const char *filename) : file(filename, sizeof(SpikeFileHeader), "invalid spike file")
+{
+  this->file.check_header(SPIKE_FILE_MAGIC, SPIKE_FILE_VERSION, SPIKE_FILE_BYTE_ORDER, "unsupported spike file version");
+  this->header = (SpikeFileHeader*) this->file.mem;
+
+  SpikeFileHeader *h = this->header;
+  this->trains = (SpikeFileTrain*) this->file.section(h->off_trains, h->num_trains, sizeof(SpikeFileTrain));
+  this->data = (const uint8_t*) this->file.section(h->off_data, h->data_size, 1);
+  this->strings = (const char*) this->file.section(h->off_strings, h->strings_size, 1);
+
+  if (h->strings_size > 0 && this->strings[h->strings_size-1] != '\0')
+  {
+    throw "invalid spike file";
+  }
+
+  if ((h->num_trains > 0 && this->trains == NULL) || (h->data_size > 0 && this->data == NULL) ||
+      (h->strings_size > 0 && this->strings == NULL))
+  {
+    throw "invalid spike file";
+  }
+
+  for (uint32_t t = 0; t < h->num_trains; t++)
+  {
+    const SpikeFileTrain &train = this->trains[t];
+    if (train.offset > h->data_size || train.size > h->data_size - train.offset ||
+        train.id >= h->strings_size ||
+        !valid_train(this->data + train.offset, train.size, train.num_spikes,
+          (train.flags & SPIKE_FILE_WEIGHTS) != 0))
+    {
+      throw "invalid spike file";
+    }
+  }
+}
+
+/*
+ * Check that the +size+ bytes at +pos+ hold +num_spikes+ complete
+ * spikes, so that a Stream never runs into invalid data while the
+ * simulation runs.
+ */
+bool
+SpikeFile::valid_train(const uint8_t *pos, uint64_t size, uint32_t num_spikes, bool weighted)
+{
+  const uint8_t *end = pos + size;
+
+  for (uint32_t i = 0; i < num_spikes; i++)
+  {
+    for (uint shift = 0; ; shift += 7)
+    {
+      if (pos == end || shift > 63) return false;
+      if ((*pos++ & 0x80) == 0) break;
+    }
+
+    if (weighted)
+    {
+      if (end - pos < (long)sizeof(float)) return false;
+      pos += sizeof(float);
+    }
+  }
+  return true;
+}
+
+SpikeFile::~SpikeFile()
+{
+}
+
+bool
+SpikeFile::is_spike_file(const char *filename)
+{
+  return MappedFile::has_magic(filename, SPIKE_FILE_MAGIC);
+}
+
+void
+SpikeFile::parse_file(const char *filename, NetStreamHandler *handler)
+{
+  SpikeFile file(filename);
+
+  for (uint32_t t = 0; t < file.header->num_trains; t++)
+  {
+    if (file.trains[t].num_spikes == 0) continue;
+
+    Stream stream(&file, t, 0, 0.0);
+    handler->on_events(file.string(file.trains[t].id));
+    do
+    {
+      handler->on_event(stream.at, stream.weight);
+    } while (stream.next());
+  }
+}
+
+SpikeFile::Stream::Stream(const SpikeFile *file, uint32_t train, uint entity, simtime offset)
+{
+  const SpikeFileTrain &t = file->trains[train];
+
+  this->pos = file->data + t.offset;
+  this->remaining = t.num_spikes;
+  this->tick = t.first_tick;
+  this->resolution = file->header->resolution;
+  this->offset = offset;
+  this->weighted = (t.flags & SPIKE_FILE_WEIGHTS) != 0;
+  this->entity = entity;
+
+  if (!next()) throw "empty spike train";
+}
+
+bool
+SpikeFile::Stream::next()
+{
+  if (this->remaining == 0) return false;
+  --this->remaining;
+
+  uint64_t delta = 0;
+  for (uint shift = 0; ; shift += 7)
+  {
+    const uint8_t b = *this->pos++;
+    delta |= (uint64_t)(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) break;
+  }
+  this->tick += (int64_t)delta;
+  this->at = (simtime)(this->tick * this->resolution) + this->offset;
+
+  if (this->weighted)
+  {
+    memcpy(&this->weight, this->pos, sizeof(float));
+    this->pos += sizeof(float);
+  }
+  else
+  {
+    this->weight = INFINITY;
+  }
+  return true;
+}
+
+SpikeFileWriter::SpikeFileWriter()
+{
+  this->current_train = NULL;
+  this->resolution = 0.0;
+}
+
+void
+SpikeFileWriter::on_template(const std::string &name, const std::string &type, jsonHash *data)
+{
+  throw "spike files contain only spike trains";
+}
+
+void
+SpikeFileWriter::on_entity(const std::string &id, const std::string &template_name, jsonHash *data)
+{
+  throw "spike files contain only spike trains";
+}
+
+void
+SpikeFileWriter::on_connections(const std::string &from)
+{
+  throw "spike files contain only spike trains";
+}
+
+void
+SpikeFileWriter::on_connection(const std::string &to)
+{
+  throw "spike files contain only spike trains";
+}
+
+void
+SpikeFileWriter::on_events(const std::string &id)
+{
+  std::map<std::string, uint32_t>::iterator it = this->train_map.find(id);
+  if (it == this->train_map.end())
+  {
+    it = this->train_map.insert(std::make_pair(id, (uint32_t)this->trains.size())).first;
+    this->trains.push_back(Train());
+    this->trains.back().id = id;
+    this->trains.back().has_weights = false;
+  }
+  this->current_train = &this->trains[it->second];
+}
+
+void
+SpikeFileWriter::on_event(simtime at, real weight)
+{
+  Train &t = *this->current_train;
+
+  if (isnan(at) || isinf(at)) throw "invalid spike time";
+
+  if (!t.has_weights && (!isinf(weight) || weight < 0.0))
+  {
+    // the spikes so far had no weight
+    t.has_weights = true;
+    t.weights.resize(t.times.size(), INFINITY);
+  }
+  if (t.has_weights) t.weights.push_back(weight);
+  t.times.push_back(at);
+}
+
+/*
+ * The coarsest resolution (1 down to 1e-12) with which every spike time
+ * is an integral number of ticks, i.e. decodes to the same simtime.
+ */
+double
+SpikeFileWriter::exact_resolution() const
+{
+  for (int digits = 0; digits <= 12; digits++)
+  {
+    const double res = pow(10.0, -digits);
+    bool exact = true;
+
+    for (uint i = 0; i < this->trains.size() && exact; i++)
+    {
+      const std::vector<float> &times = this->trains[i].times;
+      for (uint j = 0; j < times.size(); j++)
+      {
+        const double ticks = floor(times[j] / res + 0.5);
+        if (fabs(ticks) > 4e18 || (simtime)((int64_t)ticks * res) != times[j])
+        {
+          exact = false;
+          break;
+        }
+      }
+    }
+
+    if (exact) return res;
+  }
+  throw "spike times cannot be represented exactly";
+}
+
+static bool
+stimulus_less(const Stimulus &a, const Stimulus &b)
+{
+  return Stimulus::less(a, b);
+}
+
+static void
+append_varint(std::vector<uint8_t> &out, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    out.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t)value);
+}
+
+void
+SpikeFileWriter::write(const char *filename)
+{
+  SpikeFileHeader h;
+  memset(&h, 0, sizeof(h));
+
+  const double res = (this->resolution > 0.0 ? this->resolution : exact_resolution());
+
+  std::vector<SpikeFileTrain> trains(this->trains.size());
+  std::vector<uint8_t> data;
+  std::string strings;
+  std::vector<Stimulus> spikes;
+
+  for (uint i = 0; i < this->trains.size(); i++)
+  {
+    Train &t = this->trains[i];
+    SpikeFileTrain &out = trains[i];
+    const uint n = t.times.size();
+
+    memset(&out, 0, sizeof(out));
+    out.id = strings.size();
+    strings.append(t.id.c_str(), t.id.size() + 1);
+    out.flags = (t.has_weights ? SPIKE_FILE_WEIGHTS : 0);
+    out.num_spikes = n;
+    out.offset = data.size();
+
+    spikes.resize(n);
+    for (uint j = 0; j < n; j++)
+    {
+      spikes[j].at = t.times[j];
+      spikes[j].weight = (t.has_weights ? t.weights[j] : INFINITY);
+    }
+    std::stable_sort(spikes.begin(), spikes.end(), stimulus_less);
+
+    int64_t tick = (n > 0 ? (int64_t)floor(spikes[0].at / res + 0.5) : 0);
+    out.first_tick = tick;
+
+    for (uint j = 0; j < n; j++)
+    {
+      const int64_t next = (int64_t)floor(spikes[j].at / res + 0.5);
+      append_varint(data, (uint64_t)(next - tick));
+      tick = next;
+
+      if (t.has_weights)
+      {
+        const uint8_t *w = (const uint8_t*) &spikes[j].weight;
+        data.insert(data.end(), w, w + sizeof(float));
+      }
+    }
+
+    out.size = data.size() - out.offset;
+    h.num_spikes += n;
+  }
+
+  FILE *f = fopen(filename, "wb");
+  if (f == NULL) throw "cannot open file";
+
+  try
+  {
+    /*
+     * Write a dummy header first, then all sections and finally the
+     * real header.
+     */
+    uint64_t pos = 0;
+    write_section(f, pos, &h, 1, sizeof(h));
+
+    memcpy(h.magic, SPIKE_FILE_MAGIC, 8);
+    h.version = SPIKE_FILE_VERSION;
+    h.byte_order = SPIKE_FILE_BYTE_ORDER;
+    h.num_trains = trains.size();
+    h.resolution = res;
+    h.data_size = data.size();
+    h.strings_size = strings.size();
+
+    h.off_trains = write_section(f, pos, (trains.empty() ? NULL : &trains[0]), trains.size(), sizeof(SpikeFileTrain));
+    h.off_data = write_section(f, pos, (data.empty() ? NULL : &data[0]), data.size(), 1);
+    h.off_strings = write_section(f, pos, strings.data(), strings.size(), 1);
+
+    write_header(f, &h, sizeof(h));
+  }
+  catch (...)
+  {
+    fclose(f);
+    throw;
+  }
+  if (fclose(f) != 0) throw "write failed";
+}
@@ -0,0 +1,185 @@
+#ifndef __YINSPIRE__SPIKE_FILE__
+#define __YINSPIRE__SPIKE_FILE__
+
+#include "types.h"
+#include "mapped_file.h"
+#include "net_stream.h"
+#include "input_stream.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+/*
+ * A compact binary format for spike trains (see SpikeParser) which is
+ * decoded incrementally while the simulation runs.
+ *
+ * Layout (all sections 8 byte aligned, native byte order):
+ *
+ *   SpikeFileHeader
+ *   trains   SpikeFileTrain[num_trains]
+ *   data     the encoded spikes of all trains
+ *   strings  NUL-terminated ids
+ *
+ * The spikes of a train are in time order. Times are integral
+ * multiples ("ticks") of +resolution+. Each spike is stored as the
+ * number of ticks since the previous spike of the train (since
+ * +first_tick+ for the first one) as unsigned LEB128 varint, followed
+ * by it's weight as float if the train has SPIKE_FILE_WEIGHTS.
+ */
+
+#define SPIKE_FILE_MAGIC "YINSPIKE"
+#define SPIKE_FILE_VERSION 1
+#define SPIKE_FILE_BYTE_ORDER 0x01020304
+
+struct SpikeFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+
+  uint32_t num_trains;
+  uint32_t reserved;
+  uint64_t num_spikes;
+  double resolution;
+
+  uint64_t data_size;
+  uint64_t strings_size;
+
+  uint64_t off_trains;
+  uint64_t off_data;
+  uint64_t off_strings;
+};
+
+enum SpikeFileTrainFlags
+{
+  SPIKE_FILE_WEIGHTS = 1
+};
+
+struct SpikeFileTrain
+{
+  uint32_t id;
+  uint32_t flags;
+  uint32_t num_spikes;
+  uint32_t reserved;
+  int64_t first_tick;
+
+  /*
+   * Position of the encoded spikes in the data section.
+   */
+  uint64_t offset;
+  uint64_t size;
+};
+
+/*
+ * Read access to a binary spike file. The file is mapped into memory
+ * (or read, if compiled WITHOUT_MMAP) and stays there until the
+ * SpikeFile is destroyed.
+ */
+class SpikeFile
+{
+  protected:
+
+    MappedFile file;
+
+  public:
+
+    SpikeFileHeader *header;
+    SpikeFileTrain *trains;
+    const uint8_t *data;
+    const char *strings;
+
+    /*
+     * The spikes of train +train+ as InputStream for entity +entity+.
+     * +offset+ is added to the times. The trains are checked when the
+     * file is opened, so next() never runs into invalid data.
+     */
+    class Stream : public InputStream
+    {
+        const uint8_t *pos;
+        uint remaining;
+        int64_t tick;
+        double resolution;
+        simtime offset;
+        bool weighted;
+
+      public:
+
+        Stream(const SpikeFile *file, uint32_t train, uint entity, simtime offset);
+
+        virtual bool next();
+    };
+
+  public:
+
+    SpikeFile(const char *filename);
+    ~SpikeFile();
+
+    /*
+     * Returns true if +filename+ starts with SPIKE_FILE_MAGIC.
+     */
+    static bool is_spike_file(const char *filename);
+
+    /*
+     * Decode the whole file into on_events/on_event calls.
+     */
+    static void parse_file(const char *filename, NetStreamHandler *handler);
+
+    inline const char *
+      string(uint32_t offset) const
+      {
+        return this->strings + offset;
+      }
+
+  protected:
+
+    static bool valid_train(const uint8_t *pos, uint64_t size, uint32_t num_spikes, bool weighted);
+};
+
+/*
+ * Builds a binary spike file from the spike trains passed to it as a
+ * NetStreamHandler, e.g. by a SpikeParser. The spikes of an id given
+ * more than once are merged into one train.
+ */
+class SpikeFileWriter : public NetStreamHandler
+{
+  protected:
+
+    struct Train
+    {
+      std::string id;
+      std::vector<float> times;
+      std::vector<float> weights;
+      bool has_weights;
+    };
+
+    std::vector<Train> trains;
+    std::map<std::string, uint32_t> train_map;
+    Train *current_train;
+
+  public:
+
+    /*
+     * The resolution of the spike times. If zero (the default), the
+     * coarsest power of ten that represents all times exactly is
+     * used. Otherwise the times are rounded to multiples of it.
+     */
+    double resolution;
+
+    SpikeFileWriter();
+
+    virtual void on_template(const std::string &name, const std::string &type, jsonHash *data);
+    virtual void on_entity(const std::string &id, const std::string &template_name, jsonHash *data);
+    virtual void on_connections(const std::string &from);
+    virtual void on_connection(const std::string &to);
+    virtual void on_events(const std::string &id);
+    virtual void on_event(simtime at, real weight);
+
+    void write(const char *filename);
+
+  protected:
+
+    double exact_resolution() const;
+};
+
+#endif
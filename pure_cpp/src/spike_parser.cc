@@ -0,0 +1,44 @@
+#include "spike_parser.h"
+#include "text_reader.h"
+#include <math.h>
+#include <ctype.h>
+
+void
+SpikeParser::parse_file(const char *filename, NetStreamHandler *handler)
+{
+  TextReader r(filename);
+  std::string id;
+
+  while (true)
+  {
+    r.skip_ws('#');
+    if (r.peek() == -1) break;
+
+    id.clear();
+    for (int c = r.peek(); c != -1 && !isspace(c); c = r.peek()) id.push_back(r.get());
+    handler->on_events(id);
+
+    uint spikes = 0;
+    while (true)
+    {
+      r.skip_blanks();
+      int c = r.peek();
+      if (c == -1 || c == '\n') break;
+
+      double value = r.read_number();
+      r.skip_blanks();
+      if (r.skip('@'))
+      {
+        r.skip_blanks();
+        handler->on_event(r.read_number(), value);
+      }
+      else
+      {
+        handler->on_event(value, INFINITY);
+      }
+      ++spikes;
+    }
+
+    if (spikes == 0) r.error("no spikes given");
+  }
+}
@@ -0,0 +1,26 @@
+#ifndef __YINSPIRE__SPIKE_PARSER__
+#define __YINSPIRE__SPIKE_PARSER__
+
+#include "net_stream.h"
+
+/*
+ * Parses spike trains in the format of Loader_Spike:
+ *
+ *   Id1 weight1@time1 time2 time3 ...
+ *   Id2 time1 time2 time3 ...
+ *
+ * into one NetStreamHandler::on_events per line. Weights are optional
+ * (Infinity) and may be surrounded by spaces ("1.0 @ 3.5"). Lines
+ * beginning with "#" are comments.
+ *
+ * A spike file contains no entities, so it is usually merged into a
+ * loaded net (see Simulator::merge).
+ */
+class SpikeParser
+{
+  public:
+
+    static void parse_file(const char *filename, NetStreamHandler *handler);
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "spike_stats.h"
+#include <math.h>
+#include <string.h>
+
+SpikeStats::SpikeStats(simtime bin_width, uint max_bins)
+{
+  if (!(bin_width > 0.0)) throw "invalid bin width";
+  this->bin_width = bin_width;
+  this->max_bins = MAX(max_bins, 2);
+}
+
+void
+SpikeStats::correlate(uint index)
+{
+  if (index >= this->slots.size()) this->slots.resize(index + 1, -1);
+  if (this->slots[index] >= 0) return;
+
+  this->slots[index] = this->correlated.size();
+  this->correlated.push_back(index);
+  this->correlated_bins.push_back(std::vector<uint>(this->bins.size(), 0));
+}
+
+uint
+SpikeStats::add_bins(uint bin)
+{
+  while (bin >= this->max_bins)
+  {
+    // merge pairs of bins into the first half
+    const uint n = (this->bins.size() + 1) / 2;
+    for (uint i = 0; i < n; i++)
+    {
+      this->bins[i] = this->bins[2*i] + (2*i+1 < this->bins.size() ? this->bins[2*i+1] : 0);
+      for (uint c = 0; c < this->correlated_bins.size(); c++)
+      {
+        std::vector<uint> &b = this->correlated_bins[c];
+        b[i] = b[2*i] + (2*i+1 < b.size() ? b[2*i+1] : 0);
+      }
+    }
+    this->bins.resize(n);
+    for (uint c = 0; c < this->correlated_bins.size(); c++)
+    {
+      this->correlated_bins[c].resize(n);
+    }
+    this->bin_width *= 2;
+    bin /= 2;
+  }
+
+  this->bins.resize(bin + 1, 0);
+  for (uint c = 0; c < this->correlated_bins.size(); c++)
+  {
+    this->correlated_bins[c].resize(bin + 1, 0);
+  }
+  return bin;
+}
+
+void
+SpikeStats::add_neurons(uint index)
+{
+  NeuronStats n;
+  memset(&n, 0, sizeof(n));
+  this->neurons.resize(MAX(index + 1, 2 * this->neurons.size()), n);
+}
+
+void
+SpikeStats::write(FILE *out, const EntityTable &entities, simtime now) const
+{
+  // the bins up to +now+, but not more than would be kept
+  const uint nbins = MAX((uint)MIN(ceil(now / this->bin_width), (double)this->max_bins), this->bins.size());
+
+  fprintf(out, "# neurons\n");
+  fprintf(out, "# id\tfires\trate\tisi_mean\tisi_cv\n");
+  for (uint i = 0; i < this->neurons.size(); i++)
+  {
+    const NeuronStats &n = this->neurons[i];
+    if (n.fires == 0 || i >= entities.size()) continue;
+
+    fprintf(out, "%s\t%u\t%g\t", entities.name(i), n.fires, (now > 0.0 ? n.fires / now : 0.0));
+    if (n.fires > 1) fprintf(out, "%g\t", n.isi_mean); else fprintf(out, "-\t");
+    if (n.fires > 2 && n.isi_mean > 0.0)
+      fprintf(out, "%g\n", sqrt(n.isi_m2 / (n.fires - 2)) / n.isi_mean);
+    else
+      fprintf(out, "-\n");
+  }
+
+  fprintf(out, "# population (bin width %g)\n", this->bin_width);
+  fprintf(out, "# from\tfires\trate\n");
+  for (uint b = 0; b < nbins; b++)
+  {
+    const uint fires = (b < this->bins.size() ? this->bins[b] : 0);
+    fprintf(out, "%g\t%u\t%g\n", b * this->bin_width, fires, fires / this->bin_width);
+  }
+
+  if (this->correlated.size() < 2) return;
+
+  // Pearson correlation of the binned spike counts
+  std::vector<double> mean(this->correlated.size(), 0.0);
+  std::vector<double> sdev(this->correlated.size(), 0.0);
+  for (uint c = 0; c < this->correlated.size(); c++)
+  {
+    const std::vector<uint> &x = this->correlated_bins[c];
+    for (uint b = 0; b < x.size(); b++) mean[c] += x[b];
+    mean[c] /= nbins;
+    for (uint b = 0; b < nbins; b++)
+    {
+      const double d = (b < x.size() ? x[b] : 0) - mean[c];
+      sdev[c] += d * d;
+    }
+    sdev[c] = sqrt(sdev[c]);
+  }
+
+  fprintf(out, "# correlation\n");
+  fprintf(out, "# id\tid\tr\n");
+  for (uint c1 = 0; c1 < this->correlated.size(); c1++)
+  {
+    for (uint c2 = c1 + 1; c2 < this->correlated.size(); c2++)
+    {
+      const std::vector<uint> &x = this->correlated_bins[c1];
+      const std::vector<uint> &y = this->correlated_bins[c2];
+      double sum = 0.0;
+      for (uint b = 0; b < nbins; b++)
+      {
+        sum += ((b < x.size() ? x[b] : 0) - mean[c1]) * ((b < y.size() ? y[b] : 0) - mean[c2]);
+      }
+
+      fprintf(out, "%s\t%s\t", entities.name(this->correlated[c1]), entities.name(this->correlated[c2]));
+      if (sdev[c1] > 0.0 && sdev[c2] > 0.0)
+        fprintf(out, "%g\n", sum / (sdev[c1] * sdev[c2]));
+      else
+        fprintf(out, "-\n");
+    }
+  }
+}
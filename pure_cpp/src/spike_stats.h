@@ -0,0 +1,109 @@
+#ifndef __YINSPIRE__SPIKE_STATS__
+#define __YINSPIRE__SPIKE_STATS__
+
+#include "types.h"
+#include "entity_table.h"
+#include <stdio.h>
+#include <vector>
+
+/*
+ * Spike train statistics, computed while the simulation runs from the
+ * fire events passed to record():
+ *
+ *   - the number of fires and the mean and variance of the
+ *     inter-spike intervals (ISI) of each entity (Welford's method),
+ *     which give it's rate and ISI coefficient of variation
+ *   - the population rate, as histogram of all fires over simulated
+ *     time
+ *   - the correlation coefficients of the binned spike counts of
+ *     selected entities
+ *
+ * Memory is bounded: one NeuronStats per entity and at most
+ * +max_bins+ bins per histogram. If the simulation runs past the last
+ * bin, adjacent bins are merged and the bin width doubles.
+ */
+class SpikeStats
+{
+    struct NeuronStats
+    {
+      uint fires;
+      simtime last_fire;
+      double isi_mean;
+      double isi_m2;
+    };
+
+    std::vector<NeuronStats> neurons;
+
+    simtime bin_width;
+    uint max_bins;
+
+    /*
+     * Fires of all entities per bin.
+     */
+    std::vector<uint> bins;
+
+    /*
+     * The selected entities, and their fires per bin. +slots+ maps an
+     * entity index to it's position in +correlated+ (or -1).
+     */
+    std::vector<uint> correlated;
+    std::vector<std::vector<uint> > correlated_bins;
+    std::vector<int> slots;
+
+  public:
+
+    SpikeStats(simtime bin_width, uint max_bins=4096);
+
+    inline simtime get_bin_width() const { return this->bin_width; }
+
+    /*
+     * Compute the correlations of entity +index+ with the other
+     * selected ones.
+     */
+    void correlate(uint index);
+
+    inline void
+      record(uint index, simtime at)
+      {
+        uint bin = (at > 0.0 ? (uint)MIN(at / this->bin_width, 4e9) : 0);
+        if (bin >= this->bins.size()) bin = add_bins(bin);
+        ++this->bins[bin];
+
+        if (index == ENTITY_NO_INDEX) return;
+        if (index >= this->neurons.size()) add_neurons(index);
+
+        NeuronStats &n = this->neurons[index];
+        if (n.fires > 0)
+        {
+          const double isi = at - n.last_fire;
+          const double delta = isi - n.isi_mean;
+          n.isi_mean += delta / n.fires;
+          n.isi_m2 += delta * (isi - n.isi_mean);
+        }
+        n.last_fire = at;
+        ++n.fires;
+
+        if (index < this->slots.size() && this->slots[index] >= 0)
+        {
+          ++this->correlated_bins[this->slots[index]][bin];
+        }
+      }
+
+    /*
+     * Write the statistics up to time +now+ as text to +out+, with the
+     * ids of the entities from +entities+.
+     */
+    void write(FILE *out, const EntityTable &entities, simtime now) const;
+
+  protected:
+
+    /*
+     * Make room for +bin+, merging bins if there would be more than
+     * +max_bins+. Returns the index of +bin+ afterwards.
+     */
+    uint add_bins(uint bin);
+
+    void add_neurons(uint index);
+};
+
+#endif
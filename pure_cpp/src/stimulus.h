@@ -0,0 +1,22 @@
+#ifndef __YINSPIRE__STIMULUS__
+#define __YINSPIRE__STIMULUS__
+
+#include "types.h"
+
+/*
+ * The data structure used for storing a fire impluse or any other form
+ * of stimulation.
+ */
+struct Stimulus
+{
+  simtime at;
+  real weight;
+
+  inline static bool
+    less(const Stimulus &a, const Stimulus &b)
+    {
+      return (a.at < b.at); 
+    }
+};
+
+#endif
@@ -1,6 +1,9 @@
 #include "synapse.h"
 #include "neuron.h"
+#include "chunked_freelist_allocator.h"
+#include "simulator.h"
 #include <assert.h>
+#include <pthread.h>
 
 Synapse::Synapse()
 {
@@ -10,11 +13,84 @@ Synapse::Synapse()
   this->post_neuron = NULL;
   this->next_pre_synapse = NULL;
   this->next_post_synapse = NULL;
+  this->prev_pre_synapse = NULL;
+  this->prev_post_synapse = NULL;
+}
+
+Synapse::Synapse(const Synapse &other) : NeuralEntity(other)
+{
+  this->weight = other.weight;
+  this->delay = other.delay;
+  this->pre_neuron = NULL;
+  this->post_neuron = NULL;
+  this->next_pre_synapse = NULL;
+  this->next_post_synapse = NULL;
+  this->prev_pre_synapse = NULL;
+  this->prev_post_synapse = NULL;
+}
+
+static ChunkedFreelistAllocator synapse_pool(sizeof(Synapse), 4096);
+
+/*
+ * Synapses are cloned on several threads by
+ * Simulator::load_json_parallel.
+ */
+static pthread_mutex_t synapse_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void *
+Synapse::operator new(size_t size)
+{
+  if (size != sizeof(Synapse)) return ::operator new(size);
+
+  pthread_mutex_lock(&synapse_pool_mutex);
+  void *ptr;
+  try
+  {
+    ptr = synapse_pool.allocate();
+  }
+  catch (...)
+  {
+    pthread_mutex_unlock(&synapse_pool_mutex);
+    throw;
+  }
+  pthread_mutex_unlock(&synapse_pool_mutex);
+  return ptr;
+}
+
+void
+Synapse::operator delete(void *ptr, size_t size)
+{
+  if (ptr == NULL) return;
+  if (size != sizeof(Synapse))
+  {
+    ::operator delete(ptr);
+    return;
+  }
+
+  pthread_mutex_lock(&synapse_pool_mutex);
+  synapse_pool.free(ptr);
+  pthread_mutex_unlock(&synapse_pool_mutex);
+}
+
+NeuralEntity *
+Synapse::clone() const
+{
+  return new Synapse(*this);
 }
 
 void
 Synapse::dump(jsonHash *into)
 {
+  super::dump(into);
+
+  into->set("weight", this->weight);
+  into->set("delay", this->delay);
+}
+
+const char *
+Synapse::entity_type() const
+{
+  return "Synapse";
 }
 
 void
@@ -30,6 +106,8 @@ Synapse::load(jsonHash *data)
 void
 Synapse::stimulate(simtime at, real weight, NeuralEntity *source) 
 {
+  if (this->connections_pending) this->simulator->entity_connect_pending(this);
+
   /* 
    * Only propagate the stimulation if it doesn't originate from the
    * post Neuron.  Stimuli from a post Neuron are handled by a specific
@@ -37,7 +115,7 @@ Synapse::stimulate(simtime at, real weight, NeuralEntity *source)
    *
    * We ignore the weight parameter that is passed by the Neuron.
    */ 
-  if (source != this->post_neuron)
+  if (source != this->post_neuron && this->post_neuron != NULL)
   {
     this->post_neuron->stimulate(at + this->delay, this->weight, this);
   }
@@ -54,16 +132,22 @@ Synapse::connect(NeuralEntity *target)
 {
   Neuron *neuron = dynamic_cast<Neuron*>(target);
 
-  if (this->post_neuron != NULL || this->next_pre_synapse != NULL)
+  if (neuron == NULL)
+    throw "Synapse can only be connected to a Neuron";
+
+  if (this->post_neuron != NULL)
     throw "Synapse already connected";
 
+  this->prev_pre_synapse = NULL;
   this->next_pre_synapse = neuron->first_pre_synapse;
+  if (neuron->first_pre_synapse != NULL)
+    neuron->first_pre_synapse->prev_pre_synapse = this;
   neuron->first_pre_synapse = this;
   this->post_neuron = neuron;
 }
 
 /*
- * O(n)
+ * O(1)
  */
 void
 Synapse::disconnect(NeuralEntity *target)
@@ -73,45 +157,46 @@ Synapse::disconnect(NeuralEntity *target)
   if (this->post_neuron != neuron)
     throw "Synapse not connected to this Neuron";
 
-  /*
-   * Find the synapse in the linked list that precedes +this+.
-   */
-  Synapse *prev = NULL;
-  Synapse *curr = neuron->first_pre_synapse;
-
-  while (true)
-  {
-    if (curr == NULL) break;
-    if (curr == this) break; 
-    prev = curr;
-    curr = curr->next_pre_synapse;
-  }
-
-  if (curr != this)
-    throw "Synapse not in pre synapse list";
-
   /*
    * Remove ourself (this) from linked list
    */
-  if (prev == NULL)
+  if (this->prev_pre_synapse == NULL)
   {
-    /*
-     * we are the last synapse in the pre synapse list.
-     */
     assert(neuron->first_pre_synapse == this);
-    neuron->first_pre_synapse = NULL; 
+    neuron->first_pre_synapse = this->next_pre_synapse;
   }
   else
   {
-    prev->next_pre_synapse = this->next_pre_synapse;
+    this->prev_pre_synapse->next_pre_synapse = this->next_pre_synapse;
+  }
+
+  if (this->next_pre_synapse != NULL)
+  {
+    this->next_pre_synapse->prev_pre_synapse = this->prev_pre_synapse;
+  }
+
+  if (this->simulator != NULL && this->simulator->fire_next_pre_synapse == this)
+  {
+    this->simulator->fire_next_pre_synapse = this->next_pre_synapse;
   }
 
   this->post_neuron = NULL;
+  this->prev_pre_synapse = NULL;
   this->next_pre_synapse = NULL;
 }
 
+/*
+ * Disconnect from both the pre and the post Neuron.
+ */
+void
+Synapse::disconnect_all()
+{
+  if (this->pre_neuron != NULL) this->pre_neuron->disconnect(this);
+  if (this->post_neuron != NULL) disconnect(this->post_neuron);
+}
+
 void
 Synapse::each_connection(void (*yield)(NeuralEntity *self, NeuralEntity *conn))
 {
-  yield(this, this->post_neuron);
+  if (this->post_neuron != NULL) yield(this, this->post_neuron);
 }
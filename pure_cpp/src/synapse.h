@@ -8,6 +8,8 @@ class Neuron; // forward declaration
 class Synapse : public NeuralEntity
 {
     friend class Neuron;
+    friend class NetCompiler;
+    friend class Simulator;
     typedef NeuralEntity super; 
 
   protected:
@@ -29,13 +31,16 @@ class Synapse : public NeuralEntity
     Neuron *post_neuron;
 
     /*
-     * Those two pointers are part of an internal linked-list that
+     * Those pointers are part of an internal doubly linked-list that
      * starts at a Neuron and connects all pre-synapses of an Neuron
      * together. In the same way it connects all post-synapses of an
-     * Neuron together.
+     * Neuron together. The prev pointers allow disconnecting in O(1).
+     * All of them are cleared when a Synapse is disconnected.
      */
     Synapse *next_pre_synapse;
     Synapse *next_post_synapse;
+    Synapse *prev_pre_synapse;
+    Synapse *prev_post_synapse;
 
   public:
 
@@ -44,9 +49,25 @@ class Synapse : public NeuralEntity
      */
     Synapse();
 
+    /*
+     * Copy constructor. The copy is unconnected.
+     */
+    Synapse(const Synapse &other);
+
+    /*
+     * Synapses are allocated from a pool, so that creating and
+     * pruning synapses during a simulation is cheap. Subclasses with
+     * a different size fall back to the global operators.
+     */
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+
   public:
 
+    virtual NeuralEntity *clone() const;
+
     virtual void dump(jsonHash *into);
+    virtual const char *entity_type() const;
     virtual void load(jsonHash *data);
 
     virtual void stimulate(simtime at, real weight, NeuralEntity *source);
@@ -54,6 +75,17 @@ class Synapse : public NeuralEntity
     virtual void disconnect(NeuralEntity *target);
     virtual void each_connection(
       void (*yield)(NeuralEntity *self, NeuralEntity *conn));
+    virtual void disconnect_all();
+
+    /*
+     * Attribute accessor functions
+     */
+    inline real    get_weight() const { return this->weight; }
+    inline void    set_weight(real weight) { this->weight = weight; }
+    inline simtime get_delay() const { return this->delay; }
+    inline void    set_delay(simtime delay) { this->delay = delay; }
+    inline Neuron *get_pre_neuron() const { return this->pre_neuron; }
+    inline Neuron *get_post_neuron() const { return this->post_neuron; }
 
 };
 
@@ -0,0 +1,129 @@
+#include "text_reader.h"
+#include <stdlib.h>
+#include <ctype.h>
+#include <iostream>
+
+TextReader::TextReader(const char *filename, size_t buf_size)
+{
+  this->file = fopen(filename, "rb");
+  if (this->file == NULL)
+  {
+    throw "cannot open file";
+  }
+
+  this->buf_size = buf_size;
+  this->buf = (char*) malloc(buf_size);
+  this->pos = 0;
+  this->end = 0;
+  this->line = 1;
+
+  if (this->buf == NULL)
+  {
+    fclose(this->file);
+    throw "malloc failed";
+  }
+}
+
+TextReader::~TextReader()
+{
+  free(this->buf);
+  fclose(this->file);
+}
+
+bool
+TextReader::fill()
+{
+  this->pos = 0;
+  this->end = fread(this->buf, 1, this->buf_size, this->file);
+  return (this->end > 0);
+}
+
+void
+TextReader::error(const char *msg)
+{
+  std::cout << "error at line: " << this->line << std::endl;
+  throw msg;
+}
+
+void
+TextReader::skip_blanks()
+{
+  int c;
+  while ((c = peek()) == ' ' || c == '\t' || c == '\r') get();
+}
+
+void
+TextReader::skip_ws(int comment)
+{
+  int c;
+  while ((c = peek()) != -1)
+  {
+    if (isspace(c))
+    {
+      get();
+    }
+    else if (c == comment)
+    {
+      while ((c = get()) != -1 && c != '\n');
+    }
+    else
+    {
+      break;
+    }
+  }
+}
+
+bool
+TextReader::read_word(std::string &word)
+{
+  int c;
+  word.clear();
+  while ((c = peek()) != -1 && (isalnum(c) || c == '_'))
+  {
+    word.push_back(c);
+    get();
+  }
+  return !word.empty();
+}
+
+bool
+TextReader::read_token(std::string &tok)
+{
+  int c;
+  tok.clear();
+  while ((c = peek()) != -1 && (isalnum(c) || c == '_' || c == '+' || c == '-' || c == '.'))
+  {
+    tok.push_back(c);
+    get();
+  }
+  return !tok.empty();
+}
+
+void
+TextReader::read_until(int delim, std::string &str)
+{
+  int c;
+  str.clear();
+  while ((c = get()) != delim)
+  {
+    if (c == -1) error("unexpected end of file");
+    str.push_back(c);
+  }
+}
+
+double
+TextReader::to_number(const std::string &tok)
+{
+  char *end;
+  double value = strtod(tok.c_str(), &end);
+  if (tok.empty() || *end != '\000') error("invalid number");
+  return value;
+}
+
+double
+TextReader::read_number()
+{
+  std::string tok;
+  read_token(tok);
+  return to_number(tok);
+}
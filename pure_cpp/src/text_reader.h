@@ -0,0 +1,112 @@
+#ifndef __YINSPIRE__TEXT_READER__
+#define __YINSPIRE__TEXT_READER__
+
+#include "types.h"
+#include <stdio.h>
+#include <string>
+
+/*
+ * Reads a text file in chunks, one character at a time. Used by the
+ * parsers of the line and token based net formats (Yin, Spike and
+ * GraphML), which never need more than one character of lookahead.
+ */
+class TextReader
+{
+    FILE *file;
+    char *buf;
+    size_t buf_size;
+    size_t pos;
+    size_t end;
+
+  public:
+
+    /*
+     * Current line (starting at 1), for error messages.
+     */
+    uint line;
+
+    TextReader(const char *filename, size_t buf_size=1<<16);
+    ~TextReader();
+
+    /*
+     * The next character without consuming it (or -1 at the end of
+     * input).
+     */
+    inline int
+      peek()
+      {
+        if (this->pos >= this->end && !fill()) return -1;
+        return (unsigned char) this->buf[this->pos];
+      }
+
+    inline int
+      get()
+      {
+        if (this->pos >= this->end && !fill()) return -1;
+        int c = (unsigned char) this->buf[this->pos++];
+        if (c == '\n') this->line++;
+        return c;
+      }
+
+    /*
+     * Consume +c+ if it is the next character.
+     */
+    inline bool
+      skip(int c)
+      {
+        if (peek() != c) return false;
+        get();
+        return true;
+      }
+
+    /*
+     * Skip spaces and tabs, but not newlines.
+     */
+    void skip_blanks();
+
+    /*
+     * Skip all whitespace and comments from +comment+ to the end of the
+     * line.
+     */
+    void skip_ws(int comment);
+
+    /*
+     * Read a word of [A-Za-z0-9_] into +word+. Returns false if there
+     * is none.
+     */
+    bool read_word(std::string &word);
+
+    /*
+     * Read the characters before the next +delim+ into +str+ and
+     * consume the +delim+. Throws at the end of input.
+     */
+    void read_until(int delim, std::string &str);
+
+    /*
+     * Read a token of [A-Za-z0-9_+-.] (a word or a number) into +tok+.
+     * Returns false if there is none.
+     */
+    bool read_token(std::string &tok);
+
+    /*
+     * Read a number, including (+/-)Inf(inity). Throws if there is
+     * none.
+     */
+    double read_number();
+
+    /*
+     * Parse +tok+ as a number or throw.
+     */
+    double to_number(const std::string &tok);
+
+    /*
+     * Prints the current line and throws +msg+.
+     */
+    void error(const char *msg);
+
+  protected:
+
+    bool fill();
+};
+
+#endif
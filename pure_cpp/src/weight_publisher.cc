@@ -0,0 +1,213 @@
+#include "weight_publisher.h"
+#include "simulator.h"
+#include "synapse.h"
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static inline uint64_t
+align8(uint64_t pos)
+{
+  return (pos + 7) & ~(uint64_t)7;
+}
+
+WeightPublisher::WeightPublisher(Simulator *simulator, const char *filename)
+{
+  const EntityTable &entities = simulator->entities;
+  std::vector<uint32_t> ids;
+  std::string strings;
+
+  this->simulator = simulator;
+  this->mem = NULL;
+
+  // entities of a lazy net are not created just to publish them
+  for (uint i = 0; i < entities.size(); i++)
+  {
+    if (dynamic_cast<Synapse*>(simulator->entity_or_prototype(i)) == NULL) continue;
+    this->synapses.push_back(i);
+    ids.push_back(strings.size());
+    strings.append(entities.name(i));
+    strings.push_back('\0');
+  }
+
+  WeightFileHeader &h = this->header;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, WEIGHT_FILE_MAGIC, 8);
+  h.version = WEIGHT_FILE_VERSION;
+  h.byte_order = WEIGHT_FILE_BYTE_ORDER;
+  h.num_weights = this->synapses.size();
+  h.strings_size = strings.size();
+  h.off_ids = align8(sizeof(h));
+  h.off_weights = align8(h.off_ids + ids.size() * sizeof(uint32_t));
+  h.off_strings = align8(h.off_weights + ids.size() * sizeof(float));
+  this->size = h.off_strings + strings.size();
+
+  this->fh = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (this->fh < 0) throw "cannot open file";
+
+  try
+  {
+    if (ftruncate(this->fh, this->size) != 0) throw "write failed";
+    write_at(0, &h, sizeof(h));
+    write_at(h.off_ids, ids.empty() ? NULL : &ids[0], ids.size() * sizeof(uint32_t));
+    write_at(h.off_strings, strings.data(), strings.size());
+
+#ifdef WITHOUT_MMAP
+    this->buffer.resize(this->synapses.size());
+#else
+    this->mem = (char*) mmap(NULL, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, this->fh, 0);
+    if (this->mem == MAP_FAILED)
+    {
+      this->mem = NULL;
+      throw "mmap failed";
+    }
+#endif
+  }
+  catch (...)
+  {
+    close(this->fh);
+    throw;
+  }
+
+  publish();
+}
+
+WeightPublisher::~WeightPublisher()
+{
+#ifndef WITHOUT_MMAP
+  if (this->mem != NULL) munmap(this->mem, this->size);
+#endif
+  close(this->fh);
+}
+
+void
+WeightPublisher::write_at(uint64_t offset, const void *data, size_t size)
+{
+  if (size > 0 && pwrite(this->fh, data, size, offset) != (ssize_t)size)
+  {
+    throw "write failed";
+  }
+}
+
+void
+WeightPublisher::publish()
+{
+  const uint n = this->synapses.size();
+  WeightFileHeader *h = (this->mem != NULL ? (WeightFileHeader*) this->mem : &this->header);
+  float *weights = (this->mem != NULL ? (float*) (this->mem + this->header.off_weights) :
+      (n > 0 ? &this->buffer[0] : NULL));
+
+  // readers retry while the sequence is odd
+  ++h->sequence;
+  if (this->mem == NULL) write_at(offsetof(WeightFileHeader, sequence), (const void*) &h->sequence, sizeof(uint64_t));
+  __sync_synchronize();
+
+  for (uint i = 0; i < n; i++)
+  {
+    Synapse *syn = dynamic_cast<Synapse*>(this->simulator->entity_or_prototype(this->synapses[i]));
+    weights[i] = (syn != NULL ? syn->get_weight() : NAN);
+  }
+  h->at = this->simulator->schedule_current_time;
+
+  if (this->mem == NULL)
+  {
+    write_at(this->header.off_weights, weights, n * sizeof(float));
+    write_at(offsetof(WeightFileHeader, at), (const void*) &h->at, sizeof(double));
+  }
+
+  __sync_synchronize();
+  ++h->sequence;
+  if (this->mem == NULL) write_at(offsetof(WeightFileHeader, sequence), (const void*) &h->sequence, sizeof(uint64_t));
+}
+
+WeightReader::WeightReader(const char *filename)
+{
+  int fh = open(filename, O_RDONLY);
+  if (fh < 0) throw "cannot open file";
+
+  off_t sz = lseek(fh, 0, SEEK_END);
+  if (sz < (off_t)sizeof(WeightFileHeader))
+  {
+    close(fh);
+    throw "invalid weight file";
+  }
+  this->mem_size = sz;
+
+  // the publisher resizes the file only when it creates it
+  this->mem = (char*) mmap(NULL, this->mem_size, PROT_READ, MAP_SHARED, fh, 0);
+  close(fh);
+  if (this->mem == MAP_FAILED) throw "mmap failed";
+
+  try
+  {
+    const WeightFileHeader *h = (const WeightFileHeader*) this->mem;
+    if (memcmp(h->magic, WEIGHT_FILE_MAGIC, 8) != 0 || h->byte_order != WEIGHT_FILE_BYTE_ORDER)
+    {
+      throw "invalid weight file";
+    }
+    if (h->version != WEIGHT_FILE_VERSION)
+    {
+      throw "unsupported weight file version";
+    }
+
+    const uint64_t n = h->num_weights;
+    if (h->off_ids > this->mem_size || n > (this->mem_size - h->off_ids) / sizeof(uint32_t) ||
+        h->off_weights > this->mem_size || n > (this->mem_size - h->off_weights) / sizeof(float) ||
+        h->off_strings > this->mem_size || h->strings_size > this->mem_size - h->off_strings ||
+        h->off_ids % 4 != 0 || h->off_weights % 4 != 0)
+    {
+      throw "invalid weight file";
+    }
+
+    this->header = h;
+    this->ids = (const uint32_t*) (this->mem + h->off_ids);
+    this->strings = this->mem + h->off_strings;
+
+    // every id must be terminated within the strings
+    if (h->strings_size > 0 && this->strings[h->strings_size - 1] != '\0') throw "invalid weight file";
+    for (uint i = 0; i < n; i++)
+    {
+      if (this->ids[i] >= h->strings_size) throw "invalid weight file";
+    }
+  }
+  catch (...)
+  {
+    munmap(this->mem, this->mem_size);
+    throw;
+  }
+}
+
+WeightReader::~WeightReader()
+{
+  munmap(this->mem, this->mem_size);
+}
+
+void
+WeightReader::read(std::vector<float> &weights, double &at) const
+{
+  const uint n = this->header->num_weights;
+  const volatile float *src = this->weights();
+
+  weights.resize(n);
+  for (int tries = 0; tries < 1000; tries++)
+  {
+    const uint64_t s = this->header->sequence;
+    if (s % 2 == 1)
+    {
+      sched_yield();
+      continue;
+    }
+    __sync_synchronize();
+
+    for (uint i = 0; i < n; i++) weights[i] = src[i];
+    at = this->header->at;
+
+    __sync_synchronize();
+    if (this->header->sequence == s) return;
+  }
+  throw "no consistent snapshot";
+}
@@ -0,0 +1,177 @@
+#ifndef __YINSPIRE__WEIGHT_PUBLISHER__
+#define __YINSPIRE__WEIGHT_PUBLISHER__
+
+#include "types.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Simulator;
+
+/*
+ * A file with the weights of all Synapses of a running simulation,
+ * which is updated in place so that other processes can map it and
+ * watch the weights change.
+ *
+ * Layout (all sections 8 byte aligned, native byte order):
+ *
+ *   WeightFileHeader
+ *   ids      uint32_t[num_weights]  (string offsets, synapse ids)
+ *   weights  float[num_weights]
+ *   strings  NUL-terminated strings
+ *
+ * The synapses are in the order of their entity index. Only +sequence+,
+ * +at+ and +weights+ change after the file was created.
+ *
+ * Snapshots are published with a sequence lock: +sequence+ is odd
+ * while the weights are written and incremented again afterwards. A
+ * reader copies (or uses) the weights between two reads of
+ * +sequence+, and has a consistent snapshot if both were the same
+ * even number (see WeightReader::read):
+ *
+ *   do {
+ *     s = h->sequence;   (wait while odd)
+ *     ... read weights and at ...
+ *   } while (h->sequence != s);
+ *
+ * with memory barriers after the first and before the second read.
+ */
+
+#define WEIGHT_FILE_MAGIC "YINWGHTS"
+#define WEIGHT_FILE_VERSION 1
+#define WEIGHT_FILE_BYTE_ORDER 0x01020304
+
+struct WeightFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+
+  uint32_t num_weights;
+  uint32_t reserved;
+
+  volatile uint64_t sequence;
+
+  /*
+   * The simulation time of the current snapshot.
+   */
+  volatile double at;
+
+  uint64_t strings_size;
+
+  uint64_t off_ids;
+  uint64_t off_weights;
+  uint64_t off_strings;
+};
+
+/*
+ * Publishes the weights of the Synapses of a Simulator into a weight
+ * file. The file is mapped into memory and written in place (or, if
+ * compiled WITHOUT_MMAP, written with pwrite, which readers that map
+ * the file see just as well).
+ *
+ * The synapses are collected once; synapses created afterwards are
+ * not published and removed ones get a weight of NaN. Synapses of a
+ * lazily loaded net are published without creating them; until they
+ * are created they have the weight of their template.
+ */
+class WeightPublisher
+{
+  protected:
+
+    Simulator *simulator;
+
+    /*
+     * Entity indices of the published synapses.
+     */
+    std::vector<uint> synapses;
+
+    int fh;
+    WeightFileHeader header;
+    size_t size;
+
+    /*
+     * The mapped file, or NULL (WITHOUT_MMAP).
+     */
+    char *mem;
+
+    /*
+     * The weights of the snapshot, if not mapped.
+     */
+    std::vector<float> buffer;
+
+  public:
+
+    /*
+     * Create +filename+ with the ids of the synapses of +simulator+
+     * and publish their current weights.
+     */
+    WeightPublisher(Simulator *simulator, const char *filename);
+    ~WeightPublisher();
+
+    /*
+     * Publish the current weights.
+     */
+    void publish();
+
+  protected:
+
+    void write_at(uint64_t offset, const void *data, size_t size);
+};
+
+/*
+ * Maps a weight file written by a WeightPublisher read-only. The
+ * weights and the sequence are read from the mapping, which follows
+ * the publisher, so watching the weights needs no copies; read() copies
+ * a consistent snapshot. The file is mapped even if compiled
+ * WITHOUT_MMAP, as a copy would not see later snapshots.
+ */
+class WeightReader
+{
+  protected:
+
+    char *mem;
+    size_t mem_size;
+
+    const WeightFileHeader *header;
+    const uint32_t *ids;
+    const char *strings;
+
+  public:
+
+    WeightReader(const char *filename);
+    ~WeightReader();
+
+    inline uint size() const { return this->header->num_weights; }
+
+    inline const char *id(uint i) const { return this->strings + this->ids[i]; }
+
+    /*
+     * The sequence of the current snapshot. Odd while the publisher
+     * writes it.
+     */
+    inline uint64_t sequence() const { return this->header->sequence; }
+
+    /*
+     * The weights in the mapping. They may change while they are
+     * read; compare sequence() before and after, or use read().
+     */
+    inline const volatile float *weights() const
+      {
+        return (const volatile float*) (this->mem + this->header->off_weights);
+      }
+
+    /*
+     * Copy the current snapshot into +weights+ and it's time into
+     * +at+. Throws if the publisher did not finish a snapshot within
+     * a few retries.
+     */
+    void read(std::vector<float> &weights, double &at) const;
+
+  private:
+
+    WeightReader(const WeightReader &other);
+    WeightReader &operator=(const WeightReader &other);
+};
+
+#endif
@@ -0,0 +1,345 @@
+#include "yin_parser.h"
+#include "text_reader.h"
+#include <ctype.h>
+#include <math.h>
+#include <set>
+#include <vector>
+
+enum
+{
+  YIN_NONE = 0,
+  YIN_TEMPLATE,
+  YIN_ENTITY,
+  YIN_CONNECT,
+  YIN_STIMULATE
+};
+
+class YinScanner
+{
+    TextReader &r;
+    NetStreamHandler *handler;
+
+    /*
+     * Names of the templates passed to the handler so far.
+     */
+    std::set<std::string> templates;
+
+    /*
+     * Templates defined with "<", which cannot be redefined.
+     */
+    std::set<std::string> defined;
+
+    std::string tok;
+    std::vector<std::string> ids;
+
+  public:
+
+    YinScanner(TextReader &reader, NetStreamHandler *handler) : r(reader)
+    {
+      this->handler = handler;
+    }
+
+    ~YinScanner();
+
+    void
+      scan()
+      {
+        while (scan_command());
+      }
+
+  protected:
+
+    inline void skip_ws() { this->r.skip_ws('#'); }
+
+    static int
+      command_type(const std::string &word)
+      {
+        if (word == "TEMPLATE") return YIN_TEMPLATE;
+        if (word == "ENTITY") return YIN_ENTITY;
+        if (word == "CONNECT") return YIN_CONNECT;
+        if (word == "STIMULATE") return YIN_STIMULATE;
+        return YIN_NONE;
+      }
+
+    /*
+     * Read a quoted id or a word. Returns false if there is none.
+     */
+    bool
+      scan_id(std::string &id)
+      {
+        skip_ws();
+        if (this->r.skip('"'))
+        {
+          this->r.read_until('"', id);
+          if (id.empty()) this->r.error("empty id");
+          return true;
+        }
+        return this->r.read_word(id);
+      }
+
+    /*
+     * Append a "," separated list of ids to +list+ and return it's
+     * length.
+     */
+    uint
+      scan_idlist(std::vector<std::string> &list)
+      {
+        std::string id;
+        uint n = 0;
+
+        while (scan_id(id))
+        {
+          list.push_back(id);
+          ++n;
+          skip_ws();
+          if (!this->r.skip(',')) break;
+        }
+        return n;
+      }
+
+    int
+      scan_type()
+      {
+        skip_ws();
+        switch (this->r.get())
+        {
+          case '=': return YIN_ENTITY;
+          case '<': return YIN_TEMPLATE;
+          case '!': return YIN_STIMULATE;
+          case '-':
+            if (this->r.get() == '>') return YIN_CONNECT;
+        }
+        this->r.error("error occured while parsing");
+        return YIN_NONE;
+      }
+
+    bool
+      scan_command()
+      {
+        int type = YIN_NONE;
+
+        this->ids.clear();
+        skip_ws();
+        if (this->r.peek() == -1) return false;
+
+        /*
+         * A command name is followed by whitespace, an unquoted id of
+         * the same name is not.
+         */
+        if (isalpha(this->r.peek()))
+        {
+          this->r.read_word(this->tok);
+          type = command_type(this->tok);
+          if (type == YIN_NONE || !isspace(this->r.peek()))
+          {
+            type = YIN_NONE;
+            this->ids.push_back(this->tok);
+            skip_ws();
+            if (this->r.skip(',')) scan_idlist(this->ids);
+          }
+          else
+          {
+            scan_idlist(this->ids);
+          }
+        }
+        else
+        {
+          scan_idlist(this->ids);
+        }
+
+        if (this->ids.empty()) this->r.error("error occured while parsing");
+
+        int scanned_type = scan_type();
+        if (type != YIN_NONE && type != scanned_type) this->r.error("error occured while parsing");
+
+        switch (scanned_type)
+        {
+          case YIN_TEMPLATE: scan_template(); break;
+          case YIN_ENTITY: scan_entity(); break;
+          case YIN_CONNECT: scan_connect(); break;
+          case YIN_STIMULATE: scan_stimulate(); break;
+        }
+        return true;
+      }
+
+    /*
+     * Read an optional "{ name = value ... }" list. Returns NULL if
+     * there is none.
+     */
+    jsonHash *
+      scan_propertylist()
+      {
+        std::string name;
+
+        skip_ws();
+        if (!this->r.skip('{')) return NULL;
+
+        jsonHash *props = new jsonHash();
+        try
+        {
+          while (true)
+          {
+            skip_ws();
+            if (this->r.skip('}')) break;
+
+            if (!scan_id(name)) this->r.error("property name expected");
+            skip_ws();
+            if (!this->r.skip('=')) this->r.error("\"=\" expected");
+            skip_ws();
+            if (!this->r.read_token(this->tok)) this->r.error("property value expected");
+
+            if (this->tok == "true") props->set(name.c_str(), true);
+            else if (this->tok == "false") props->set(name.c_str(), false);
+            else props->set(name.c_str(), this->r.to_number(this->tok));
+          }
+        }
+        catch (...)
+        {
+          props->ref_decr();
+          throw;
+        }
+        return props;
+      }
+
+    void
+      scan_template()
+      {
+        std::string base;
+
+        if (!scan_id(base)) this->r.error("type expected");
+        jsonHash *props = scan_propertylist();
+        if (props == NULL) props = new jsonHash();
+
+        try
+        {
+          for (uint i = 0; i < this->ids.size(); i++)
+          {
+            if (!this->defined.insert(this->ids[i]).second) this->r.error("duplicate template");
+            this->templates.insert(this->ids[i]);
+            this->handler->on_template(this->ids[i], base, props);
+          }
+        }
+        catch (...)
+        {
+          props->ref_decr();
+          throw;
+        }
+        props->ref_decr();
+      }
+
+    void
+      scan_entity()
+      {
+        std::string type;
+
+        if (!scan_id(type)) this->r.error("type expected");
+        jsonHash *props = scan_propertylist();
+
+        try
+        {
+          if (this->templates.insert(type).second)
+          {
+            // an entity type without template
+            jsonHash *empty = new jsonHash();
+            try
+            {
+              this->handler->on_template(type, type, empty);
+            }
+            catch (...)
+            {
+              empty->ref_decr();
+              throw;
+            }
+            empty->ref_decr();
+          }
+
+          for (uint i = 0; i < this->ids.size(); i++)
+          {
+            this->handler->on_entity(this->ids[i], type, props);
+          }
+        }
+        catch (...)
+        {
+          if (props != NULL) props->ref_decr();
+          throw;
+        }
+        if (props != NULL) props->ref_decr();
+      }
+
+    /*
+     * Every entity of a list is connected to every entity of the next
+     * list.
+     */
+    void
+      scan_connect()
+      {
+        std::vector<std::string> to;
+        std::vector<std::string> &from = this->ids;
+
+        while (true)
+        {
+          to.clear();
+          if (scan_idlist(to) == 0) this->r.error("error occured while parsing");
+
+          for (uint i = 0; i < from.size(); i++)
+          {
+            this->handler->on_connections(from[i]);
+            for (uint j = 0; j < to.size(); j++) this->handler->on_connection(to[j]);
+          }
+          from.swap(to);
+
+          skip_ws();
+          if (!this->r.skip('-')) break;
+          if (!this->r.skip('>')) this->r.error("\"->\" expected");
+        }
+      }
+
+    /*
+     * "{ [weight@]at ... }" where the weight defaults to Infinity.
+     */
+    void
+      scan_stimulate()
+      {
+        std::vector<simtime> at;
+        std::vector<real> weight;
+
+        skip_ws();
+        if (!this->r.skip('{')) this->r.error("\"{\" expected");
+
+        while (true)
+        {
+          skip_ws();
+          if (this->r.skip('}')) break;
+
+          double value = this->r.read_number();
+          if (this->r.skip('@'))
+          {
+            weight.push_back(value);
+            at.push_back(this->r.read_number());
+          }
+          else
+          {
+            weight.push_back(INFINITY);
+            at.push_back(value);
+          }
+        }
+
+        for (uint i = 0; i < this->ids.size(); i++)
+        {
+          this->handler->on_events(this->ids[i]);
+          for (uint j = 0; j < at.size(); j++) this->handler->on_event(at[j], weight[j]);
+        }
+      }
+};
+
+YinScanner::~YinScanner()
+{
+}
+
+void
+YinParser::parse_file(const char *filename, NetStreamHandler *handler)
+{
+  TextReader reader(filename);
+  YinScanner scanner(reader, handler);
+  scanner.scan();
+}
@@ -0,0 +1,29 @@
+#ifndef __YINSPIRE__YIN_PARSER__
+#define __YINSPIRE__YIN_PARSER__
+
+#include "net_stream.h"
+
+/*
+ * Parses a net in the human readable Yin format (see
+ * lib/Yinspire/Loaders/YinScanner.rb) command by command:
+ *
+ *   TEMPLATE InputType < Neuron_SRM_01 { const_threshold = 1.2 }
+ *   ENTITY Input1, "input2" = InputType
+ *   Syn1, Syn2 = Synapse { weight = 2.3  delay = 0.4 }
+ *   CONNECT Input1 -> Syn1, Syn2 -> "input2"
+ *   STIMULATE Input1 ! { 123@4.4 Inf@23.3 4.5 }
+ *
+ * The command names are optional. As in Loader_Yin, templates,
+ * entities and connections have to be defined before they are used.
+ * Entities of a type without a template get an implicit template of
+ * the same name; properties given for entities are passed to
+ * NetStreamHandler::on_entity.
+ */
+class YinParser
+{
+  public:
+
+    static void parse_file(const char *filename, NetStreamHandler *handler);
+};
+
+#endif